@@ -0,0 +1,319 @@
+#pragma once
+
+#include "utils/bytes.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench::corpus
+{
+
+/**
+ * \brief SplitMix64 generator.
+ *
+ * The corpora are derived from its raw output by hand: the standard distributions are free to
+ * differ between standard libraries, which would make the corpora, and the results, differ too.
+ */
+class Random
+{
+public:
+  explicit Random(std::uint64_t seed) noexcept : state_{seed}
+  {}
+
+  std::uint64_t next() noexcept
+  {
+    auto z = (state_ += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+    return z ^ (z >> 31);
+  }
+
+  /**
+   * \brief A value in [0, bound).
+   */
+  std::size_t below(std::size_t bound) noexcept
+  {
+    return static_cast<std::size_t>((static_cast<unsigned __int128>(next()) * bound) >> 64);
+  }
+
+  /**
+   * \brief A value in [0, bound), small values being much more likely, roughly as in Zipf's law.
+   */
+  std::size_t skewed(std::size_t bound) noexcept
+  {
+    return below(below(bound) + 1);
+  }
+
+private:
+  std::uint64_t state_;
+};
+
+namespace detail
+{
+
+inline void append(utils::bytes::ByteSequence &out, std::string_view text)
+{
+  for (auto chr : text)
+  {
+    out.push_back(std::byte(chr));
+  }
+}
+
+inline void append_number(
+    utils::bytes::ByteSequence &out, std::uint64_t value, std::size_t width = 0)
+{
+  auto digits = std::to_string(value);
+  for (auto i = digits.size(); i < width; i++)
+  {
+    out.push_back(std::byte{'0'});
+  }
+
+  append(out, digits);
+}
+
+}  // namespace detail
+
+/**
+ * \brief English-like prose: words of a fixed vocabulary with skewed frequencies, punctuation and
+ * line breaks.
+ */
+inline utils::bytes::ByteSequence text(std::size_t size, std::uint64_t seed = 1)
+{
+  static constexpr std::string_view WORDS[]{"the", "of", "and", "to", "a", "in", "is", "that",
+      "for", "it", "as", "was", "with", "be", "by", "on", "not", "he", "this", "are", "or", "his",
+      "from", "at", "which", "but", "have", "an", "had", "they", "you", "were", "their", "one",
+      "all", "we", "can", "her", "has", "there", "been", "if", "more", "when", "will", "would",
+      "who", "so", "no", "compression", "dictionary", "symbol", "stream", "archive", "encoder",
+      "decoder", "block", "table", "frequency", "length", "memory", "output", "input", "buffer"};
+
+  Random random{seed};
+  utils::bytes::ByteSequence out;
+  out.reserve(size + 16);
+
+  bool capitalize = true;
+  std::size_t line = 0;
+
+  while (out.size() < size)
+  {
+    auto word = WORDS[random.skewed(std::size(WORDS))];
+    auto start = out.size();
+    detail::append(out, word);
+
+    if (capitalize)
+    {
+      out[start] = std::byte(std::to_integer<char>(out[start]) - 'a' + 'A');
+      capitalize = false;
+    }
+
+    line += word.size() + 1;
+    switch (random.below(16))
+    {
+      case 0:
+        detail::append(out, ".");
+        capitalize = true;
+        break;
+      case 1:
+        detail::append(out, ",");
+        break;
+      default:
+        break;
+    }
+
+    if (line > 72)
+    {
+      detail::append(out, "\n");
+      line = 0;
+    }
+    else
+    {
+      detail::append(out, " ");
+    }
+  }
+
+  out.resize(size);
+  return out;
+}
+
+/**
+ * \brief Access-log lines: increasing timestamps, levels, request paths, status codes, sizes and
+ * latencies.
+ */
+inline utils::bytes::ByteSequence log(std::size_t size, std::uint64_t seed = 1)
+{
+  static constexpr std::string_view LEVELS[]{"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+  static constexpr std::string_view METHODS[]{"GET", "GET", "GET", "POST", "PUT", "DELETE"};
+  static constexpr std::string_view PATHS[]{"/api/v1/items/", "/api/v1/users/", "/static/img/",
+      "/api/v2/search?q=", "/health", "/api/v1/orders/", "/login", "/metrics"};
+  static constexpr std::string_view STATUSES[]{"200", "200", "200", "200", "304", "404", "500"};
+
+  Random random{seed};
+  utils::bytes::ByteSequence out;
+  out.reserve(size + 256);
+
+  std::uint64_t millis = 1700000000000ull;
+
+  while (out.size() < size)
+  {
+    millis += random.skewed(2000);
+    auto seconds = millis / 1000;
+
+    detail::append(out, "2023-11-");
+    detail::append_number(out, 14 + seconds / 86400 % 14, 2);
+    detail::append(out, "T");
+    detail::append_number(out, seconds / 3600 % 24, 2);
+    detail::append(out, ":");
+    detail::append_number(out, seconds / 60 % 60, 2);
+    detail::append(out, ":");
+    detail::append_number(out, seconds % 60, 2);
+    detail::append(out, ".");
+    detail::append_number(out, millis % 1000, 3);
+    detail::append(out, "Z ");
+
+    detail::append(out, LEVELS[random.below(std::size(LEVELS))]);
+    detail::append(out, " [worker-");
+    detail::append_number(out, random.below(16));
+    detail::append(out, "] ");
+    detail::append(out, METHODS[random.below(std::size(METHODS))]);
+    detail::append(out, " ");
+    detail::append(out, PATHS[random.skewed(std::size(PATHS))]);
+    detail::append_number(out, random.skewed(100000));
+    detail::append(out, " ");
+    detail::append(out, STATUSES[random.below(std::size(STATUSES))]);
+    detail::append(out, " ");
+    detail::append_number(out, 200 + random.skewed(50000));
+    detail::append(out, " ");
+    detail::append_number(out, 1 + random.skewed(500));
+    detail::append(out, "ms\n");
+  }
+
+  out.resize(size);
+  return out;
+}
+
+/**
+ * \brief Fixed-size binary records, as in a table dump: an increasing id, a small type, small
+ * signed deltas and a slowly varying floating-point measurement.
+ */
+inline utils::bytes::ByteSequence binary(std::size_t size, std::uint64_t seed = 1)
+{
+  Random random{seed};
+  utils::bytes::ByteSequence out;
+  out.reserve(size + 32);
+
+  std::uint32_t id = 1000;
+  double measurement = 20.;
+
+  auto put = [&out](const auto &value) {
+    std::array<std::byte, sizeof(value)> bytes;
+    std::memcpy(bytes.data(), &value, sizeof(value));
+    out.insert(out.end(), bytes.begin(), bytes.end());
+  };
+
+  while (out.size() < size)
+  {
+    id += 1 + random.skewed(4);
+    measurement += (static_cast<double>(random.below(2001)) - 1000.) / 10000.;
+
+    put(id);
+    put(static_cast<std::uint16_t>(random.skewed(12)));
+    put(static_cast<std::int32_t>(random.skewed(200)) - 100);
+    put(static_cast<float>(measurement));
+    put(static_cast<std::uint16_t>(0));
+  }
+
+  out.resize(size);
+  return out;
+}
+
+/**
+ * \brief Uniform bytes, which do not compress.
+ */
+inline utils::bytes::ByteSequence random(std::size_t size, std::uint64_t seed = 1)
+{
+  Random random{seed};
+  utils::bytes::ByteSequence out(size);
+
+  for (std::size_t i = 0; i < size; i += 8)
+  {
+    auto word = utils::bytes::to_bytes(random.next());
+    std::copy_n(word.begin(), std::min<std::size_t>(8, size - i), out.begin() + i);
+  }
+
+  return out;
+}
+
+/**
+ * \brief Runs of repeated bytes, half of them zeros, as in sparse or padded data.
+ */
+inline utils::bytes::ByteSequence runs(std::size_t size, std::uint64_t seed = 1)
+{
+  Random random{seed};
+  utils::bytes::ByteSequence out;
+  out.reserve(size + 4096);
+
+  while (out.size() < size)
+  {
+    auto value = random.below(2) ? std::byte{0} : std::byte(random.below(256));
+    out.insert(out.end(), 1 + random.skewed(4096), value);
+  }
+
+  out.resize(size);
+  return out;
+}
+
+/**
+ * \brief Short protocol messages of 40 to 400 bytes, such as RPC requests, each to be compressed on
+ * its own.
+ */
+inline std::vector<utils::bytes::ByteSequence> small_messages(
+    std::size_t count, std::uint64_t seed = 1)
+{
+  static constexpr std::string_view KEYS[]{"\"id\":", "\"user\":", "\"action\":\"", "\"items\":[",
+      "\"price\":", "\"currency\":\"EUR\"", "\"session\":\"", "\"ok\":true"};
+
+  Random random{seed};
+  std::vector<utils::bytes::ByteSequence> messages(count);
+
+  for (auto &message : messages)
+  {
+    auto target = 40 + random.below(361);
+
+    detail::append(message, random.below(2) ? "POST /rpc/update\n{" : "POST /rpc/query\n{");
+
+    while (message.size() < target)
+    {
+      detail::append(message, KEYS[random.skewed(std::size(KEYS))]);
+      detail::append_number(message, random.skewed(1000000));
+      detail::append(message, ",");
+    }
+
+    message.resize(target - 1);
+    detail::append(message, "}");
+  }
+
+  return messages;
+}
+
+struct Corpus
+{
+  std::string name;
+  utils::bytes::ByteSequence data;
+};
+
+/**
+ * \brief Every corpus of \p size bytes, but the small messages.
+ */
+inline std::vector<Corpus> all(std::size_t size, std::uint64_t seed = 1)
+{
+  return {{"text", text(size, seed)}, {"log", log(size, seed)}, {"binary", binary(size, seed)},
+      {"random", random(size, seed)}, {"runs", runs(size, seed)}};
+}
+
+}  // namespace bench::corpus
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "utils/stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+
+struct Options
+{
+  std::size_t corpus_size = std::size_t{4} << 20;
+  std::size_t messages_count = 10000;
+  std::size_t repetitions = 5;
+  std::uint64_t seed = 1;
+  std::string filter;  ///< Only the benchmarks whose id contains it run.
+};
+
+/**
+ * \brief Keep the optimizer from discarding the computation of \p value.
+ */
+template <class T>
+void keep(const T &value) noexcept
+{
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Measurement
+{
+  double seconds;  ///< The fastest call.
+  double allocations;  ///< The allocations per call.
+};
+
+/**
+ * \brief Call \p f once to warm up, then \p repetitions times.
+ *
+ * The fastest call is kept: on a shared machine the noise only ever adds time, so the minimum is
+ * the most reproducible estimate.
+ */
+template <class Function>
+Measurement measure(Function &&f, std::size_t repetitions)
+{
+  f();
+
+  auto seconds = std::numeric_limits<double>::max();
+  // The bench binary links //lib/utils:counting_new in, which counts the calls to operator new.
+  auto allocations_before = utils::stats::allocations_count.load();
+
+  for (std::size_t i = 0; i < repetitions; i++)
+  {
+    auto t1 = std::chrono::steady_clock::now();
+    f();
+    auto t2 = std::chrono::steady_clock::now();
+
+    seconds = std::min(seconds, std::chrono::duration<double>(t2 - t1).count());
+  }
+
+  auto allocations = utils::stats::allocations_count.load() - allocations_before;
+  return Measurement{seconds, double(allocations) / double(std::max<std::size_t>(repetitions, 1))};
+}
+
+struct Entry
+{
+  std::string group;  ///< micro, encode, decode, round_trip, parallel_encode or parallel_decode.
+  std::string name;
+  std::string corpus;
+  std::size_t bytes = 0;  ///< The bytes processed per call, if any.
+  std::size_t items = 0;  ///< The items processed per call, for the benchmarks of single steps.
+  Measurement measurement{};
+  std::optional<double> ratio{};  ///< The compressed size over the raw size.
+
+  std::string id() const
+  {
+    return group + "/" + name + "/" + corpus;
+  }
+};
+
+/**
+ * \brief The results of a run, written out as JSON.
+ */
+class Report
+{
+public:
+  explicit Report(Options options) : options_{std::move(options)}
+  {}
+
+  const Options &options() const noexcept
+  {
+    return options_;
+  }
+
+  /**
+   * \brief Whether the benchmark \p entry would be kept, so that filtered-out ones are not run.
+   */
+  bool selected(const Entry &entry) const
+  {
+    return entry.id().find(options_.filter) != std::string::npos;
+  }
+
+  /**
+   * \brief Measure \p f and record it as \p entry, unless it is filtered out.
+   */
+  template <class Function>
+  void run(Entry entry, Function &&f)
+  {
+    if (selected(entry))
+    {
+      entry.measurement = measure(f, options_.repetitions);
+      entries_.push_back(std::move(entry));
+    }
+  }
+
+  void write_json(std::ostream &out) const
+  {
+    out << "{\n  \"context\": {\"corpus_size\": " << options_.corpus_size
+        << ", \"messages_count\": " << options_.messages_count
+        << ", \"repetitions\": " << options_.repetitions << ", \"seed\": " << options_.seed
+        << "},\n  \"benchmarks\": [";
+
+    for (std::size_t i = 0; i < entries_.size(); i++)
+    {
+      const auto &entry = entries_[i];
+      const auto &measurement = entry.measurement;
+
+      out << (i ? ",\n" : "\n") << "    {\"group\": \"" << entry.group << "\", \"name\": \""
+          << entry.name << "\", \"corpus\": \"" << entry.corpus << "\", \"bytes\": " << entry.bytes
+          << ", \"items\": " << entry.items << ", \"ns_per_call\": " << measurement.seconds * 1e9
+          << ", \"allocations_per_call\": " << measurement.allocations;
+
+      if (entry.bytes)
+      {
+        out << ", \"mb_per_s\": " << entry.bytes / measurement.seconds / 1e6;
+      }
+
+      if (entry.items)
+      {
+        out << ", \"ns_per_item\": " << measurement.seconds * 1e9 / entry.items;
+      }
+
+      if (entry.ratio)
+      {
+        out << ", \"ratio\": " << *entry.ratio;
+      }
+
+      out << "}";
+    }
+
+    out << "\n  ]\n}\n";
+  }
+
+private:
+  Options options_;
+  std::vector<Entry> entries_;
+};
+
+void micro_benchmarks(Report &report);
+void codec_benchmarks(Report &report);
+
+}  // namespace bench
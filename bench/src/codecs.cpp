@@ -0,0 +1,185 @@
+#include "bench/corpus.h"
+#include "bench/harness.h"
+#include "compression/container.h"
+#include "compression/variants.h"
+#include "utils/bytes.h"
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bench
+{
+
+namespace
+{
+
+/**
+ * \brief Encode and decode every corpus with \p Coding, and round trip every small message.
+ */
+template <class Coding>
+void codec_benchmark(Report &report, const std::string &name,
+    const std::vector<corpus::Corpus> &corpora,
+    const std::vector<utils::bytes::ByteSequence> &messages)
+{
+  for (const auto &[corpus_name, raw] : corpora)
+  {
+    Entry encode{"encode", name, corpus_name, raw.size()};
+    Entry decode{"decode", name, corpus_name, raw.size()};
+    if (!report.selected(encode) && !report.selected(decode))
+    {
+      continue;
+    }
+
+    auto archive = Coding::compress(raw);
+    if (Coding::decompress(archive) != raw)
+    {
+      throw std::runtime_error{name + " does not round trip on the " + corpus_name + " corpus"};
+    }
+
+    encode.ratio = decode.ratio = double(archive.size()) / double(raw.size());
+
+    report.run(encode, [&] { keep(Coding::compress(raw)); });
+    report.run(decode, [&] { keep(Coding::decompress(archive)); });
+  }
+
+  std::size_t raw_size = 0;
+  std::size_t archives_size = 0;
+  for (const auto &message : messages)
+  {
+    raw_size += message.size();
+    archives_size += Coding::compress(message).size();
+  }
+
+  Entry round_trip{"round_trip", name, "small_messages", raw_size, messages.size()};
+  round_trip.ratio = double(archives_size) / double(raw_size);
+
+  report.run(round_trip, [&] {
+    for (const auto &message : messages)
+    {
+      keep(Coding::decompress(Coding::compress(message)));
+    }
+  });
+}
+
+/**
+ * \brief Compress \p raw into a container with \p Algo, the blocks side by side on the pool.
+ */
+template <class Algo>
+struct InContainer
+{
+  static utils::bytes::ByteSequence encode(
+      utils::bytes::ByteView raw, utils::thread_pool::ThreadPool &pool)
+  {
+    utils::bytes::ByteSequence container;
+    compression::FramedEncoder<Algo> encoder{
+        [&container](utils::bytes::ByteView chunk) {
+          container.insert(container.end(), chunk.begin(), chunk.end());
+        },
+        compression::FramedOptions{true, std::size_t{256} * 1024, &pool}};
+
+    encoder.feed(raw);
+    encoder.flush();
+
+    return container;
+  }
+
+  static bool decode(utils::bytes::ByteView container, utils::bytes::MutableByteView output,
+      utils::thread_pool::ThreadPool &pool)
+  {
+    compression::FramedArchive archive{container};
+    return archive.decompress(output, pool) == compression::ContainerError::None;
+  }
+};
+
+/**
+ * \brief Compress \p raw with the Blocked policy \p Algo, which runs its blocks on the pool itself.
+ */
+template <class Algo>
+struct BlockByBlock : Algo
+{
+  static utils::bytes::ByteSequence encode(
+      utils::bytes::ByteView raw, utils::thread_pool::ThreadPool &pool)
+  {
+    return Algo::encode(raw, pool);
+  }
+
+  static bool decode(utils::bytes::ByteView archive, utils::bytes::MutableByteView output,
+      utils::thread_pool::ThreadPool &pool)
+  {
+    return Algo::decode(archive, output, pool).has_value();
+  }
+};
+
+/**
+ * \brief Compress and decompress \p raw through \p Parallel, either InContainer or BlockByBlock,
+ * on 1, 2, 4... threads up to the hardware threads, to show how the wall-clock time scales.
+ */
+template <class Parallel>
+void scaling_benchmark(Report &report, const std::string &name, const corpus::Corpus &corpus)
+{
+  const auto &[corpus_name, raw] = corpus;
+
+  std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (std::size_t threads = 1; threads <= max_threads; threads *= 2)
+  {
+    auto threads_name = name + "/" + std::to_string(threads) + "_threads";
+    Entry encode{"parallel_encode", threads_name, corpus_name, raw.size()};
+    Entry decode{"parallel_decode", threads_name, corpus_name, raw.size()};
+    if (!report.selected(encode) && !report.selected(decode))
+    {
+      continue;
+    }
+
+    // The calling thread takes part as well as the workers of the pool.
+    std::optional<utils::thread_pool::ThreadPool> own_pool;
+    auto &pool = threads == 1 ? utils::thread_pool::ThreadPool::calling_thread()
+                              : own_pool.emplace(threads - 1);
+
+    auto archive = Parallel::encode(raw, pool);
+    utils::bytes::ByteSequence decoded(raw.size());
+    if (!Parallel::decode(archive, decoded, pool) || decoded != raw)
+    {
+      throw std::runtime_error{threads_name + " does not round trip on the " + corpus_name +
+          " corpus"};
+    }
+
+    encode.ratio = decode.ratio = double(archive.size()) / double(raw.size());
+
+    report.run(encode, [&] { keep(Parallel::encode(raw, pool)); });
+    report.run(decode, [&] { keep(Parallel::decode(archive, decoded, pool)); });
+  }
+}
+
+}  // namespace
+
+void codec_benchmarks(Report &report)
+{
+  using namespace compression::variants;
+
+  const auto &options = report.options();
+  auto corpora = corpus::all(options.corpus_size, options.seed);
+  auto messages = corpus::small_messages(options.messages_count, options.seed);
+
+  codec_benchmark<LZWCompressor>(report, "LZWCompressor", corpora, messages);
+  codec_benchmark<ImplicitLZWCompressor>(report, "ImplicitLZWCompressor", corpora, messages);
+  codec_benchmark<HuffmanCoding>(report, "HuffmanCoding", corpora, messages);
+  codec_benchmark<ANSCoding>(report, "ANSCoding", corpora, messages);
+  codec_benchmark<BlockedHuffmanCoding>(report, "BlockedHuffmanCoding", corpora, messages);
+  codec_benchmark<BlockedImplicitLZWCompressor>(
+      report, "BlockedImplicitLZWCompressor", corpora, messages);
+  codec_benchmark<LZWHuffmanCompressor>(report, "LZWHuffmanCompressor", corpora, messages);
+  codec_benchmark<AdaptiveCompressor>(report, "AdaptiveCompressor", corpora, messages);
+
+  scaling_benchmark<InContainer<compression::ImplicitLZW>>(report, "ImplicitLZW", corpora.front());
+  scaling_benchmark<InContainer<compression::LZW>>(report, "LZW", corpora.front());
+  scaling_benchmark<BlockByBlock<compression::Blocked<compression::Huffman>>>(
+      report, "BlockedHuffman", corpora.front());
+}
+
+}  // namespace bench
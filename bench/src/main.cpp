@@ -0,0 +1,78 @@
+#include "bench/harness.h"
+
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(std::int32_t argc, char **argv)
+{
+  bench::Options options;
+  std::string output;
+
+  for (std::int32_t arg = 1; arg < argc; arg += 2)
+  {
+    std::string option = argv[arg];
+    if (arg + 1 == argc)
+    {
+      option.clear();
+    }
+
+    if (option == "--size")
+    {
+      options.corpus_size = std::stoull(argv[arg + 1]);
+    }
+    else if (option == "--messages")
+    {
+      options.messages_count = std::stoull(argv[arg + 1]);
+    }
+    else if (option == "--repetitions")
+    {
+      options.repetitions = std::stoull(argv[arg + 1]);
+    }
+    else if (option == "--seed")
+    {
+      options.seed = std::stoull(argv[arg + 1]);
+    }
+    else if (option == "--filter")
+    {
+      options.filter = argv[arg + 1];
+    }
+    else if (option == "--output")
+    {
+      output = argv[arg + 1];
+    }
+    else
+    {
+      std::cerr << "usage: bench [--size <corpus_bytes>] [--messages <count>] [--repetitions <n>] "
+                   "[--seed <seed>] [--filter <substring>] [--output <json_file>]\n";
+      return 1;
+    }
+  }
+
+  bench::Report report{options};
+
+  try
+  {
+    bench::micro_benchmarks(report);
+    bench::codec_benchmarks(report);
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "bench: " << e.what() << "\n";
+    return 1;
+  }
+
+  if (output.empty())
+  {
+    report.write_json(std::cout);
+  }
+  else
+  {
+    std::ofstream file{output};
+    report.write_json(file);
+  }
+
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "bench/corpus.h"
+#include "bench/harness.h"
+#include "compression/dictionary.h"
+#include "compression/huffman.h"
+#include "compression/lzw.h"
+#include "utils/bytes.h"
+#include "utils/histogram.h"
+#include "utils/unaligned_storage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+
+namespace
+{
+
+struct HuffmanTree : compression::Huffman
+{
+  using BasicHuffman::code_lengths;
+};
+
+void bytes_benchmarks(Report &report)
+{
+  static constexpr std::size_t INTEGERS_COUNT = std::size_t{1} << 20;
+
+  report.run(Entry{"micro", "bytes_round_trip", "integers", 0, INTEGERS_COUNT}, [] {
+    std::uint64_t sum = 0;
+    for (std::uint64_t i = 0; i < INTEGERS_COUNT; i++)
+    {
+      auto bytes = utils::bytes::to_bytes(i * 0x9E3779B97F4A7C15ull);
+      sum += utils::bytes::from_bytes<std::uint64_t>(bytes);
+    }
+
+    keep(sum);
+  });
+
+  report.run(Entry{"micro", "bytes_count_bits", "integers", 0, INTEGERS_COUNT}, [] {
+    std::size_t sum = 0;
+    for (std::uint64_t i = 0; i < INTEGERS_COUNT; i++)
+    {
+      sum += utils::bytes::count_bits(i * 0x9E3779B97F4A7C15ull);
+    }
+
+    keep(sum);
+  });
+}
+
+void bit_io_benchmarks(Report &report, const utils::bytes::ByteSequence &text)
+{
+  // Codes of 9 to 20 bits, as written by the implicit LZW encoder.
+  std::vector<std::pair<std::uint32_t, std::size_t>> codes;
+  corpus::Random random{report.options().seed};
+  for (std::size_t i = 0; i + 2 < text.size(); i += 2)
+  {
+    auto bits = 9 + random.below(12);
+    codes.emplace_back(std::to_integer<std::uint32_t>(text[i]) * 4099 + i, bits);
+  }
+
+  utils::bytes::ByteSequence packed;
+  {
+    utils::unaligned_storage::BitWriter write_bits{packed};
+    for (auto [code, bits] : codes)
+    {
+      write_bits(code, bits);
+    }
+  }
+
+  report.run(Entry{"micro", "bit_writer", "codes", packed.size(), codes.size()}, [&] {
+    utils::bytes::ByteSequence out;
+    out.reserve(packed.size());
+
+    utils::unaligned_storage::BitWriter write_bits{out};
+    for (auto [code, bits] : codes)
+    {
+      write_bits(code, bits);
+    }
+
+    write_bits.flush();
+    keep(out);
+  });
+
+  report.run(Entry{"micro", "bit_reader", "codes", packed.size(), codes.size()}, [&] {
+    utils::unaligned_storage::BitReader reader{packed.data(), packed.data() + packed.size()};
+
+    std::uint64_t sum = 0;
+    for (auto [code, bits] : codes)
+    {
+      sum += reader.read(bits);
+    }
+
+    keep(sum);
+  });
+}
+
+void dictionary_benchmarks(Report &report, const utils::bytes::ByteSequence &text)
+{
+  auto build = [&text](compression::Dictionary &dict) {
+    compression::LZWEncoder encoder{dict};
+    std::size_t codes = 0;
+
+    encoder.feed(text.begin(), text.end(), [&codes](std::size_t) { codes++; });
+    encoder.flush([&codes](std::size_t) { codes++; });
+
+    return codes;
+  };
+
+  report.run(Entry{"micro", "dictionary_build", "text", text.size()}, [&] {
+    compression::Dictionary dict;
+    keep(build(dict));
+  });
+
+  compression::Dictionary dict;
+  build(dict);
+
+  auto lookups = dict.size() - compression::ASCII_TABLE_SIZE;
+  report.run(Entry{"micro", "dictionary_child_at", "text", 0, lookups}, [&] {
+    std::size_t sum = 0;
+    for (std::size_t i = compression::ASCII_TABLE_SIZE; i < dict.size(); i++)
+    {
+      auto node = dict.entry(i);
+      sum += *dict.child_at(node->parent, node->symbol);
+    }
+
+    keep(sum);
+  });
+}
+
+void huffman_benchmarks(Report &report, const utils::bytes::ByteSequence &text)
+{
+  report.run(Entry{"micro", "histogram_count", "text", text.size()}, [&] {
+    keep(utils::histogram::count(text.data(), text.data() + text.size()));
+  });
+
+  static constexpr std::size_t TREES_COUNT = 1000;
+
+  // Every byte value present, with skewed frequencies: the largest tree.
+  auto histogram = utils::histogram::count(text.data(), text.data() + text.size());
+  for (std::size_t symbol = 0; symbol < histogram.size(); symbol++)
+  {
+    histogram[symbol] += symbol + 1;
+  }
+
+  report.run(Entry{"micro", "huffman_code_lengths", "text", 0, TREES_COUNT}, [&] {
+    for (std::size_t i = 0; i < TREES_COUNT; i++)
+    {
+      keep(HuffmanTree::code_lengths(histogram));
+    }
+  });
+}
+
+}  // namespace
+
+void micro_benchmarks(Report &report)
+{
+  auto text = corpus::text(report.options().corpus_size, report.options().seed);
+
+  bytes_benchmarks(report);
+  bit_io_benchmarks(report, text);
+  dictionary_benchmarks(report, text);
+  huffman_benchmarks(report, text);
+}
+
+}  // namespace bench
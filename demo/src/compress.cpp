@@ -0,0 +1,150 @@
+#include "compression/adaptive.h"
+#include "compression/container.h"
+#include "compression/huffman.h"
+#include "compression/lzw.h"
+#include "demo/src/file_io.h"
+#include "utils/bytes.h"
+#include "utils/stats.h"
+#include "utils/thread_pool.h"
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+namespace
+{
+
+template <class Algo>
+std::size_t compress_file(
+    const std::string &path, demo::OutputFile &output_file, compression::FramedOptions options)
+{
+  compression::FramedEncoder<Algo> encoder{
+      [&](utils::bytes::ByteView chunk) { output_file.write(chunk); }, options};
+
+  auto raw_size = demo::feed_file(path, encoder);
+  encoder.flush();
+
+  return raw_size;
+}
+
+}  // namespace
+
+int main(std::int32_t argc, char **argv)
+{
+  std::string codec = "huffman";
+  compression::FramedOptions options;
+  std::size_t threads_count = 0;
+  std::string stats;
+
+  try
+  {
+    std::int32_t arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+      std::string option = argv[arg];
+      if (option == "--codec" && arg + 1 < argc)
+      {
+        codec = argv[++arg];
+      }
+      else if (option == "--stats" && arg + 1 < argc)
+      {
+        stats = argv[++arg];
+      }
+      else if (option == "--threads" && arg + 1 < argc)
+      {
+        threads_count = std::stoull(argv[++arg]);
+      }
+      else if (option == "--block-size" && arg + 1 < argc)
+      {
+        options.block_size = std::stoull(argv[++arg]);
+      }
+      else if (option == "--no-checksums")
+      {
+        options.checksums = false;
+      }
+      else
+      {
+        arg = argc;
+      }
+    }
+
+    if (argc - arg != 2 ||
+        (codec != "huffman" && codec != "lzw" && codec != "implicit-lzw" &&
+            codec != "lzw-huffman" && codec != "auto"))
+    {
+      std::cerr << "usage: compress [--codec huffman|lzw|implicit-lzw|lzw-huffman|auto] "
+                   "[--threads <count>] [--block-size <bytes>] [--no-checksums] "
+                   "[--stats <json_file>] <source_file> <output_file>\n";
+      return 1;
+    }
+
+    if (!stats.empty() && !utils::stats::ENABLED)
+    {
+      std::cerr << "compress: built without statistics, rebuild with --define stats=on\n";
+      return 1;
+    }
+
+    std::string source = argv[arg];
+    std::string output = argv[arg + 1];
+
+    // On a single thread, every block is compressed as soon as it is complete, without batches.
+    std::optional<utils::thread_pool::ThreadPool> own_pool;
+    if (threads_count != 1)
+    {
+      options.pool = &demo::thread_pool(threads_count, own_pool);
+    }
+
+    demo::OutputFile output_file{output, demo::size_hint(source)};
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t raw_size = 0;
+    if (codec == "huffman")
+    {
+      raw_size = compress_file<compression::Huffman>(source, output_file, options);
+    }
+    else if (codec == "lzw")
+    {
+      raw_size = compress_file<compression::LZW>(source, output_file, options);
+    }
+    else if (codec == "implicit-lzw")
+    {
+      raw_size = compress_file<compression::ImplicitLZW>(source, output_file, options);
+    }
+    else if (codec == "auto")
+    {
+      raw_size = compress_file<compression::Adaptive>(source, output_file, options);
+    }
+    else
+    {
+      raw_size = compress_file<compression::Chain<compression::ImplicitLZW, compression::Huffman>>(
+          source, output_file, options);
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    double compression_ratio = 1. * output_file.size() / raw_size * 100;
+
+    std::cout << "Compressed size: " << output_file.size() << " bytes.\n";
+    std::cout << "Compression ratio: " << compression_ratio << "%.\n";
+
+    std::chrono::duration<double> dur_s{t2 - t1};
+    std::cout << "Took " << dur_s.count() << "s.\n";
+
+    if (!stats.empty())
+    {
+      demo::write_stats(stats);
+    }
+
+    output_file.close();
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "compress: " << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
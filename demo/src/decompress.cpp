@@ -0,0 +1,237 @@
+#include "compression/container.h"
+#include "demo/src/file_io.h"
+#include "utils/bytes.h"
+#include "utils/mapped_file.h"
+#include "utils/stats.h"
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+
+namespace
+{
+
+const char *codec_name(compression::Codec codec)
+{
+  switch (codec)
+  {
+    case compression::Codec::LZW:
+      return "lzw";
+    case compression::Codec::ImplicitLZW:
+      return "implicit-lzw";
+    case compression::Codec::Huffman:
+      return "huffman";
+    case compression::Codec::LZWHuffman:
+      return "lzw-huffman";
+    case compression::Codec::Adaptive:
+      return "auto";
+  }
+
+  return "unknown";
+}
+
+/**
+ * \brief Decompress a regular file through its block table, a batch of blocks at a time, the
+ * blocks of a batch in parallel.
+ */
+compression::ContainerError decompress_mapped(
+    const std::string &path, const std::string &output, utils::thread_pool::ThreadPool &pool)
+{
+  utils::mapped_file::ReadOnlyFile file{path};
+  compression::FramedArchive archive{file.view()};
+  if (archive.error() != compression::ContainerError::None)
+  {
+    return archive.error();
+  }
+
+  std::cout << "Codec: " << codec_name(archive.codec()) << ".\n";
+
+  demo::OutputFile output_file{output, archive.raw_size()};
+
+  const auto &blocks = archive.blocks();
+  auto batch_size = 2 * (pool.size() + 1);
+  utils::bytes::ByteSequence batch;
+
+  for (std::size_t first = 0; first < blocks.size(); first += batch_size)
+  {
+    auto count = std::min(batch_size, blocks.size() - first);
+    const auto &last = blocks[first + count - 1];
+
+    batch.resize(last.raw_offset + last.header.raw_size - blocks[first].raw_offset);
+    if (auto error = archive.decompress_blocks(first, count, batch, pool);
+        error != compression::ContainerError::None)
+    {
+      return error;
+    }
+
+    output_file.write(batch);
+    file.release(last.offset + last.header.size);
+  }
+
+  output_file.close();
+  return compression::ContainerError::None;
+}
+
+/**
+ * \brief Decompress the \p length bytes of uncompressed data starting at \p offset, up to the end
+ * of the data by default, decoding only the blocks that cover them.
+ */
+compression::ContainerError decompress_range(const std::string &path, const std::string &output,
+    std::uint64_t offset, std::optional<std::uint64_t> length,
+    utils::thread_pool::ThreadPool &pool)
+{
+  utils::mapped_file::ReadOnlyFile file{path};
+  compression::FramedArchive archive{file.view()};
+  if (archive.error() != compression::ContainerError::None)
+  {
+    return archive.error();
+  }
+
+  if (offset > archive.raw_size())
+  {
+    return compression::ContainerError::OutOfRange;
+  }
+
+  auto size = length.value_or(archive.raw_size() - offset);
+  if (size > archive.raw_size() - offset)
+  {
+    return compression::ContainerError::OutOfRange;
+  }
+
+  utils::bytes::ByteSequence slice(size);
+  if (auto error = archive.decompress_range(offset, slice, pool);
+      error != compression::ContainerError::None)
+  {
+    return error;
+  }
+
+  demo::OutputFile output_file{output, slice.size()};
+  output_file.write(slice);
+  output_file.close();
+
+  return compression::ContainerError::None;
+}
+
+/**
+ * \brief Decompress a pipe or any other file that cannot be mapped, block after block.
+ */
+compression::ContainerError decompress_stream(const std::string &path, const std::string &output)
+{
+  demo::OutputFile output_file{output, 0};
+  compression::FramedDecoder decoder{
+      [&](utils::bytes::ByteView chunk) { output_file.write(chunk); }};
+
+  demo::feed_file(path, decoder);
+
+  if (auto codec = decoder.codec())
+  {
+    std::cout << "Codec: " << codec_name(*codec) << ".\n";
+  }
+
+  output_file.close();
+  return decoder.flush();
+}
+
+}  // namespace
+
+int main(std::int32_t argc, char **argv)
+{
+  std::optional<std::uint64_t> offset;
+  std::optional<std::uint64_t> length;
+  std::size_t threads_count = 0;
+  std::string stats;
+
+  try
+  {
+    std::int32_t arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+      std::string option = argv[arg];
+      if (option == "--offset" && arg + 1 < argc)
+      {
+        offset = std::stoull(argv[++arg]);
+      }
+      else if (option == "--length" && arg + 1 < argc)
+      {
+        length = std::stoull(argv[++arg]);
+      }
+      else if (option == "--threads" && arg + 1 < argc)
+      {
+        threads_count = std::stoull(argv[++arg]);
+      }
+      else if (option == "--stats" && arg + 1 < argc)
+      {
+        stats = argv[++arg];
+      }
+      else
+      {
+        arg = argc;
+      }
+    }
+
+    // A length only makes sense from an offset.
+    if (argc - arg != 2 || (length && !offset))
+    {
+      std::cerr << "usage: decompress [--offset <offset> [--length <length>]] [--threads <count>] "
+                   "[--stats <json_file>] <compressed_file> <output_file>\n";
+      return 1;
+    }
+
+    if (!stats.empty() && !utils::stats::ENABLED)
+    {
+      std::cerr << "decompress: built without statistics, rebuild with --define stats=on\n";
+      return 1;
+    }
+
+    std::string source = argv[arg];
+    std::string output = argv[arg + 1];
+
+    std::optional<utils::thread_pool::ThreadPool> own_pool;
+    auto &pool = demo::thread_pool(threads_count, own_pool);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    compression::ContainerError error;
+    if (offset)
+    {
+      error = decompress_range(source, output, *offset, length, pool);
+    }
+    else if (std::filesystem::is_regular_file(source))
+    {
+      error = decompress_mapped(source, output, pool);
+    }
+    else
+    {
+      error = decompress_stream(source, output);
+    }
+
+    if (error != compression::ContainerError::None)
+    {
+      std::cerr << "decompress: " << compression::describe(error) << "\n";
+      return 1;
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    std::chrono::duration<double> dur_s{t2 - t1};
+    std::cout << "Took " << dur_s.count() << "s.\n";
+
+    if (!stats.empty())
+    {
+      demo::write_stats(stats);
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "decompress: " << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,439 @@
+#pragma once
+
+#include "utils/bytes.h"
+#include "utils/mapped_file.h"
+#include "utils/stats.h"
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace demo
+{
+
+/**
+ * \brief The size of the file at \p path, or 0 if it is not a regular file.
+ */
+inline std::size_t size_hint(const std::string &path)
+{
+  return std::filesystem::is_regular_file(path) ? std::filesystem::file_size(path) : 0;
+}
+
+/**
+ * \brief The pool running the blocks for the --threads option: the shared pool for 0, the calling
+ * thread alone for 1, and otherwise \p own_pool, made with \p threads_count - 1 workers since the
+ * calling thread takes part as well.
+ */
+inline utils::thread_pool::ThreadPool &thread_pool(
+    std::size_t threads_count, std::optional<utils::thread_pool::ThreadPool> &own_pool)
+{
+  if (threads_count == 0)
+  {
+    return utils::thread_pool::ThreadPool::shared();
+  }
+
+  if (threads_count == 1)
+  {
+    return utils::thread_pool::ThreadPool::calling_thread();
+  }
+
+  return own_pool.emplace(threads_count - 1);
+}
+
+namespace detail
+{
+
+/**
+ * \brief Queue handing values over from one thread to another.
+ *
+ * pop() waits for a value, and returns none once the channel is closed and drained. The stages
+ * bound their memory by passing a fixed set of buffers back and forth, so the queue itself is not
+ * bounded.
+ */
+template <class T>
+class Channel
+{
+public:
+  void push(T value)
+  {
+    {
+      std::lock_guard lock{mutex_};
+      values_.push_back(std::move(value));
+    }
+
+    cv_.notify_one();
+  }
+
+  std::optional<T> pop()
+  {
+    std::unique_lock lock{mutex_};
+    cv_.wait(lock, [this] { return !values_.empty() || closed_; });
+
+    if (values_.empty())
+    {
+      return std::nullopt;
+    }
+
+    auto value = std::move(values_.front());
+    values_.pop_front();
+    return value;
+  }
+
+  void close()
+  {
+    {
+      std::lock_guard lock{mutex_};
+      closed_ = true;
+    }
+
+    cv_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<T> values_;
+  bool closed_ = false;
+};
+
+/**
+ * \brief Feed \p file to \p stream while a reader thread fills the next chunks, so that reading
+ * and compressing overlap. The chunks go round between the two threads, three of them so that the
+ * reader can stay ahead when the reads are uneven.
+ */
+template <class Stream>
+std::size_t feed_pipelined(std::ifstream &file, Stream &stream)
+{
+  static constexpr std::size_t CHUNKS_COUNT = 3;
+  static constexpr std::size_t CHUNK_SIZE = std::size_t{1} << 20;
+
+  struct Chunk
+  {
+    std::size_t index;
+    std::size_t size;
+  };
+
+  std::array<utils::bytes::ByteSequence, CHUNKS_COUNT> chunks;
+  Channel<Chunk> empty_chunks;
+  Channel<Chunk> full_chunks;
+
+  for (std::size_t i = 0; i < CHUNKS_COUNT; i++)
+  {
+    chunks[i].resize(CHUNK_SIZE);
+    empty_chunks.push({i, 0});
+  }
+
+  std::exception_ptr error;
+  std::thread reader{[&] {
+    try
+    {
+      while (auto chunk = empty_chunks.pop())
+      {
+        file.read(reinterpret_cast<char *>(chunks[chunk->index].data()), CHUNK_SIZE);
+        if (!(chunk->size = std::size_t(file.gcount())))
+        {
+          break;
+        }
+
+        full_chunks.push(*chunk);
+      }
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+
+    full_chunks.close();
+  }};
+
+  std::size_t size = 0;
+
+  try
+  {
+    while (auto chunk = full_chunks.pop())
+    {
+      stream.feed(utils::bytes::ByteView{chunks[chunk->index].data(), chunk->size});
+      size += chunk->size;
+
+      empty_chunks.push(*chunk);
+    }
+  }
+  catch (...)
+  {
+    empty_chunks.close();
+    reader.join();
+    throw;
+  }
+
+  reader.join();
+
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+
+  return size;
+}
+
+}  // namespace detail
+
+/**
+ * \brief Feed the whole content of the file at \p path to \p stream.
+ *
+ * Regular files are memory mapped and fed without copying them, a window at a time so that the
+ * pages already consumed are released, while the kernel reads the next window ahead. Other files,
+ * such as pipes, are read in chunks, by a reader thread if \p pipelined.
+ * \returns The size of the file.
+ */
+template <class Stream>
+std::size_t feed_file(const std::string &path, Stream &stream, bool pipelined = false)
+{
+  if (std::filesystem::is_regular_file(path))
+  {
+    static constexpr std::size_t WINDOW_SIZE = std::size_t{4} << 20;
+
+    utils::mapped_file::ReadOnlyFile file{path};
+    auto view = file.view();
+
+    for (std::size_t offset = 0; offset < view.size(); offset += WINDOW_SIZE)
+    {
+      file.prefetch(offset + WINDOW_SIZE, WINDOW_SIZE);
+      stream.feed(view.subspan(offset, std::min(WINDOW_SIZE, view.size() - offset)));
+      file.release(offset + WINDOW_SIZE);
+    }
+
+    return view.size();
+  }
+
+  std::ifstream file{path, std::ios_base::in | std::ios_base::binary};
+  if (!file)
+  {
+    throw std::system_error{errno, std::generic_category(), "cannot open " + path};
+  }
+
+  if (pipelined)
+  {
+    return detail::feed_pipelined(file, stream);
+  }
+
+  utils::bytes::ByteSequence chunk(1 << 16);
+  std::size_t size = 0;
+
+  while (file.read(reinterpret_cast<char *>(chunk.data()), chunk.size()) || file.gcount())
+  {
+    stream.feed(utils::bytes::ByteView{chunk.data(), std::size_t(file.gcount())});
+    size += file.gcount();
+  }
+
+  return size;
+}
+
+/**
+ * \brief Output file, memory mapped if it is a regular file or does not exist yet, and written
+ * through a stream otherwise.
+ *
+ * If \p pipelined, the bytes are copied into buffers that a writer thread writes in order, so that
+ * writing overlaps with compressing. The writes only wait when all the buffers are in flight.
+ */
+class OutputFile
+{
+public:
+  OutputFile(const std::string &path, std::size_t expected_size, bool pipelined = false)
+  {
+    auto type = std::filesystem::status(path).type();
+    if (type == std::filesystem::file_type::not_found ||
+        type == std::filesystem::file_type::regular)
+    {
+      mapped_.emplace(path, expected_size);
+    }
+    else
+    {
+      stream_.open(path, std::ios_base::out | std::ios_base::binary);
+    }
+
+    if (pipelined)
+    {
+      for (std::size_t i = 0; i < BUFFERS_COUNT - 1; i++)
+      {
+        empty_buffers_.push({});
+      }
+
+      buffer_.reserve(BUFFER_SIZE);
+      writer_ = std::thread{[this] { write_buffers(); }};
+    }
+  }
+
+  OutputFile(const OutputFile &) = delete;
+  OutputFile &operator=(const OutputFile &) = delete;
+
+  ~OutputFile()
+  {
+    if (writer_.joinable())
+    {
+      full_buffers_.close();
+      writer_.join();
+    }
+  }
+
+  void write(utils::bytes::ByteView bytes)
+  {
+    size_ += bytes.size();
+
+    if (!writer_.joinable())
+    {
+      write_through(bytes);
+      return;
+    }
+
+    while (!bytes.empty())
+    {
+      auto count = std::min(BUFFER_SIZE - buffer_.size(), bytes.size());
+      buffer_.insert(buffer_.end(), bytes.begin(), bytes.begin() + count);
+      bytes = bytes.subspan(count);
+
+      if (buffer_.size() == BUFFER_SIZE)
+      {
+        hand_over_buffer();
+      }
+    }
+  }
+
+  std::size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  void close()
+  {
+    if (writer_.joinable())
+    {
+      if (!buffer_.empty())
+      {
+        full_buffers_.push(std::move(buffer_));
+      }
+
+      full_buffers_.close();
+      writer_.join();
+
+      if (error_)
+      {
+        std::rethrow_exception(error_);
+      }
+    }
+
+    if (mapped_)
+    {
+      mapped_->close();
+    }
+    else
+    {
+      stream_.close();
+    }
+  }
+
+private:
+  static constexpr std::size_t BUFFERS_COUNT = 3;
+  static constexpr std::size_t BUFFER_SIZE = std::size_t{1} << 20;
+
+  void write_through(utils::bytes::ByteView bytes)
+  {
+    utils::stats::PhaseTimer timer{"io.write"};
+
+    if (mapped_)
+    {
+      mapped_->write(bytes);
+    }
+    else
+    {
+      stream_.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+  }
+
+  /**
+   * \brief Queue the current buffer for the writer, and take the next one from the buffers it has
+   * written, waiting for one if need be.
+   */
+  void hand_over_buffer()
+  {
+    full_buffers_.push(std::move(buffer_));
+
+    auto buffer = empty_buffers_.pop();
+    if (!buffer)
+    {
+      // The writer stopped on an error, which close() reports.
+      full_buffers_.close();
+      writer_.join();
+      std::rethrow_exception(error_);
+    }
+
+    buffer_ = std::move(*buffer);
+    buffer_.clear();
+    buffer_.reserve(BUFFER_SIZE);
+  }
+
+  void write_buffers()
+  {
+    try
+    {
+      while (auto buffer = full_buffers_.pop())
+      {
+        write_through(*buffer);
+        empty_buffers_.push(std::move(*buffer));
+      }
+    }
+    catch (...)
+    {
+      error_ = std::current_exception();
+    }
+
+    empty_buffers_.close();
+  }
+
+  std::optional<utils::mapped_file::WritableFile> mapped_;
+  std::ofstream stream_;
+  std::size_t size_ = 0;
+
+  utils::bytes::ByteSequence buffer_;
+  detail::Channel<utils::bytes::ByteSequence> full_buffers_;
+  detail::Channel<utils::bytes::ByteSequence> empty_buffers_;
+  std::exception_ptr error_;
+  std::thread writer_;
+};
+
+/**
+ * \brief Write the statistics collected so far as JSON to the file at \p path, or to the standard
+ * error if \p path is "-".
+ */
+inline void write_stats(const std::string &path)
+{
+  if (path == "-")
+  {
+    utils::stats::registry().write_json(std::cerr);
+    return;
+  }
+
+  std::ofstream file{path};
+  if (!file)
+  {
+    throw std::system_error{errno, std::generic_category(), "cannot create " + path};
+  }
+
+  utils::stats::registry().write_json(file);
+}
+
+}  // namespace demo
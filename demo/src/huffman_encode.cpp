@@ -1,46 +1,79 @@
 #include "compression/variants.h"
+#include "demo/src/file_io.h"
 #include "utils/bytes.h"
+#include "utils/thread_pool.h"
 
 #include <chrono>
-#include <filesystem>
-#include <fstream>
-#include <ios>
+#include <exception>
 #include <iostream>
+#include <optional>
 #include <string>
 
 int main(std::int32_t argc, char **argv)
 {
-  using compression::variants::HuffmanCoding;
+  using compression::variants::HuffmanStreamEncoder;
 
-  if (argc < 3)
+  std::size_t threads_count = 0;
+  bool pipelined = true;
+
+  try
   {
-    std::cerr << "usage: huffman_encode <source_file> <output_file>\n";
-    return 1;
-  }
+    std::int32_t arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+      std::string option = argv[arg];
+      if (option == "--threads" && arg + 1 < argc)
+      {
+        threads_count = std::stoull(argv[++arg]);
+      }
+      else if (option == "--no-pipeline")
+      {
+        pipelined = false;
+      }
+      else
+      {
+        arg = argc;
+      }
+    }
+
+    if (argc - arg != 2)
+    {
+      std::cerr << "usage: huffman_encode [--threads <count>] [--no-pipeline] <source_file> "
+                   "<output_file>\n";
+      return 1;
+    }
 
-  auto raw_file_size = std::filesystem::file_size(argv[1]);
-  std::ifstream raw_file{argv[1], std::ios_base::in | std::ios_base::binary};
+    std::string source = argv[arg];
+    std::string output = argv[arg + 1];
 
-  utils::bytes::ByteSequence raw(raw_file_size);
-  raw_file.read(static_cast<char *>((void *)raw.data()), raw_file_size);
-  raw_file.close();
+    std::optional<utils::thread_pool::ThreadPool> own_pool;
+    auto &pool = demo::thread_pool(threads_count, own_pool);
 
-  auto t1 = std::chrono::high_resolution_clock::now();
+    demo::OutputFile archived_file{output, demo::size_hint(source), pipelined};
+    HuffmanStreamEncoder encoder{
+        [&](utils::bytes::ByteView chunk) { archived_file.write(chunk); }, pool};
 
-  auto encoded = HuffmanCoding::compress(raw);
+    auto t1 = std::chrono::high_resolution_clock::now();
 
-  double compression_ratio = 1. * encoded.size() / raw_file_size * 100;
+    auto raw_size = demo::feed_file(source, encoder, pipelined);
+    encoder.flush();
+    archived_file.close();
 
-  std::cout << "Encoded size: " << encoded.size() << " bytes.\n";
-  std::cout << "Compression ratio: " << compression_ratio << "%.\n";
+    auto t2 = std::chrono::high_resolution_clock::now();
 
-  auto t2 = std::chrono::high_resolution_clock::now();
+    double compression_ratio = 1. * archived_file.size() / raw_size * 100;
 
-  std::chrono::duration<double> dur_s{t2 - t1};
-  std::cout << "Took " << dur_s.count() << "s.\n";
+    std::cout << "Encoded size: " << archived_file.size() << " bytes.\n";
+    std::cout << "Compression ratio: " << compression_ratio << "%.\n";
 
-  std::ofstream archived_file{argv[2], std::ios_base::out | std::ios_base::binary};
-  archived_file.write((char *)encoded.data(), encoded.size());
+    std::chrono::duration<double> dur_s{t2 - t1};
+    std::cout << "Took " << dur_s.count() << "s.\n";
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "huffman_encode: " << e.what() << "\n";
+    return 1;
+  }
 
   return 0;
 }
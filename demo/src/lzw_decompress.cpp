@@ -1,41 +1,81 @@
 #include "compression/variants.h"
+#include "demo/src/file_io.h"
 #include "utils/bytes.h"
+#include "utils/thread_pool.h"
 
 #include <chrono>
-#include <filesystem>
-#include <fstream>
-#include <ios>
+#include <exception>
 #include <iostream>
+#include <optional>
 #include <string>
 
 int main(std::int32_t argc, char **argv)
 {
-  using compression::variants::LZWCompressor;
+  using compression::variants::LZWStreamDecoder;
 
-  if (argc < 3)
+  std::size_t threads_count = 0;
+  bool pipelined = true;
+
+  try
   {
-    std::cerr << "usage: lzw_decompress <archived_file> <output_file>\n";
-    return 1;
-  }
+    std::int32_t arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+      std::string option = argv[arg];
+      if (option == "--threads" && arg + 1 < argc)
+      {
+        threads_count = std::stoull(argv[++arg]);
+      }
+      else if (option == "--no-pipeline")
+      {
+        pipelined = false;
+      }
+      else
+      {
+        arg = argc;
+      }
+    }
+
+    if (argc - arg != 2)
+    {
+      std::cerr << "usage: lzw_decompress [--threads <count>] [--no-pipeline] <archived_file> "
+                   "<output_file>\n";
+      return 1;
+    }
+
+    std::string source = argv[arg];
+    std::string output = argv[arg + 1];
 
-  auto archived_file_size = std::filesystem::file_size(argv[1]);
-  std::ifstream archived_file{argv[1], std::ios_base::in | std::ios_base::binary};
+    std::optional<utils::thread_pool::ThreadPool> own_pool;
+    auto &pool = demo::thread_pool(threads_count, own_pool);
 
-  utils::bytes::ByteSequence archived(archived_file_size);
-  archived_file.read(static_cast<char *>((void *)archived.data()), archived_file_size);
-  archived_file.close();
+    // Most archives expand to less than three times their size; the output grows otherwise.
+    demo::OutputFile output_file{output, 3 * demo::size_hint(source), pipelined};
+    LZWStreamDecoder decoder{
+        [&](utils::bytes::ByteView chunk) { output_file.write(chunk); }, pool};
 
-  auto t1 = std::chrono::high_resolution_clock::now();
+    auto t1 = std::chrono::high_resolution_clock::now();
 
-  auto decoded = LZWCompressor::decompress(archived);
+    demo::feed_file(source, decoder, pipelined);
 
-  auto t2 = std::chrono::high_resolution_clock::now();
+    if (!decoder.flush())
+    {
+      std::cerr << "lzw_decompress: the archive is truncated or corrupt\n";
+      return 1;
+    }
 
-  std::chrono::duration<double> dur_s{t2 - t1};
-  std::cout << "Took " << dur_s.count() << "s.\n";
+    output_file.close();
 
-  std::ofstream output_file{argv[2], std::ios_base::out | std::ios_base::binary};
-  output_file.write((char *)decoded.data(), decoded.size());
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    std::chrono::duration<double> dur_s{t2 - t1};
+    std::cout << "Took " << dur_s.count() << "s.\n";
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "lzw_decompress: " << e.what() << "\n";
+    return 1;
+  }
 
   return 0;
 }
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "compression/huffman.h"
+#include "compression/lzw.h"
+#include "utils/bytes.h"
+#include "utils/histogram.h"
+#include "utils/stats.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+namespace compression
+{
+
+/**
+ * \brief How an Adaptive archive stores its data, as recorded in its first byte.
+ */
+enum class AdaptiveMethod : std::uint8_t
+{
+  Stored = 0,  ///< The raw bytes, as is.
+  Repetitive = 1,
+  Skewed = 2,
+};
+
+/**
+ * \brief A cheap estimate of how compressible a block is, from a sample of it.
+ */
+struct BlockProfile
+{
+  /**
+   * \brief The sample is made of SAMPLE_WINDOWS windows of SAMPLE_WINDOW_SIZE bytes, evenly
+   * spread over the block, so that its head does not stand for all of it.
+   */
+  static constexpr std::size_t SAMPLE_WINDOWS = 8;
+  static constexpr std::size_t SAMPLE_WINDOW_SIZE = 2048;
+
+  /**
+   * \brief The order-0 entropy of the sample, in bits per byte.
+   */
+  double entropy = 8;
+
+  /**
+   * \brief The share of the sampled positions starting a 4-byte sequence already seen at a recent
+   * position of the sample.
+   */
+  double repeats = 0;
+
+  static BlockProfile make(utils::bytes::ByteView block) noexcept
+  {
+    BlockProfile profile;
+    if (block.empty())
+    {
+      return profile;
+    }
+
+    auto window_size = std::min(SAMPLE_WINDOW_SIZE, block.size() / SAMPLE_WINDOWS);
+    auto windows_count = SAMPLE_WINDOWS;
+    if (window_size < 4)
+    {
+      window_size = block.size();
+      windows_count = 1;
+    }
+
+    utils::histogram::Histogram histogram{};
+    std::array<std::uint32_t, std::size_t{1} << HASH_BITS> recent{};
+    std::size_t positions = 0;
+    std::size_t repeats = 0;
+
+    for (std::size_t i = 0; i < windows_count; i++)
+    {
+      auto offset = (block.size() - window_size) / std::max<std::size_t>(windows_count - 1, 1) * i;
+      auto window = block.subspan(offset, window_size);
+      utils::histogram::accumulate(window.begin(), window.end(), histogram);
+
+      for (std::size_t pos = 0; pos + 4 <= window.size(); pos++, positions++)
+      {
+        std::uint32_t sequence;
+        std::memcpy(&sequence, window.data() + pos, sizeof(sequence));
+
+        auto &slot = recent[(sequence * 2654435761u) >> (32 - HASH_BITS)];
+        repeats += slot == sequence;
+        slot = sequence;
+      }
+    }
+
+    std::size_t sampled = 0;
+    for (auto count : histogram)
+    {
+      sampled += count;
+    }
+
+    profile.entropy = 0;
+    for (auto count : histogram)
+    {
+      if (count)
+      {
+        auto p = double(count) / double(sampled);
+        profile.entropy -= p * std::log2(p);
+      }
+    }
+
+    profile.repeats = positions ? double(repeats) / double(positions) : 0;
+
+    return profile;
+  }
+
+private:
+  /**
+   * \brief The recent sequences are remembered by a hash of this many bits, one per hash.
+   */
+  static constexpr std::size_t HASH_BITS = 12;
+};
+
+/**
+ * \brief Compress every input with whichever of \p Repetitive, \p Skewed or no coding at all suits
+ * it, as estimated from a BlockProfile of the input.
+ *
+ * Inputs repeating many 4-byte sequences go to Repetitive, an LZW policy. The others go to Skewed,
+ * an entropy coder, if their byte distribution is skewed enough to save a few percent, and are
+ * stored otherwise. Only a sample of the input is read to choose, so incompressible inputs, such as
+ * already compressed data, are not compressed at all. Should the chosen policy expand the input
+ * anyway, it is stored instead, so that no archive is larger than its input by more than a byte.
+ *
+ * Archive structure:
+ *  - the AdaptiveMethod, on 1 byte.
+ *  - the archive of the chosen policy, or the raw bytes if stored.
+ */
+template <class Repetitive, class Skewed>
+class BasicAdaptive
+{
+  /**
+   * \brief Grants access to the protected interface of a policy.
+   */
+  template <class Algo>
+  struct Policy : Algo
+  {
+    using Algo::decode;
+    using Algo::encode;
+  };
+
+protected:
+  /**
+   * \brief The share of repeated 4-byte sequences above which Repetitive is chosen.
+   */
+  static constexpr double MIN_REPEATS = 0.15;
+
+  /**
+   * \brief The entropy, in bits per byte, below which Skewed is chosen, so that it saves at least
+   * 1 / 16 of the input.
+   */
+  static constexpr double MAX_SKEWED_ENTROPY = 7.5;
+
+  static AdaptiveMethod choose(utils::bytes::ByteView raw)
+  {
+    utils::stats::PhaseTimer timer{"adaptive.estimate"};
+    auto profile = BlockProfile::make(raw);
+
+    if (profile.repeats >= MIN_REPEATS)
+    {
+      return AdaptiveMethod::Repetitive;
+    }
+
+    if (profile.entropy <= MAX_SKEWED_ENTROPY)
+    {
+      return AdaptiveMethod::Skewed;
+    }
+
+    return AdaptiveMethod::Stored;
+  }
+
+  /**
+   * \brief Stored archives are the largest ones: any policy expanding the input is replaced by
+   * them.
+   */
+  static constexpr std::size_t compress_bound(std::size_t raw_size) noexcept
+  {
+    return 1 + raw_size;
+  }
+
+  /**
+   * \brief Encode through the caller-owned buffer overload, which leaves room for the method byte
+   * in front of the policy archive, into compress_bound() bytes, where the stored archive fits.
+   */
+  static utils::bytes::ByteSequence encode(utils::bytes::ByteView raw)
+  {
+    utils::bytes::ByteSequence encoded(compress_bound(raw.size()));
+    encoded.resize(*encode(raw, encoded));
+
+    return encoded;
+  }
+
+  static std::optional<std::size_t> encode(
+      utils::bytes::ByteView raw, utils::bytes::MutableByteView output)
+  {
+    if (output.empty())
+    {
+      return std::nullopt;
+    }
+
+    // The policy output is capped to the raw size: beyond it, the stored archive is smaller.
+    auto method = choose(raw);
+    auto payload = output.subspan(1, std::min(raw.size(), output.size() - 1));
+
+    std::optional<std::size_t> size;
+    if (method == AdaptiveMethod::Repetitive)
+    {
+      size = Policy<Repetitive>::encode(raw, payload);
+    }
+    else if (method == AdaptiveMethod::Skewed)
+    {
+      size = Policy<Skewed>::encode(raw, payload);
+    }
+
+    if (!size || *size >= raw.size())
+    {
+      method = AdaptiveMethod::Stored;
+      if (payload.size() < raw.size())
+      {
+        return std::nullopt;
+      }
+
+      size = raw.size();
+      std::copy(raw.begin(), raw.end(), payload.begin());
+    }
+
+    record_stats(method);
+    output[0] = std::byte(method);
+
+    return 1 + *size;
+  }
+
+  static utils::bytes::ByteSequence decode(utils::bytes::ByteView encoded)
+  {
+    if (encoded.empty())
+    {
+      return {};
+    }
+
+    auto payload = encoded.subspan(1);
+    switch (AdaptiveMethod(std::to_integer<std::uint8_t>(encoded[0])))
+    {
+      case AdaptiveMethod::Stored:
+        return utils::bytes::ByteSequence(payload.begin(), payload.end());
+      case AdaptiveMethod::Repetitive:
+        return Policy<Repetitive>::decode(payload);
+      case AdaptiveMethod::Skewed:
+        return Policy<Skewed>::decode(payload);
+    }
+
+    return {};
+  }
+
+  static std::optional<std::size_t> decode(
+      utils::bytes::ByteView encoded, utils::bytes::MutableByteView output)
+  {
+    if (encoded.empty())
+    {
+      return std::nullopt;
+    }
+
+    auto payload = encoded.subspan(1);
+    switch (AdaptiveMethod(std::to_integer<std::uint8_t>(encoded[0])))
+    {
+      case AdaptiveMethod::Stored:
+        if (payload.size() > output.size())
+        {
+          return std::nullopt;
+        }
+
+        std::copy(payload.begin(), payload.end(), output.begin());
+        return payload.size();
+      case AdaptiveMethod::Repetitive:
+        return Policy<Repetitive>::decode(payload, output);
+      case AdaptiveMethod::Skewed:
+        return Policy<Skewed>::decode(payload, output);
+    }
+
+    return std::nullopt;
+  }
+
+private:
+  static void record_stats(AdaptiveMethod method)
+  {
+    switch (method)
+    {
+      case AdaptiveMethod::Stored:
+        utils::stats::add("adaptive.stored", 1);
+        break;
+      case AdaptiveMethod::Repetitive:
+        utils::stats::add("adaptive.repetitive", 1);
+        break;
+      case AdaptiveMethod::Skewed:
+        utils::stats::add("adaptive.skewed", 1);
+        break;
+    }
+  }
+};
+
+using Adaptive = BasicAdaptive<ImplicitLZW, Huffman>;
+
+}  // namespace compression
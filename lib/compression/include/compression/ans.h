@@ -0,0 +1,783 @@
+#pragma once
+
+#include "utils/bytes.h"
+#include "utils/histogram.h"
+#include "utils/stats.h"
+#include "utils/unaligned_storage.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+
+namespace compression
+{
+
+/**
+ * \brief Table-based asymmetric numeral systems (tANS), the entropy coder of FSE and Zstandard,
+ * with tables of up to 2^TableLog states.
+ *
+ * The byte frequencies are normalized to sum to the table size, and every byte owns as many states
+ * as its normalized frequency, spread over the table. Coding a byte moves from one state to
+ * another, and outputs the low bits of the state that the move drops, so bytes cost a fractional
+ * number of bits on average: skewed distributions do not waste up to a bit per byte as Huffman
+ * codes do. Both directions are a table lookup, a shift and a mask per byte, without branches.
+ *
+ * Archive structure:
+ *  - control byte: mask 11110000 gives the size of the elements counter, mask 00000011 the log2 of
+ *    the streams count.
+ *  - table log, on 1 byte: 0 if the input holds a single distinct byte.
+ *  - elements counter.
+ *  - with a single distinct byte: that byte, if the input is not empty.
+ *  - otherwise:
+ *    - a 32-byte bitmap of the used bytes.
+ *    - the normalized frequency of every used byte, minus 1, on table log bits, LSB-first.
+ *    - jump table: the size in bytes of every stream but the last, on as many bytes as the elements
+ *      counter.
+ *    - the streams, LSB-first: the bits dropped by the bytes of the segment, from the last to the
+ *      first, then the final states of the odd and of the even offsets, on table log bits each,
+ *      and a 1 bit marking the end.
+ *
+ * The encoder goes through every segment backwards, so that the decoder, which reads the bits
+ * backwards too (see utils::unaligned_storage::ReverseBitReader), outputs the bytes in order. As
+ * with BasicHuffman, the input is cut into \p StreamsCount segments decoded side by side, and
+ * inputs shorter than MIN_INTERLEAVED_SIZE make a single stream. Within a segment, the bytes at
+ * even and at odd offsets take turns over two states, so that every stream makes two dependency
+ * chains, interleaved in the same bits.
+ */
+template <std::uint8_t TableLog = 11, std::uint8_t StreamsCount = 4>
+class BasicANS
+{
+  static_assert(TableLog >= 9 && TableLog <= 12,
+      "The table must hold twice the 256 symbols, and stay within the L1 cache.");
+  static_assert(StreamsCount == 1 || StreamsCount == 2 || StreamsCount == 4 || StreamsCount == 8,
+      "The streams count is stored as its log2 on 2 bits.");
+
+  static constexpr std::size_t MIN_TABLE_LOG = 5;
+  static constexpr std::size_t BITMAP_SIZE = 256 / 8;
+  static constexpr std::uint8_t STREAMS_MASK = 0x3;
+
+  static constexpr std::size_t MIN_INTERLEAVED_SIZE = 1024;
+
+  /**
+   * \brief How many pairs of bytes fit in the bit I/O buffers between two commits or refills.
+   */
+  static constexpr std::size_t PAIRS_PER_COMMIT = 57 / (2 * TableLog);
+  static constexpr std::size_t PAIRS_PER_REFILL = 56 / (2 * TableLog);
+
+  /**
+   * \brief The first byte of every stream, followed by the end of the last one.
+   */
+  using StreamBounds = std::array<const std::byte *, 8 + 1>;
+
+  using Counts = std::array<std::uint16_t, 256>;
+  using Spread = std::array<std::uint8_t, std::size_t{1} << TableLog>;
+
+  /**
+   * \brief How the encoder leaves a state with a given byte: it drops the
+   * (state + delta_bits) >> 16 low bits of the state, and moves to the state at
+   * (state >> bits) + delta_state in the states table.
+   */
+  struct SymbolTransform
+  {
+    std::uint32_t delta_bits;
+    std::int32_t delta_state;
+  };
+
+  struct EncodeTable
+  {
+    std::array<SymbolTransform, 256> transforms;
+    std::array<std::uint16_t, std::size_t{1} << TableLog> states;
+
+    static void make(const Counts &counts, std::size_t table_log, EncodeTable &table) noexcept
+    {
+      auto table_size = std::size_t{1} << table_log;
+
+      // A byte of count c leaves the states of [table_size, 2 table_size) with values of
+      // [c, 2 c), dropping max_bits or max_bits - 1 bits.
+      std::array<std::uint16_t, 256> next{};
+      for (std::size_t symbol = 0, total = 0; symbol < 256; symbol++)
+      {
+        std::size_t count = counts[symbol];
+        next[symbol] = std::uint16_t(total);
+
+        if (count)
+        {
+          auto max_bits = table_log + 1 - (count == 1 ? 1 : utils::bytes::count_bits(count - 1));
+          table.transforms[symbol] = SymbolTransform{
+              std::uint32_t((max_bits << 16) - (count << max_bits)),
+              std::int32_t(total) - std::int32_t(count)};
+          total += count;
+        }
+      }
+
+      // The states of a byte are listed in table order, the k-th one reached from value c + k.
+      Spread spread;
+      spread_symbols(counts, table_log, spread);
+
+      for (std::size_t position = 0; position < table_size; position++)
+      {
+        table.states[next[spread[position]]++] = std::uint16_t(table_size + position);
+      }
+    }
+  };
+
+  struct DecodeEntry
+  {
+    std::uint16_t base;  ///< The next state, before adding the bits read.
+    std::uint8_t symbol;
+    std::uint8_t bits;
+  };
+
+  using DecodeTable = std::array<DecodeEntry, std::size_t{1} << TableLog>;
+
+protected:
+  /**
+   * \brief No byte drops more than TableLog bits.
+   */
+  static constexpr std::size_t compress_bound(std::size_t raw_size) noexcept
+  {
+    std::size_t elems_count_size = (utils::bytes::count_bits(raw_size) + 7) / 8;
+
+    return 2 + elems_count_size + BITMAP_SIZE + (256 * TableLog + 7) / 8 +
+        (StreamsCount - 1) * elems_count_size + (raw_size * TableLog + 7) / 8 +
+        StreamsCount * ((TableLog + 1 + 7) / 8 + 1);
+  }
+
+  static utils::bytes::ByteSequence encode(utils::bytes::ByteView raw)
+  {
+    utils::bytes::ByteSequence output;
+    encode_into(raw, output);
+
+    return output;
+  }
+
+  static std::optional<std::size_t> encode(
+      utils::bytes::ByteView raw, utils::bytes::MutableByteView output)
+  {
+    utils::bytes::FixedBuffer buffer{output};
+    encode_into(raw, buffer);
+
+    if (buffer.overflowed())
+    {
+      return std::nullopt;
+    }
+
+    return buffer.size();
+  }
+
+  static utils::bytes::ByteSequence decode(utils::bytes::ByteView encoded)
+  {
+    utils::bytes::ByteSequence decompressed(bounded_elems_count(encoded));
+    if (!decode(encoded, decompressed))
+    {
+      return {};
+    }
+
+    return decompressed;
+  }
+
+  /**
+   * \returns The size of the decompressed data, or nothing if it does not fit in \p output, or if
+   * the archive is malformed: every stream must end in the state its encoding started from, with
+   * all its bits read.
+   */
+  static std::optional<std::size_t> decode(
+      utils::bytes::ByteView encoded, utils::bytes::MutableByteView output)
+  {
+    if (encoded.size() < 2)
+    {
+      return std::nullopt;
+    }
+
+    auto control = std::to_integer<std::uint8_t>(encoded[0]);
+    std::size_t elems_count_size = control >> 4;
+    std::size_t streams_count = std::size_t{1} << (control & STREAMS_MASK);
+    std::size_t table_log = std::to_integer<std::uint8_t>(encoded[1]);
+
+    auto elems_count = read_elems_count(encoded);
+    if (elems_count_size > sizeof(std::size_t) || 2 + elems_count_size > encoded.size() ||
+        elems_count > output.size())
+    {
+      return std::nullopt;
+    }
+
+    auto header = encoded.subspan(2 + elems_count_size);
+    if (table_log == 0)
+    {
+      if (elems_count && header.empty())
+      {
+        return std::nullopt;
+      }
+
+      std::fill_n(output.begin(), elems_count, elems_count ? header[0] : std::byte{});
+      return elems_count;
+    }
+
+    if (table_log < MIN_TABLE_LOG || table_log > TableLog || header.size() < BITMAP_SIZE)
+    {
+      return std::nullopt;
+    }
+
+    utils::stats::PhaseTimer timer{"ans.decode.table"};
+
+    Counts counts{};
+    auto streams = read_counts(header, table_log, counts);
+    if (!streams)
+    {
+      return std::nullopt;
+    }
+
+    StreamBounds bounds;
+    if (!read_stream_bounds(*streams, streams_count, elems_count_size, bounds))
+    {
+      return std::nullopt;
+    }
+
+    DecodeTable table;
+    make_decode_table(counts, table_log, table);
+
+    timer.next("ans.decode.streams");
+    auto decompressed = output.first(elems_count);
+
+    bool well_formed = false;
+    switch (streams_count)
+    {
+      case 1:
+        well_formed = decode_streams(table, table_log, bounds, decompressed,
+            std::make_index_sequence<1>{});
+        break;
+      case 2:
+        well_formed = decode_streams(table, table_log, bounds, decompressed,
+            std::make_index_sequence<2>{});
+        break;
+      case 4:
+        well_formed = decode_streams(table, table_log, bounds, decompressed,
+            std::make_index_sequence<4>{});
+        break;
+      default:
+        well_formed = decode_streams(table, table_log, bounds, decompressed,
+            std::make_index_sequence<8>{});
+        break;
+    }
+
+    if (!well_formed)
+    {
+      return std::nullopt;
+    }
+
+    return elems_count;
+  }
+
+private:
+  template <class Output>
+  static void encode_into(utils::bytes::ByteView raw, Output &output)
+  {
+    std::size_t elems_count_size = (utils::bytes::count_bits(raw.size()) + 7) / 8;
+    std::size_t streams_count = raw.size() < MIN_INTERLEAVED_SIZE ? 1 : StreamsCount;
+    std::uint8_t streams_log = utils::bytes::count_bits(streams_count) - 1;
+
+    utils::stats::PhaseTimer timer{"ans.encode.histogram"};
+    auto histogram = utils::histogram::count_parallel(raw.data(), raw.data() + raw.size());
+
+    std::size_t used_count = 0;
+    for (auto count : histogram)
+    {
+      used_count += count != 0;
+    }
+
+    // A single distinct byte needs no state at all: the element counter says how many times it
+    // repeats.
+    if (used_count <= 1)
+    {
+      write_header(output, raw.size(), elems_count_size, streams_log, 0);
+      if (!raw.empty())
+      {
+        output.push_back(raw[0]);
+      }
+
+      return;
+    }
+
+    timer.next("ans.encode.table");
+
+    auto table_log = choose_table_log(raw.size(), used_count);
+    auto counts = normalize(histogram, raw.size(), table_log);
+
+    EncodeTable table;
+    EncodeTable::make(counts, table_log, table);
+
+    // The archive takes about the entropy of the normalized frequencies, which is enough to size
+    // it in one allocation but in corner cases.
+    std::size_t payload_bits = 0;
+    for (std::size_t symbol = 0; symbol < 256; symbol++)
+    {
+      if (histogram[symbol])
+      {
+        auto probability = double(counts[symbol]) / double(std::size_t{1} << table_log);
+        payload_bits += std::size_t(std::ceil(-double(histogram[symbol]) * std::log2(probability)));
+      }
+    }
+
+    auto jump_table_size = (streams_count - 1) * elems_count_size;
+    output.reserve(2 + elems_count_size + BITMAP_SIZE + (used_count * table_log + 7) / 8 +
+        jump_table_size + payload_bits / 8 + payload_bits / 256 +
+        streams_count * sizeof(std::uint64_t));
+
+    write_header(output, raw.size(), elems_count_size, streams_log, table_log);
+    write_counts(counts, table_log, output);
+
+    timer.next("ans.encode.streams");
+
+    auto jump_table = output.size();
+    output.resize(jump_table + jump_table_size);
+
+    if (utils::bytes::overflowed(output))
+    {
+      return;
+    }
+
+    /*
+     * The stream sizes fit on elems_count_size bytes for the reason given by
+     * BasicHuffman::encode_into(): a byte drops at most TableLog <= 12 bits, so even with its final
+     * state a stream takes fewer bytes than the whole input.
+     */
+    auto streams_start = output.size();
+    auto segment_size = (raw.size() + streams_count - 1) / streams_count;
+    for (std::size_t i = 0; i < streams_count; i++)
+    {
+      auto first = raw.data() + std::min(raw.size(), i * segment_size);
+      auto last = raw.data() + std::min(raw.size(), (i + 1) * segment_size);
+
+      auto stream_start = output.size();
+      encode_stream(first, last, table, table_log, output);
+
+      if (i + 1 < streams_count)
+      {
+        auto stream_size_bytes = utils::bytes::to_bytes(output.size() - stream_start);
+        std::copy_n(stream_size_bytes.begin(), elems_count_size,
+            output.begin() + jump_table + i * elems_count_size);
+      }
+    }
+
+    record_stats(raw.size(), (output.size() - streams_start) * 8);
+  }
+
+  /**
+   * \brief Smaller inputs get smaller tables, which are cheaper to build and to send, but never
+   * fewer than two states per used byte.
+   */
+  static std::size_t choose_table_log(std::size_t raw_size, std::size_t used_count) noexcept
+  {
+    auto table_log = std::min<std::size_t>(TableLog, utils::bytes::count_bits(raw_size - 1));
+    table_log = std::max(table_log, utils::bytes::count_bits(used_count - 1) + 1);
+
+    return std::max(table_log, MIN_TABLE_LOG);
+  }
+
+  /**
+   * \brief Scale \p histogram, of \p total bytes, to frequencies summing to 2^table_log, none of
+   * the used bytes falling to 0.
+   *
+   * The frequencies are rounded first. The rounding, and the bytes raised to 1, leave the sum off
+   * by a few units, which are then given to, or taken from, the bytes whose coded size changes the
+   * least, one unit at a time.
+   */
+  static Counts normalize(
+      const utils::histogram::Histogram &histogram, std::size_t total, std::size_t table_log)
+  {
+    auto table_size = std::size_t{1} << table_log;
+
+    Counts counts{};
+    std::size_t sum = 0;
+    for (std::size_t symbol = 0; symbol < 256; symbol++)
+    {
+      if (histogram[symbol])
+      {
+        auto count = (histogram[symbol] * table_size + total / 2) / total;
+        counts[symbol] = std::uint16_t(std::max<std::size_t>(count, 1));
+        sum += counts[symbol];
+      }
+    }
+
+    // The bits a byte costs more once its count moves by a unit towards the table size.
+    auto step_cost = [&](std::size_t symbol) {
+      auto count = double(counts[symbol]);
+      auto next = sum < table_size ? count + 1 : count - 1;
+
+      return double(histogram[symbol]) * std::log2(count / next);
+    };
+
+    std::array<double, 256> costs;
+    for (std::size_t symbol = 0; symbol < 256; symbol++)
+    {
+      costs[symbol] = step_cost(symbol);
+    }
+
+    while (sum != table_size)
+    {
+      auto growing = sum < table_size;
+
+      std::size_t best = 256;
+      for (std::size_t symbol = 0; symbol < 256; symbol++)
+      {
+        if (histogram[symbol] && (growing || counts[symbol] > 1) &&
+            (best == 256 || costs[symbol] < costs[best]))
+        {
+          best = symbol;
+        }
+      }
+
+      counts[best] = std::uint16_t(growing ? counts[best] + 1 : counts[best] - 1);
+      sum = growing ? sum + 1 : sum - 1;
+      costs[best] = step_cost(best);
+    }
+
+    return counts;
+  }
+
+  /**
+   * \brief Lay the bytes over the table, each as many times as its count, every next position a
+   * fixed odd step away from the previous one, so that the states of every byte are scattered.
+   */
+  static void spread_symbols(const Counts &counts, std::size_t table_log, Spread &spread) noexcept
+  {
+    auto table_size = std::size_t{1} << table_log;
+    auto mask = table_size - 1;
+    auto step = (table_size >> 1) + (table_size >> 3) + 3;
+
+    std::size_t position = 0;
+    for (std::size_t symbol = 0; symbol < 256; symbol++)
+    {
+      for (std::size_t i = 0; i < counts[symbol]; i++)
+      {
+        spread[position] = std::uint8_t(symbol);
+        position = (position + step) & mask;
+      }
+    }
+  }
+
+  static void make_decode_table(const Counts &counts, std::size_t table_log, DecodeTable &table)
+  {
+    auto table_size = std::size_t{1} << table_log;
+
+    Spread spread;
+    spread_symbols(counts, table_log, spread);
+
+    // The k-th state of a byte of count c goes back to the value c + k, padded to a whole state.
+    auto next = counts;
+    for (std::size_t position = 0; position < table_size; position++)
+    {
+      auto symbol = spread[position];
+      std::size_t value = next[symbol]++;
+      auto bits = table_log + 1 - utils::bytes::count_bits(value);
+
+      table[position] =
+          DecodeEntry{std::uint16_t((value << bits) - table_size), symbol, std::uint8_t(bits)};
+    }
+  }
+
+  template <class Output>
+  static void encode_stream(const std::byte *first, const std::byte *last,
+      const EncodeTable &table, std::size_t table_log, Output &output)
+  {
+    utils::unaligned_storage::BitWriter write_bits{output};
+
+    auto table_size = std::uint32_t{1} << table_log;
+    std::array<std::uint32_t, 2> states{table_size, table_size};
+
+    auto encode_symbol = [&table, &write_bits](std::uint32_t &state, std::byte value) {
+      const auto &transform = table.transforms[std::to_integer<std::uint8_t>(value)];
+
+      auto bits = (state + transform.delta_bits) >> 16;
+      write_bits.write(state, bits);
+      state = table.states[std::int32_t(state >> bits) + transform.delta_state];
+    };
+
+    // The bytes at even offsets of the segment go to the first state, the others to the second.
+    if ((last - first) % 2)
+    {
+      encode_symbol(states[0], *--last);
+      write_bits.commit();
+    }
+
+    while (last - first >= std::ptrdiff_t(PAIRS_PER_COMMIT * 2))
+    {
+      for (std::size_t i = 0; i < PAIRS_PER_COMMIT; i++)
+      {
+        encode_symbol(states[1], *--last);
+        encode_symbol(states[0], *--last);
+      }
+
+      write_bits.commit();
+    }
+
+    while (last != first)
+    {
+      encode_symbol(states[1], *--last);
+      encode_symbol(states[0], *--last);
+      write_bits.commit();
+    }
+
+    write_bits.write(states[1] - table_size, table_log);
+    write_bits.write(states[0] - table_size, table_log);
+    write_bits.write(1, 1);
+    write_bits.flush();
+  }
+
+  /**
+   * \brief Decode the streams delimited by \p bounds side by side, each into its segment of
+   * \p decompressed.
+   *
+   * As in BasicHuffman, the steps of every stream are expanded over the Streams pack, so that each
+   * stream keeps its states and reader in registers of its own.
+   * \returns Whether every stream ends where its encoding started.
+   */
+  template <std::size_t... Streams>
+  static bool decode_streams(const DecodeTable &table, std::size_t table_log,
+      const StreamBounds &bounds, utils::bytes::MutableByteView decompressed,
+      std::index_sequence<Streams...>) noexcept
+  {
+    constexpr auto N = sizeof...(Streams);
+
+    std::array<utils::unaligned_storage::ReverseBitReader, N> readers{
+        utils::unaligned_storage::ReverseBitReader{bounds[Streams], bounds[Streams + 1]}...};
+
+    // The state of the even offsets of every stream, then the state of its odd offsets.
+    std::array<std::array<std::size_t, 2>, N> states;
+    for (std::size_t stream = 0; stream < N; stream++)
+    {
+      readers[stream].refill();
+      states[stream][0] = readers[stream].read(table_log);
+      states[stream][1] = readers[stream].read(table_log);
+    }
+
+    auto decode_symbol = [&table](std::size_t &state,
+                             utils::unaligned_storage::ReverseBitReader &reader) {
+      const auto &entry = table[state];
+      state = entry.base + reader.read(entry.bits);
+
+      return std::byte{entry.symbol};
+    };
+
+    auto segment_size = (decompressed.size() + N - 1) / N;
+
+    std::array<std::byte *, N> outs;
+    for (std::size_t i = 0; i < N; i++)
+    {
+      outs[i] = decompressed.data() + std::min(decompressed.size(), i * segment_size);
+    }
+
+    // The last segment is the shortest one, so every stream has at least that many bytes.
+    std::size_t last_segment_size = decompressed.data() + decompressed.size() - outs[N - 1];
+    for (auto n = last_segment_size / (PAIRS_PER_REFILL * 2); n; n--)
+    {
+      (std::get<Streams>(readers).refill(), ...);
+
+      for (std::size_t i = 0; i < PAIRS_PER_REFILL; i++)
+      {
+        ((*std::get<Streams>(outs)++ =
+                 decode_symbol(std::get<Streams>(states)[0], std::get<Streams>(readers))),
+            ...);
+        ((*std::get<Streams>(outs)++ =
+                 decode_symbol(std::get<Streams>(states)[1], std::get<Streams>(readers))),
+            ...);
+      }
+    }
+
+    bool well_formed = true;
+    for (std::size_t stream = 0; stream < N; stream++)
+    {
+      auto segment_last =
+          decompressed.data() + std::min(decompressed.size(), (stream + 1) * segment_size);
+
+      for (std::size_t offset = 0; outs[stream] != segment_last; ++outs[stream], offset++)
+      {
+        readers[stream].refill();
+        *outs[stream] = decode_symbol(states[stream][offset % 2], readers[stream]);
+      }
+
+      well_formed = well_formed && states[stream][0] == 0 && states[stream][1] == 0 &&
+          readers[stream].finished();
+    }
+
+    return well_formed;
+  }
+
+  template <class Output>
+  static void write_header(Output &output, std::size_t elems_count, std::size_t elems_count_size,
+      std::uint8_t streams_log, std::size_t table_log)
+  {
+    output.push_back(std::byte((elems_count_size << 4) | streams_log));
+    output.push_back(std::byte(table_log));
+
+    auto elems_count_bytes = utils::bytes::to_bytes(elems_count);
+    for (std::size_t i = 0; i < elems_count_size; i++)
+    {
+      output.push_back(elems_count_bytes[i]);
+    }
+  }
+
+  /**
+   * \brief The number of bytes held by \p encoded, or 0 if it cannot hold that many.
+   *
+   * Streams start from a state read from their own bits, and end in a fixed one. No byte count
+   * reaches the table size, so every byte decoded takes 2^-table_log bits at least. Only the
+   * archives of a single byte value have no streams.
+   */
+  static std::size_t bounded_elems_count(utils::bytes::ByteView encoded) noexcept
+  {
+    if (encoded.size() < 2)
+    {
+      return 0;
+    }
+
+    auto elems_count = read_elems_count(encoded);
+    std::size_t table_log = std::to_integer<std::uint8_t>(encoded[1]);
+    auto max_elems_count = table_log == 0
+        ? std::size_t(std::numeric_limits<std::ptrdiff_t>::max())
+        : (encoded.size() * 8) << std::min(table_log, std::size_t{TableLog});
+    if (table_log > TableLog || elems_count > max_elems_count)
+    {
+      return 0;
+    }
+
+    return elems_count;
+  }
+
+  static std::size_t read_elems_count(utils::bytes::ByteView encoded) noexcept
+  {
+    if (encoded.size() < 2)
+    {
+      return 0;
+    }
+
+    auto elems_count_size = std::to_integer<std::size_t>(encoded[0] >> 4);
+    elems_count_size = std::min({elems_count_size, encoded.size() - 2, sizeof(std::size_t)});
+
+    std::array<std::byte, sizeof(std::size_t)> elems_count_bytes{};
+    std::copy_n(encoded.begin() + 2, elems_count_size, elems_count_bytes.begin());
+
+    return utils::bytes::from_bytes<std::size_t>(elems_count_bytes);
+  }
+
+  template <class Output>
+  static void write_counts(const Counts &counts, std::size_t table_log, Output &output)
+  {
+    std::array<std::byte, BITMAP_SIZE> bitmap{};
+    for (std::size_t symbol = 0; symbol < 256; symbol++)
+    {
+      if (counts[symbol])
+      {
+        bitmap[symbol / 8] |= std::byte(1 << (symbol % 8));
+      }
+    }
+
+    for (auto byte : bitmap)
+    {
+      output.push_back(byte);
+    }
+
+    utils::unaligned_storage::BitWriter write_bits{output};
+    for (std::size_t count : counts)
+    {
+      if (count)
+      {
+        write_bits(count - 1, table_log);
+      }
+    }
+
+    write_bits.flush();
+  }
+
+  /**
+   * \brief Read the counts written by write_counts() at the front of \p header, and check that they
+   * fill the table exactly.
+   * \returns What follows them, or nothing if they are malformed.
+   */
+  static std::optional<utils::bytes::ByteView> read_counts(
+      utils::bytes::ByteView header, std::size_t table_log, Counts &counts) noexcept
+  {
+    std::size_t used_count = 0;
+    for (std::size_t i = 0; i < BITMAP_SIZE; i++)
+    {
+      used_count += std::bitset<8>(std::to_integer<unsigned>(header[i])).count();
+    }
+
+    auto counts_size = (used_count * table_log + 7) / 8;
+    if (used_count < 2 || header.size() < BITMAP_SIZE + counts_size)
+    {
+      return std::nullopt;
+    }
+
+    auto packed = header.subspan(BITMAP_SIZE, counts_size);
+    utils::unaligned_storage::BitReader reader{packed.begin(), packed.end()};
+
+    std::size_t sum = 0;
+    for (std::size_t symbol = 0; symbol < 256; symbol++)
+    {
+      if (std::to_integer<unsigned>(header[symbol / 8] >> (symbol % 8)) & 1)
+      {
+        counts[symbol] = std::uint16_t(reader.read(table_log) + 1);
+        sum += counts[symbol];
+      }
+    }
+
+    if (sum != std::size_t{1} << table_log)
+    {
+      return std::nullopt;
+    }
+
+    return header.subspan(BITMAP_SIZE + counts_size);
+  }
+
+  /**
+   * \brief Find the streams within \p streams through the jump table at its front.
+   * \returns Whether they all lie within it.
+   */
+  static bool read_stream_bounds(utils::bytes::ByteView streams, std::size_t streams_count,
+      std::size_t elems_count_size, StreamBounds &bounds) noexcept
+  {
+    auto jump_table_size = (streams_count - 1) * elems_count_size;
+    if (streams.size() < jump_table_size)
+    {
+      return false;
+    }
+
+    auto front = streams.begin();
+    bounds[0] = front + jump_table_size;
+    for (std::size_t i = 1; i < streams_count; i++)
+    {
+      std::array<std::byte, sizeof(std::size_t)> stream_size_bytes{};
+      std::copy_n(front + (i - 1) * elems_count_size, elems_count_size,
+          stream_size_bytes.begin());
+
+      auto stream_size = utils::bytes::from_bytes<std::size_t>(stream_size_bytes);
+      if (stream_size > std::size_t(streams.end() - bounds[i - 1]))
+      {
+        return false;
+      }
+
+      bounds[i] = bounds[i - 1] + stream_size;
+    }
+
+    bounds[streams_count] = streams.end();
+    return true;
+  }
+
+  static void record_stats(std::size_t symbols_count, std::size_t payload_bits)
+  {
+    utils::stats::add("ans.symbols", symbols_count);
+    utils::stats::add("ans.payload_bits", payload_bits);
+    utils::stats::ratio("ans.bits_per_symbol", "ans.payload_bits", "ans.symbols");
+  }
+};
+
+using ANS = BasicANS<>;
+
+}  // namespace compression
@@ -0,0 +1,383 @@
+#pragma once
+
+#include "utils/bytes.h"
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+namespace compression
+{
+
+/**
+ * \brief Split the input into blocks of \p BlockSize bytes, compressed independently by \p Algo.
+ *
+ * Every block gets its own archive, and so its own tables, which adapts to data whose statistics
+ * change along the input. The blocks are compressed and decompressed in parallel on a thread pool.
+ *
+ * Archive structure:
+ *  - control byte: the size in bytes of every counter of the header.
+ *  - size of the input.
+ *  - size of the blocks; only the last one may be shorter.
+ *  - compressed size of every block, so that the decoder finds all of them up front.
+ *  - the archives of the blocks.
+ */
+template <class Algo, std::size_t BlockSize = 256 * 1024>
+class Blocked : protected Algo
+{
+  static_assert(BlockSize > 0, "Blocks must not be empty.");
+
+public:
+  /**
+   * \brief The largest block size accepted from the header of an archive.
+   */
+  static constexpr std::size_t MAX_BLOCK_SIZE = std::size_t{1} << 30;
+
+  static_assert(BlockSize <= MAX_BLOCK_SIZE, "Blocks must not exceed MAX_BLOCK_SIZE.");
+
+protected:
+  static constexpr std::size_t compress_bound(std::size_t raw_size) noexcept
+  {
+    auto blocks_count = (raw_size + BlockSize - 1) / BlockSize;
+    auto largest = std::max({raw_size, BlockSize, Algo::compress_bound(BlockSize)});
+    std::size_t counter_size = (utils::bytes::count_bits(largest) + 7) / 8;
+
+    auto full_blocks_count = raw_size / BlockSize;
+    auto last_block_size = raw_size % BlockSize;
+
+    return 1 + (2 + blocks_count) * counter_size +
+        full_blocks_count * Algo::compress_bound(BlockSize) +
+        (last_block_size ? Algo::compress_bound(last_block_size) : 0);
+  }
+
+  static utils::bytes::ByteSequence encode(utils::bytes::ByteView raw)
+  {
+    return encode(raw, utils::thread_pool::ThreadPool::shared());
+  }
+
+  static utils::bytes::ByteSequence encode(
+      utils::bytes::ByteView raw, utils::thread_pool::ThreadPool &pool)
+  {
+    auto blocks = encode_blocks(raw, pool);
+    auto layout = Layout::make(raw.size(), blocks);
+
+    utils::bytes::ByteSequence output(layout.size());
+    write_archive(raw.size(), blocks, layout, output, pool);
+
+    return output;
+  }
+
+  /**
+   * \brief The blocks are compressed into buffers of their own before being laid out, so only the
+   * final archive goes to \p output.
+   */
+  static std::optional<std::size_t> encode(
+      utils::bytes::ByteView raw, utils::bytes::MutableByteView output)
+  {
+    return encode(raw, output, utils::thread_pool::ThreadPool::shared());
+  }
+
+  static std::optional<std::size_t> encode(utils::bytes::ByteView raw,
+      utils::bytes::MutableByteView output, utils::thread_pool::ThreadPool &pool)
+  {
+    auto blocks = encode_blocks(raw, pool);
+    auto layout = Layout::make(raw.size(), blocks);
+
+    if (layout.size() > output.size())
+    {
+      return std::nullopt;
+    }
+
+    write_archive(raw.size(), blocks, layout, output, pool);
+    return layout.size();
+  }
+
+  static utils::bytes::ByteSequence decode(utils::bytes::ByteView encoded)
+  {
+    return decode(encoded, utils::thread_pool::ThreadPool::shared());
+  }
+
+  /**
+   * \brief The sizes in the header only come from the archive, and a few bytes of it may claim a
+   * block of MAX_BLOCK_SIZE bytes. So every block is decompressed by the allocating decode of Algo,
+   * which only allocates as much as its archive can hold, and the output is sized once all of them
+   * turned out as large as the header says.
+   */
+  static utils::bytes::ByteSequence decode(
+      utils::bytes::ByteView encoded, utils::thread_pool::ThreadPool &pool)
+  {
+    auto header = Header::read(encoded);
+    auto offsets = read_offsets(header, encoded);
+    if (!offsets)
+    {
+      return {};
+    }
+
+    auto blocks_count = header.blocks_count();
+    std::vector<utils::bytes::ByteSequence> blocks(blocks_count);
+    std::atomic<bool> failed{false};
+
+    utils::thread_pool::parallel_for(pool, blocks_count, [&](std::size_t i) {
+      blocks[i] = Algo::decode(header.block_archive(encoded, *offsets, i));
+      if (blocks[i].size() != header.block_raw_size(i))
+      {
+        failed = true;
+      }
+    });
+
+    if (failed)
+    {
+      return {};
+    }
+
+    utils::bytes::ByteSequence decompressed(header.raw_size);
+    utils::thread_pool::parallel_for(pool, blocks_count, [&](std::size_t i) {
+      std::copy(blocks[i].begin(), blocks[i].end(), decompressed.begin() + i * header.block_size);
+    });
+
+    return decompressed;
+  }
+
+  /**
+   * \brief Every block is decompressed straight into its slice of \p output.
+   */
+  static std::optional<std::size_t> decode(
+      utils::bytes::ByteView encoded, utils::bytes::MutableByteView output)
+  {
+    return decode(encoded, output, utils::thread_pool::ThreadPool::shared());
+  }
+
+  static std::optional<std::size_t> decode(utils::bytes::ByteView encoded,
+      utils::bytes::MutableByteView output, utils::thread_pool::ThreadPool &pool)
+  {
+    auto header = Header::read(encoded);
+    if (header.raw_size > output.size())
+    {
+      return std::nullopt;
+    }
+
+    auto offsets = read_offsets(header, encoded);
+    if (!offsets)
+    {
+      return std::nullopt;
+    }
+
+    std::atomic<bool> failed{false};
+
+    utils::thread_pool::parallel_for(pool, header.blocks_count(), [&](std::size_t i) {
+      auto block = header.block_archive(encoded, *offsets, i);
+      auto out = output.subspan(i * header.block_size, header.block_raw_size(i));
+
+      auto decoded = Algo::decode(block, out);
+      if (!decoded || *decoded != out.size())
+      {
+        failed = true;
+      }
+    });
+
+    if (failed)
+    {
+      return std::nullopt;
+    }
+
+    return header.raw_size;
+  }
+
+private:
+  /**
+   * \brief The leading counters of an archive.
+   */
+  struct Header
+  {
+    std::size_t counter_size;
+    std::size_t raw_size;
+    std::size_t block_size;
+    std::size_t size;  ///< The bytes taken by the fields above.
+
+    static Header read(utils::bytes::ByteView encoded) noexcept
+    {
+      Header header{0, 0, 0, 0};
+      if (encoded.empty())
+      {
+        return header;
+      }
+
+      header.counter_size = std::min(std::to_integer<std::size_t>(encoded[0]), sizeof(std::size_t));
+      header.size = 1 + 2 * header.counter_size;
+      if (encoded.size() < header.size)
+      {
+        return header;
+      }
+
+      auto front = encoded.begin() + 1;
+      header.raw_size = header.get_counter(front);
+      header.block_size = header.get_counter(front);
+
+      return header;
+    }
+
+    std::size_t blocks_count() const noexcept
+    {
+      return raw_size / block_size + (raw_size % block_size != 0);
+    }
+
+    /**
+     * \brief Whether \p encoded holds the counters of all the blocks, none of them above
+     * MAX_BLOCK_SIZE.
+     */
+    bool fits(utils::bytes::ByteView encoded) const noexcept
+    {
+      if (counter_size == 0 || block_size == 0 || block_size > MAX_BLOCK_SIZE ||
+          encoded.size() < size)
+      {
+        return false;
+      }
+
+      return blocks_count() <= (encoded.size() - size) / counter_size;
+    }
+
+    /**
+     * \brief The size of the block \p idx once decompressed: only the last one may be shorter.
+     */
+    std::size_t block_raw_size(std::size_t idx) const noexcept
+    {
+      return std::min(block_size, raw_size - idx * block_size);
+    }
+
+    /**
+     * \brief The archive of the block \p idx, at \p offsets from the end of the block sizes.
+     */
+    utils::bytes::ByteView block_archive(utils::bytes::ByteView encoded,
+        const std::vector<std::size_t> &offsets, std::size_t idx) const noexcept
+    {
+      auto front = size + blocks_count() * counter_size;
+      return encoded.subspan(front + offsets[idx], offsets[idx + 1] - offsets[idx]);
+    }
+
+    std::size_t get_counter(const std::byte *&front) const noexcept
+    {
+      std::array<std::byte, sizeof(std::size_t)> bytes{};
+      std::copy_n(front, counter_size, bytes.begin());
+      std::advance(front, counter_size);
+
+      return utils::bytes::from_bytes<std::size_t>(bytes);
+    }
+  };
+
+  /**
+   * \brief The offsets of the archives of the blocks from the end of the header, plus the end of
+   * the last one.
+   * \returns The offsets, or nothing if \p encoded does not hold all of the archives.
+   */
+  static std::optional<std::vector<std::size_t>> read_offsets(
+      const Header &header, utils::bytes::ByteView encoded)
+  {
+    if (!header.fits(encoded))
+    {
+      return std::nullopt;
+    }
+
+    auto blocks_count = header.blocks_count();
+    auto front = encoded.begin() + header.size;
+    auto archives_size = encoded.size() - header.size - blocks_count * header.counter_size;
+
+    // Every archive must fit in what is left, so that the offsets cannot wrap around.
+    std::vector<std::size_t> offsets(blocks_count + 1, 0);
+    for (std::size_t i = 0; i < blocks_count; i++)
+    {
+      auto archive_size = header.get_counter(front);
+      if (archive_size > archives_size - offsets[i])
+      {
+        return std::nullopt;
+      }
+
+      offsets[i + 1] = offsets[i] + archive_size;
+    }
+
+    return offsets;
+  }
+
+  /**
+   * \brief Where the archives of the blocks go.
+   */
+  struct Layout
+  {
+    std::uint8_t counter_size;
+    std::size_t header_size;
+    std::vector<std::size_t> offsets;  ///< From the end of the header, plus the end of the last.
+
+    static Layout make(std::size_t raw_size, const std::vector<utils::bytes::ByteSequence> &blocks)
+    {
+      std::size_t largest = std::max(raw_size, BlockSize);
+      for (const auto &block : blocks)
+      {
+        largest = std::max(largest, block.size());
+      }
+
+      Layout layout;
+      layout.counter_size = std::ceil(utils::bytes::count_bits(largest) / 8.);
+      layout.header_size = 1 + (2 + blocks.size()) * layout.counter_size;
+
+      layout.offsets.assign(blocks.size() + 1, 0);
+      for (std::size_t i = 0; i < blocks.size(); i++)
+      {
+        layout.offsets[i + 1] = layout.offsets[i] + blocks[i].size();
+      }
+
+      return layout;
+    }
+
+    std::size_t size() const noexcept
+    {
+      return header_size + offsets.back();
+    }
+  };
+
+  static std::vector<utils::bytes::ByteSequence> encode_blocks(
+      utils::bytes::ByteView raw, utils::thread_pool::ThreadPool &pool)
+  {
+    auto blocks_count = (raw.size() + BlockSize - 1) / BlockSize;
+    std::vector<utils::bytes::ByteSequence> blocks(blocks_count);
+
+    utils::thread_pool::parallel_for(pool, blocks_count, [&](std::size_t i) {
+      auto offset = i * BlockSize;
+      blocks[i] = Algo::encode(raw.subspan(offset, std::min(BlockSize, raw.size() - offset)));
+    });
+
+    return blocks;
+  }
+
+  static void write_archive(std::size_t raw_size,
+      const std::vector<utils::bytes::ByteSequence> &blocks, const Layout &layout,
+      utils::bytes::MutableByteView output, utils::thread_pool::ThreadPool &pool)
+  {
+    auto out = output.begin();
+    auto put_counter = [&out, &layout](std::size_t value) {
+      auto bytes = utils::bytes::to_bytes(value);
+      out = std::copy_n(bytes.begin(), layout.counter_size, out);
+    };
+
+    *out++ = std::byte(layout.counter_size);
+    put_counter(raw_size);
+    put_counter(BlockSize);
+
+    for (const auto &block : blocks)
+    {
+      put_counter(block.size());
+    }
+
+    utils::thread_pool::parallel_for(pool, blocks.size(), [&](std::size_t i) {
+      std::copy(blocks[i].begin(), blocks[i].end(),
+          output.begin() + layout.header_size + layout.offsets[i]);
+    });
+  }
+};
+
+}  // namespace compression
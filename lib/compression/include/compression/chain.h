@@ -0,0 +1,270 @@
+#pragma once
+
+#include "compression/dictionary.h"
+#include "compression/lzw.h"
+#include "utils/bytes.h"
+#include "utils/unaligned_storage.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace compression
+{
+
+/**
+ * \brief The code stream of the LZW policy \p First, entropy coded by the Huffman policy \p Second.
+ *
+ * The codes of an LZW archive take as many bits as the dictionary requires, however often they
+ * occur. Here, they are handed over from First::encode_codes() to Second without being serialized,
+ * and coded as the symbols of an alphabet wider than a byte:
+ *  - the single bytes and the reserved codes are symbols of their own;
+ *  - the other codes are coded by their distance to the latest dictionary entry, since the recent
+ *    entries are the likeliest. A distance is a bucket symbol, made of its bit length and the two
+ *    bits after its leading one, followed by its remaining low bits, stored raw. Deflate codes its
+ *    match distances the same way.
+ *
+ * Archive structure:
+ *  - the size of the raw bits size, on 1 byte.
+ *  - the size in bytes of the raw bits.
+ *  - the raw bits of the distances, LSB-first, in code order.
+ *  - the archive of the symbols by Second.
+ *
+ * The raw bits are written to the output as the codes come; only the symbols are staged, on 16 bits
+ * each, since Huffman coding needs their histogram up front.
+ */
+template <class First, class Second>
+class Chain : protected First
+{
+  /**
+   * \brief The codes that are symbols of their own.
+   */
+  static constexpr std::size_t LITERALS = ASCII_TABLE_SIZE + First::RESERVED_CODES;
+
+  /**
+   * \brief The distances below DIRECT_DISTANCES are bucket symbols of their own. The others take 4
+   * buckets per bit length, up to the width of the largest dictionary.
+   */
+  static constexpr std::size_t DIRECT_DISTANCES = 4;
+  static constexpr std::size_t BUCKETS_COUNT = DIRECT_DISTANCES + 4 * (First::MAX_CODE_BITS - 2);
+
+  using Symbols = typename Second::template WithAlphabet<LITERALS + BUCKETS_COUNT>;
+  using Symbol = typename Symbols::Symbol;
+
+  /**
+   * \brief Grants access to the protected interface of the symbol coder.
+   */
+  struct SymbolCoder : Symbols
+  {
+    using Symbols::compress_bound;
+    using Symbols::decode_symbols;
+    using Symbols::encode_symbols;
+    using Symbols::symbols_count;
+  };
+
+protected:
+  /**
+   * \brief The largest archive of \p raw_size bytes: one code per input byte at most, plus the
+   * reserved ones, each with a symbol and raw bits.
+   */
+  static constexpr std::size_t compress_bound(std::size_t raw_size) noexcept
+  {
+    auto codes_count = raw_size + raw_size / 255 + 2;
+
+    return 1 + sizeof(std::size_t) + (codes_count * (First::MAX_CODE_BITS - 3) + 7) / 8 +
+        SymbolCoder::compress_bound(codes_count);
+  }
+
+  static utils::bytes::ByteSequence encode(utils::bytes::ByteView raw)
+  {
+    utils::bytes::ByteSequence encoded;
+    encoded.reserve(raw.size() / 2);
+    encode_into(raw, encoded);
+
+    return encoded;
+  }
+
+  static std::optional<std::size_t> encode(
+      utils::bytes::ByteView raw, utils::bytes::MutableByteView output)
+  {
+    utils::bytes::FixedBuffer buffer{output};
+    encode_into(raw, buffer);
+
+    if (buffer.overflowed())
+    {
+      return std::nullopt;
+    }
+
+    return buffer.size();
+  }
+
+  static utils::bytes::ByteSequence decode(utils::bytes::ByteView encoded)
+  {
+    /*
+     * With two used symbols or more, every code takes a bit of the archive at least. A single used
+     * symbol only comes with the first codes of an input, far fewer than that.
+     */
+    auto max_codes = encoded.size() * 8;
+
+    PhraseBuffer phrases{First::RESERVED_CODES, encoded.size() * 4};
+    if (!decode_into(encoded, phrases, max_codes))
+    {
+      return {};
+    }
+
+    return phrases.release();
+  }
+
+  static std::optional<std::size_t> decode(
+      utils::bytes::ByteView encoded, utils::bytes::MutableByteView output)
+  {
+    // As many codes as compress_bound() allows for the output size.
+    auto max_codes = output.size() + output.size() / 255 + 2;
+
+    PhraseBuffer phrases{First::RESERVED_CODES, output};
+    if (!decode_into(encoded, phrases, max_codes) || phrases.overflowed())
+    {
+      return std::nullopt;
+    }
+
+    return phrases.size();
+  }
+
+private:
+  template <class Output>
+  static void encode_into(utils::bytes::ByteView raw, Output &encoded)
+  {
+    auto size_bytes = (utils::bytes::count_bits(compress_bound(raw.size())) + 7) / 8;
+    encoded.push_back(std::byte(size_bytes));
+
+    auto raw_bits_start = encoded.size() + size_bytes;
+    encoded.resize(raw_bits_start);
+
+    std::vector<Symbol> symbols;
+    symbols.reserve(raw.size() / 4);
+
+    {
+      utils::unaligned_storage::BitWriter write_bits{encoded};
+
+      First::encode_codes(raw, [&symbols, &write_bits](std::size_t code, std::size_t limit) {
+        if (code < LITERALS)
+        {
+          symbols.push_back(Symbol(code));
+          return;
+        }
+
+        auto distance = limit - 1 - code;
+        if (distance < DIRECT_DISTANCES)
+        {
+          symbols.push_back(Symbol(LITERALS + distance));
+          return;
+        }
+
+        auto extra_bits = utils::bytes::count_bits(distance) - 3;
+        auto bucket = 4 * extra_bits + ((distance >> extra_bits) & 3);
+
+        symbols.push_back(Symbol(LITERALS + DIRECT_DISTANCES + bucket));
+        write_bits(distance, extra_bits);
+      });
+
+      write_bits.flush();
+    }
+
+    if (utils::bytes::overflowed(encoded))
+    {
+      return;
+    }
+
+    auto size = utils::bytes::to_bytes(encoded.size() - raw_bits_start);
+    std::copy_n(size.begin(), size_bytes, encoded.begin() + raw_bits_start - size_bytes);
+
+    SymbolCoder::encode_symbols(symbols, encoded);
+  }
+
+  /**
+   * \param max_codes The number of codes beyond which the symbols are not even allocated.
+   * \returns Whether the archive is well formed, as far as it was read.
+   */
+  static bool decode_into(
+      utils::bytes::ByteView encoded, PhraseBuffer &phrases, std::size_t max_codes)
+  {
+    if (encoded.empty())
+    {
+      return false;
+    }
+
+    auto size_bytes = std::to_integer<std::size_t>(encoded[0]);
+    if (size_bytes > sizeof(std::size_t) || encoded.size() < 1 + size_bytes)
+    {
+      return false;
+    }
+
+    std::array<std::byte, sizeof(std::size_t)> size{};
+    std::copy_n(encoded.begin() + 1, size_bytes, size.begin());
+
+    auto raw_bits_size = utils::bytes::from_bytes<std::size_t>(size);
+    if (raw_bits_size > encoded.size() - 1 - size_bytes)
+    {
+      return false;
+    }
+
+    auto raw_bits = encoded.subspan(1 + size_bytes, raw_bits_size);
+    auto symbols_archive = encoded.subspan(1 + size_bytes + raw_bits_size);
+
+    // The symbols count is checked against the size of their archive by symbols_count().
+    auto symbols_count = SymbolCoder::symbols_count(symbols_archive);
+    if (symbols_count > max_codes)
+    {
+      return false;
+    }
+
+    std::vector<Symbol> symbols(symbols_count);
+    if (!SymbolCoder::decode_symbols(symbols_archive, symbols))
+    {
+      return false;
+    }
+
+    utils::unaligned_storage::BitReader reader{raw_bits.data(), raw_bits.data() + raw_bits.size()};
+    std::size_t next = 0;
+    bool well_formed = true;
+
+    auto read_code = [&](std::size_t limit) -> std::optional<std::size_t> {
+      if (next == symbols.size())
+      {
+        return std::nullopt;
+      }
+
+      std::size_t symbol = symbols[next++];
+      if (symbol < LITERALS)
+      {
+        return symbol;
+      }
+
+      auto distance = symbol - LITERALS;
+      if (distance >= DIRECT_DISTANCES)
+      {
+        auto bucket = distance - DIRECT_DISTANCES;
+        auto extra_bits = bucket / 4;
+
+        distance = ((4 | (bucket & 3)) << extra_bits) | reader.read(extra_bits);
+      }
+
+      // A distance past the first entry can only come from a malformed archive.
+      if (distance >= limit - LITERALS)
+      {
+        well_formed = false;
+        return std::nullopt;
+      }
+
+      return limit - 1 - distance;
+    };
+
+    return First::decode_codes(read_code, std::size_t{1} << First::MAX_CODE_BITS, phrases) &&
+        well_formed;
+  }
+};
+
+}  // namespace compression
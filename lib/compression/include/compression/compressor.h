@@ -2,6 +2,9 @@
 
 #include "utils/bytes.h"
 
+#include <cstddef>
+#include <optional>
+
 namespace compression
 {
 
@@ -18,6 +21,37 @@ public:
   {
     return Algo::decode(compressed);
   }
+
+  /**
+   * \brief The largest archive of \p raw_size bytes, so that callers can size the output of
+   * compress() up front.
+   */
+  static constexpr std::size_t compress_bound(std::size_t raw_size) noexcept
+  {
+    return Algo::compress_bound(raw_size);
+  }
+
+  /**
+   * \brief Compress \p raw into the caller-owned \p output.
+   * \returns The size of the archive, or nothing if it does not fit in \p output. An output of
+   * compress_bound(raw.size()) bytes always fits.
+   */
+  static std::optional<std::size_t> compress(
+      utils::bytes::ByteView raw, utils::bytes::MutableByteView output)
+  {
+    return Algo::encode(raw, output);
+  }
+
+  /**
+   * \brief Decompress \p compressed into the caller-owned \p output.
+   * \returns The size of the decompressed data, or nothing if it does not fit in \p output or the
+   * archive is malformed.
+   */
+  static std::optional<std::size_t> decompress(
+      utils::bytes::ByteView compressed, utils::bytes::MutableByteView output)
+  {
+    return Algo::decode(compressed, output);
+  }
 };
 
 }  // namespace compression
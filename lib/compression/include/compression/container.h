@@ -0,0 +1,890 @@
+#pragma once
+
+#include "compression/adaptive.h"
+#include "compression/chain.h"
+#include "compression/compressor.h"
+#include "compression/huffman.h"
+#include "compression/lzw.h"
+#include "compression/stream.h"
+#include "utils/bytes.h"
+#include "utils/checksum.h"
+#include "utils/stats.h"
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace compression
+{
+
+/**
+ * \brief The archive formats a container can hold, as identified in its header.
+ */
+enum class Codec : std::uint8_t
+{
+  LZW = 1,
+  ImplicitLZW = 2,
+  Huffman = 3,
+  LZWHuffman = 4,  ///< The implicit LZW codes, Huffman coded by Chain.
+  Adaptive = 5,  ///< Implicit LZW, Huffman or stored, chosen per block.
+};
+
+enum class ContainerError : std::uint8_t
+{
+  None,
+  BadMagic,  ///< The input is not a container.
+  BadVersion,  ///< The container was written by a newer version of the format.
+  UnknownCodec,
+  Truncated,  ///< The input ends before the end of the container.
+  CorruptBlock,  ///< A block or the block table is inconsistent, or a block does not decode.
+  OutOfRange,  ///< The requested range or blocks run past the end of the uncompressed data.
+};
+
+inline const char *describe(ContainerError error) noexcept
+{
+  switch (error)
+  {
+    case ContainerError::None:
+      return "no error";
+    case ContainerError::BadMagic:
+      return "not a compressed container";
+    case ContainerError::BadVersion:
+      return "unsupported container version";
+    case ContainerError::UnknownCodec:
+      return "unknown codec";
+    case ContainerError::Truncated:
+      return "truncated container";
+    case ContainerError::CorruptBlock:
+      return "corrupt block";
+    case ContainerError::OutOfRange:
+      return "range or block out of the uncompressed data";
+  }
+
+  return "unknown error";
+}
+
+/**
+ * \brief The codec ID of the archives of \p Algo. The instantiations of a policy template share the
+ * ID of the default one, which decodes the archives of all of them.
+ */
+template <class Algo>
+struct CodecOf;
+
+template <>
+struct CodecOf<LZW>
+{
+  static constexpr Codec value = Codec::LZW;
+};
+
+template <std::uint8_t MaxCodeBits, DictionaryPolicy Policy>
+struct CodecOf<BasicImplicitLZW<MaxCodeBits, Policy>>
+{
+  static constexpr Codec value = Codec::ImplicitLZW;
+};
+
+template <std::uint8_t MaxCodeLength, std::uint8_t StreamsCount>
+struct CodecOf<BasicHuffman<MaxCodeLength, StreamsCount>>
+{
+  static constexpr Codec value = Codec::Huffman;
+};
+
+/**
+ * \brief The chain archives do not store the maximum code width, so only the default chain has an
+ * ID.
+ */
+template <>
+struct CodecOf<Chain<ImplicitLZW, Huffman>>
+{
+  static constexpr Codec value = Codec::LZWHuffman;
+};
+
+template <>
+struct CodecOf<Adaptive>
+{
+  static constexpr Codec value = Codec::Adaptive;
+};
+
+namespace detail
+{
+
+static constexpr std::array<std::byte, 4> CONTAINER_MAGIC{
+    std::byte{'C'}, std::byte{'Z'}, std::byte{'F'}, std::byte{'R'}};
+static constexpr std::uint8_t CONTAINER_VERSION = 1;
+
+/**
+ * \brief Header flag: every block header holds the CRC-32 of the block's archive.
+ */
+static constexpr std::uint8_t CONTAINER_CHECKSUMS = 0x1;
+
+static constexpr std::size_t CONTAINER_HEADER_SIZE = 4 + 1 + 1 + 1 + 4;
+static constexpr std::size_t CONTAINER_FOOTER_SIZE = 8 + 4;
+
+/**
+ * \brief Blocks hold at most this many bytes. Their archives must fit on 4 bytes as well, which
+ * depends on how much the codec may expand them.
+ */
+static constexpr std::size_t MAX_CONTAINER_BLOCK_SIZE = std::size_t{1} << 30;
+
+template <class Integer>
+Integer get_le(const std::byte *src) noexcept
+{
+  std::array<std::byte, sizeof(Integer)> bytes;
+  std::memcpy(bytes.data(), src, sizeof(Integer));
+
+  return utils::bytes::from_bytes<Integer>(bytes);
+}
+
+template <class Integer>
+std::byte *put_le(std::byte *dst, Integer value) noexcept
+{
+  auto bytes = utils::bytes::to_bytes(value);
+  return std::copy(bytes.begin(), bytes.end(), dst);
+}
+
+struct ContainerHeader
+{
+  Codec codec;
+  std::uint8_t flags;
+  std::uint32_t block_size;
+
+  using Bytes = std::array<std::byte, CONTAINER_HEADER_SIZE>;
+
+  Bytes write() const noexcept
+  {
+    Bytes bytes;
+    auto out = std::copy(CONTAINER_MAGIC.begin(), CONTAINER_MAGIC.end(), bytes.begin());
+    *out++ = std::byte{CONTAINER_VERSION};
+    *out++ = std::byte(codec);
+    *out++ = std::byte{flags};
+    put_le(out, block_size);
+
+    return bytes;
+  }
+
+  static ContainerError read(utils::bytes::ByteView input, ContainerHeader &header) noexcept
+  {
+    if (input.size() < CONTAINER_HEADER_SIZE)
+    {
+      return ContainerError::Truncated;
+    }
+
+    if (!std::equal(CONTAINER_MAGIC.begin(), CONTAINER_MAGIC.end(), input.begin()))
+    {
+      return ContainerError::BadMagic;
+    }
+
+    if (std::to_integer<std::uint8_t>(input[4]) > CONTAINER_VERSION)
+    {
+      return ContainerError::BadVersion;
+    }
+
+    header.codec = Codec(std::to_integer<std::uint8_t>(input[5]));
+    header.flags = std::to_integer<std::uint8_t>(input[6]);
+    header.block_size = get_le<std::uint32_t>(input.data() + 7);
+
+    if (header.codec < Codec::LZW || header.codec > Codec::Adaptive)
+    {
+      return ContainerError::UnknownCodec;
+    }
+
+    if (header.block_size == 0 || header.block_size > MAX_CONTAINER_BLOCK_SIZE)
+    {
+      return ContainerError::CorruptBlock;
+    }
+
+    return ContainerError::None;
+  }
+
+  bool checksums() const noexcept
+  {
+    return flags & CONTAINER_CHECKSUMS;
+  }
+
+  std::size_t block_header_size() const noexcept
+  {
+    return 4 + 4 + (checksums() ? 4 : 0);
+  }
+};
+
+/**
+ * \brief Precedes the archive of every block, and makes up the entries of the block table. A block
+ * of raw_size 0 ends the blocks.
+ */
+struct BlockHeader
+{
+  std::uint32_t raw_size;
+  std::uint32_t size;
+  std::uint32_t checksum;
+
+  std::byte *write(std::byte *dst, bool checksums) const noexcept
+  {
+    dst = put_le(dst, raw_size);
+    dst = put_le(dst, size);
+
+    return checksums ? put_le(dst, checksum) : dst;
+  }
+
+  static BlockHeader read(const std::byte *src, bool checksums) noexcept
+  {
+    return BlockHeader{get_le<std::uint32_t>(src), get_le<std::uint32_t>(src + 4),
+        checksums ? get_le<std::uint32_t>(src + 8) : 0};
+  }
+
+  bool operator==(const BlockHeader &other) const noexcept
+  {
+    return raw_size == other.raw_size && size == other.size && checksum == other.checksum;
+  }
+};
+
+inline std::size_t compress_bound(Codec codec, std::size_t raw_size) noexcept
+{
+  switch (codec)
+  {
+    case Codec::LZW:
+      return Compressor<LZW>::compress_bound(raw_size);
+    case Codec::ImplicitLZW:
+      return Compressor<ImplicitLZW>::compress_bound(raw_size);
+    case Codec::Huffman:
+      return Compressor<Huffman>::compress_bound(raw_size);
+    case Codec::LZWHuffman:
+      return Compressor<Chain<ImplicitLZW, Huffman>>::compress_bound(raw_size);
+    case Codec::Adaptive:
+      return Compressor<Adaptive>::compress_bound(raw_size);
+  }
+
+  return 0;
+}
+
+inline std::optional<std::size_t> decompress(
+    Codec codec, utils::bytes::ByteView archive, utils::bytes::MutableByteView output)
+{
+  switch (codec)
+  {
+    case Codec::LZW:
+      return Compressor<LZW>::decompress(archive, output);
+    case Codec::ImplicitLZW:
+      return Compressor<ImplicitLZW>::decompress(archive, output);
+    case Codec::Huffman:
+      return Compressor<Huffman>::decompress(archive, output);
+    case Codec::LZWHuffman:
+      return Compressor<Chain<ImplicitLZW, Huffman>>::decompress(archive, output);
+    case Codec::Adaptive:
+      return Compressor<Adaptive>::decompress(archive, output);
+  }
+
+  return std::nullopt;
+}
+
+/**
+ * \brief Check the archive of a block described by \p header against the header, and decompress
+ * it.
+ *
+ * The codecs are not meant to decode arbitrary bytes, so the checksum of the archive is checked
+ * first: a corrupt archive is never handed over to them.
+ */
+inline ContainerError decompress_block(const ContainerHeader &container, const BlockHeader &header,
+    utils::bytes::ByteView archive, utils::bytes::MutableByteView output)
+{
+  {
+    utils::stats::PhaseTimer timer{"container.checksum"};
+    if (container.checksums() && utils::checksum::crc32(archive) != header.checksum)
+    {
+      return ContainerError::CorruptBlock;
+    }
+  }
+
+  auto raw = output.first(header.raw_size);
+
+  auto decoded = decompress(container.codec, archive, raw);
+  if (!decoded || *decoded != raw.size())
+  {
+    return ContainerError::CorruptBlock;
+  }
+
+  return ContainerError::None;
+}
+
+}  // namespace detail
+
+/**
+ * \brief How FramedEncoder cuts and compresses its input.
+ */
+struct FramedOptions
+{
+  bool checksums = true;
+  std::size_t block_size = std::size_t{256} * 1024;  ///< At most MAX_CONTAINER_BLOCK_SIZE.
+
+  /**
+   * The pool compressing several blocks side by side, or nullptr to compress them one after the
+   * other on the calling thread.
+   */
+  utils::thread_pool::ThreadPool *pool = nullptr;
+};
+
+/**
+ * \brief Self-describing container of blocks compressed by \p Algo, written incrementally.
+ *
+ * Every block is compressed on its own, with fresh tables or dictionary. Without a thread pool, a
+ * block is compressed as soon as it is complete, like StreamEncoder. With one, the blocks are
+ * gathered in batches of twice as many blocks as threads, compressed side by side, and emitted in
+ * input order, so that the output does not depend on the pool.
+ * Unlike the bare archives, the container identifies its codec, so that a single decoder reads any
+ * of them, and ends with a table of all the blocks, so that readers of a whole container can find,
+ * decode in parallel or skip any block without going through the others. With the Adaptive codec,
+ * every block is coded the way that suits it, as recorded by the first byte of its archive: stored
+ * blocks only cost that byte on top of the block header.
+ *
+ * Container structure, integers in little endian:
+ *  - header: the magic bytes "CZFR", the format version, the Codec ID, the flags (bit 0: the blocks
+ *    carry checksums), and the block size on 4 bytes.
+ *  - blocks: a block header (uncompressed size, archive size and, with checksums, the CRC-32 of the
+ *    archive, on 4 bytes each), then the archive of the block.
+ *  - end of blocks: a block header with all fields 0.
+ *  - block table: a copy of every block header.
+ *  - footer: the number of blocks on 8 bytes, then the magic bytes again.
+ */
+template <class Algo>
+class FramedEncoder
+{
+public:
+  explicit FramedEncoder(Sink sink, bool checksums = true) :
+      FramedEncoder(std::move(sink), FramedOptions{checksums})
+  {}
+
+  /**
+   * \throws std::invalid_argument if the block size is 0 or above MAX_CONTAINER_BLOCK_SIZE, or if
+   * the archive of a block might not fit in the 4 bytes of its size.
+   */
+  FramedEncoder(Sink sink, FramedOptions options) :
+      sink_{std::move(sink)},
+      header_{CodecOf<Algo>::value,
+          std::uint8_t(options.checksums ? detail::CONTAINER_CHECKSUMS : 0),
+          std::uint32_t(options.block_size)},
+      blocks_{options.block_size, header_.block_header_size(), options.pool}
+  {
+    if (options.block_size == 0 || options.block_size > detail::MAX_CONTAINER_BLOCK_SIZE)
+    {
+      throw std::invalid_argument{"the container block size must be in [1, 2^30]"};
+    }
+
+    if (Compressor<Algo>::compress_bound(options.block_size) > UINT32_MAX)
+    {
+      throw std::invalid_argument{"the archives of the container blocks must fit in 4 bytes"};
+    }
+  }
+
+  /**
+   * \brief Compress \p input, emitting the blocks it completes.
+   */
+  void feed(utils::bytes::ByteView input)
+  {
+    start();
+    blocks_.feed(input, finish_frame(), emit_frame());
+  }
+
+  /**
+   * \brief Compress the pending blocks, the last one possibly partial, and end the container with
+   * the block table.
+   */
+  void flush()
+  {
+    start();
+    blocks_.flush(finish_frame(), emit_frame());
+
+    auto entry_size = header_.block_header_size();
+    auto tail_size = (1 + table_.size()) * entry_size + detail::CONTAINER_FOOTER_SIZE;
+    utils::bytes::ByteSequence tail(tail_size);
+
+    auto out = detail::BlockHeader{0, 0, 0}.write(tail.data(), header_.checksums());
+    for (const auto &entry : table_)
+    {
+      out = entry.write(out, header_.checksums());
+    }
+
+    out = detail::put_le(out, std::uint64_t(table_.size()));
+    std::copy(detail::CONTAINER_MAGIC.begin(), detail::CONTAINER_MAGIC.end(), out);
+
+    sink_(tail);
+  }
+
+private:
+  void start()
+  {
+    if (!started_)
+    {
+      sink_(header_.write());
+      started_ = true;
+    }
+  }
+
+  /**
+   * \brief Write the block header, checksum included, on the thread that compressed the block.
+   */
+  auto finish_frame() const
+  {
+    return [checksums = header_.checksums(), header_size = header_.block_header_size()](
+               utils::bytes::ByteView block, utils::bytes::MutableByteView frame,
+               std::size_t archive_size) {
+      utils::stats::PhaseTimer timer{"container.checksum"};
+
+      auto archive = frame.subspan(header_size, archive_size);
+      detail::BlockHeader entry{std::uint32_t(block.size()), std::uint32_t(archive_size),
+          checksums ? utils::checksum::crc32(archive) : 0};
+      entry.write(frame.data(), checksums);
+    };
+  }
+
+  auto emit_frame()
+  {
+    return [this](utils::bytes::ByteView frame) {
+      table_.push_back(detail::BlockHeader::read(frame.data(), header_.checksums()));
+      sink_(frame);
+    };
+  }
+
+  Sink sink_;
+  detail::ContainerHeader header_;
+  detail::BlockBatcher<Algo> blocks_;
+  std::vector<detail::BlockHeader> table_;
+  bool started_ = false;
+};
+
+/**
+ * \brief Incremental decompression of the containers written by FramedEncoder, whatever their
+ * codec.
+ *
+ * The blocks are read in order, and each one is decompressed, and checked against its checksum, as
+ * soon as all its bytes have been fed. The block table is not needed, and what follows the end of
+ * the blocks is ignored.
+ */
+class FramedDecoder
+{
+public:
+  explicit FramedDecoder(Sink sink) : sink_{std::move(sink)}
+  {}
+
+  /**
+   * \brief Consume \p input, emitting the blocks it completes.
+   * \returns false once the input is known not to be a valid container; see flush().
+   */
+  bool feed(utils::bytes::ByteView input)
+  {
+    while (!input.empty() && state_ != State::Ended && error_ == ContainerError::None)
+    {
+      if (!fill(input))
+      {
+        break;
+      }
+
+      switch (state_)
+      {
+        case State::Header:
+          error_ = detail::ContainerHeader::read(pending_, header_);
+          if (error_ == ContainerError::None)
+          {
+            expect(State::BlockHeader, header_.block_header_size());
+          }
+          break;
+
+        case State::BlockHeader:
+          block_ = detail::BlockHeader::read(pending_.data(), header_.checksums());
+          if (block_.raw_size == 0)
+          {
+            state_ = State::Ended;
+          }
+          else if (block_.raw_size > header_.block_size ||
+              block_.size > detail::compress_bound(header_.codec, block_.raw_size))
+          {
+            error_ = ContainerError::CorruptBlock;
+          }
+          else
+          {
+            expect(State::Archive, block_.size);
+          }
+          break;
+
+        case State::Archive:
+          decoded_.resize(block_.raw_size);
+          error_ = detail::decompress_block(header_, block_, pending_, decoded_);
+          if (error_ == ContainerError::None)
+          {
+            sink_(decoded_);
+          }
+
+          expect(State::BlockHeader, header_.block_header_size());
+          break;
+
+        case State::Ended:
+          break;
+      }
+    }
+
+    return error_ == ContainerError::None;
+  }
+
+  /**
+   * \brief End the input.
+   * \returns ContainerError::None if the input held a whole valid container, up to the end of its
+   * blocks, and the error met otherwise.
+   */
+  ContainerError flush() const noexcept
+  {
+    if (error_ == ContainerError::None && state_ != State::Ended)
+    {
+      return ContainerError::Truncated;
+    }
+
+    return error_;
+  }
+
+  /**
+   * \brief The codec of the container, once its header has been fed.
+   */
+  std::optional<Codec> codec() const noexcept
+  {
+    if (state_ == State::Header)
+    {
+      return std::nullopt;
+    }
+
+    return header_.codec;
+  }
+
+private:
+  enum class State : std::uint8_t
+  {
+    Header,
+    BlockHeader,
+    Archive,
+    Ended,
+  };
+
+  /**
+   * \brief Move input bytes to the pending buffer until it holds the expected count.
+   * \returns Whether it does.
+   */
+  bool fill(utils::bytes::ByteView &input)
+  {
+    auto count = std::min(expected_ - pending_.size(), input.size());
+    pending_.insert(pending_.end(), input.begin(), input.begin() + count);
+    input = input.subspan(count);
+
+    return pending_.size() == expected_;
+  }
+
+  void expect(State state, std::size_t size)
+  {
+    state_ = state;
+    expected_ = size;
+    pending_.clear();
+  }
+
+  Sink sink_;
+  State state_ = State::Header;
+  std::size_t expected_ = detail::CONTAINER_HEADER_SIZE;
+  utils::bytes::ByteSequence pending_;
+  detail::ContainerHeader header_{};
+  detail::BlockHeader block_{};
+  utils::bytes::ByteSequence decoded_;
+  ContainerError error_ = ContainerError::None;
+};
+
+/**
+ * \brief Random access to a whole container, through its block table.
+ *
+ * Opening the container only reads its header, footer and block table, and checks that they are
+ * consistent. Any block can then be decompressed on its own, so that blocks can be decoded in
+ * parallel, a corrupt block only loses its own data, and any range of the uncompressed data is
+ * served by decoding the few blocks that cover it. Smaller blocks make ranges cheaper, at the cost
+ * of some compression ratio.
+ */
+class FramedArchive
+{
+public:
+  struct Block
+  {
+    std::uint64_t raw_offset;  ///< Where the uncompressed data of the block starts.
+    std::uint64_t offset;  ///< Where the archive of the block starts, within the container.
+    detail::BlockHeader header;
+  };
+
+  /**
+   * \param container The whole container, which must outlive the FramedArchive.
+   */
+  explicit FramedArchive(utils::bytes::ByteView container) : container_{container}
+  {
+    error_ = open();
+    if (error_ != ContainerError::None)
+    {
+      blocks_.clear();
+    }
+  }
+
+  /**
+   * \brief Whether the container could be opened, and why not.
+   */
+  ContainerError error() const noexcept
+  {
+    return error_;
+  }
+
+  Codec codec() const noexcept
+  {
+    return header_.codec;
+  }
+
+  /**
+   * \brief The size of the whole uncompressed data, 0 if the container could not be opened.
+   */
+  std::uint64_t raw_size() const noexcept
+  {
+    return blocks_.empty() ? 0 : blocks_.back().raw_offset + blocks_.back().header.raw_size;
+  }
+
+  /**
+   * \brief The blocks of the container, none if it could not be opened.
+   */
+  const std::vector<Block> &blocks() const noexcept
+  {
+    return blocks_;
+  }
+
+  /**
+   * \brief Decompress block \p idx into \p output, which must hold at least its raw size.
+   */
+  ContainerError decompress_block(std::size_t idx, utils::bytes::MutableByteView output) const
+  {
+    if (error_ != ContainerError::None)
+    {
+      return error_;
+    }
+
+    if (idx >= blocks_.size())
+    {
+      return ContainerError::OutOfRange;
+    }
+
+    const auto &block = blocks_[idx];
+    auto header_size = header_.block_header_size();
+
+    // The block header in front of the archive must agree with the block table.
+    auto inline_header = detail::BlockHeader::read(
+        container_.data() + block.offset - header_size, header_.checksums());
+    if (!(inline_header == block.header) || output.size() < block.header.raw_size)
+    {
+      return ContainerError::CorruptBlock;
+    }
+
+    auto archive = container_.subspan(block.offset, block.header.size);
+    return detail::decompress_block(header_, block.header, archive, output);
+  }
+
+  /**
+   * \brief Decompress the blocks [first, first + count) side by side on \p pool, back to back
+   * into \p output.
+   * \returns The error of the first failed block, if any.
+   */
+  ContainerError decompress_blocks(std::size_t first, std::size_t count,
+      utils::bytes::MutableByteView output,
+      utils::thread_pool::ThreadPool &pool = utils::thread_pool::ThreadPool::shared()) const
+  {
+    if (error_ != ContainerError::None)
+    {
+      return error_;
+    }
+
+    if (first > blocks_.size() || count > blocks_.size() - first)
+    {
+      return ContainerError::OutOfRange;
+    }
+
+    if (count == 0)
+    {
+      return ContainerError::None;
+    }
+
+    auto base = blocks_[first].raw_offset;
+    auto last = blocks_[first + count - 1];
+    if (output.size() < last.raw_offset + last.header.raw_size - base)
+    {
+      return ContainerError::CorruptBlock;
+    }
+
+    std::vector<ContainerError> errors(count, ContainerError::None);
+
+    utils::thread_pool::parallel_for(pool, count, [&](std::size_t i) {
+      const auto &block = blocks_[first + i];
+      auto out = output.subspan(block.raw_offset - base, block.header.raw_size);
+
+      errors[i] = decompress_block(first + i, out);
+    });
+
+    return first_error(errors);
+  }
+
+  /**
+   * \brief Decompress the output.size() bytes of uncompressed data starting at \p offset, decoding
+   * only the blocks that cover them.
+   */
+  ContainerError decompress_range(std::uint64_t offset, utils::bytes::MutableByteView output,
+      utils::thread_pool::ThreadPool &pool = utils::thread_pool::ThreadPool::shared()) const
+  {
+    if (error_ != ContainerError::None)
+    {
+      return error_;
+    }
+
+    if (offset > raw_size() || output.size() > raw_size() - offset)
+    {
+      return ContainerError::OutOfRange;
+    }
+
+    if (output.empty())
+    {
+      return ContainerError::None;
+    }
+
+    auto end = offset + output.size();
+    auto first = block_at(offset);
+    auto count = block_at(end - 1) - first + 1;
+
+    std::vector<ContainerError> errors(count, ContainerError::None);
+
+    utils::thread_pool::parallel_for(pool, count, [&](std::size_t i) {
+      const auto &block = blocks_[first + i];
+      auto block_end = block.raw_offset + block.header.raw_size;
+
+      auto from = std::max(offset, block.raw_offset);
+      auto to = std::min(end, block_end);
+      auto out = output.subspan(from - offset, to - from);
+
+      if (from == block.raw_offset && to == block_end)
+      {
+        errors[i] = decompress_block(first + i, out);
+        return;
+      }
+
+      // Only the first and last blocks may overlap the range partly, and go through a copy.
+      utils::bytes::ByteSequence decoded(block.header.raw_size);
+      errors[i] = decompress_block(first + i, decoded);
+      std::copy_n(decoded.begin() + (from - block.raw_offset), out.size(), out.begin());
+    });
+
+    return first_error(errors);
+  }
+
+  /**
+   * \brief Decompress every block into \p output, which must hold at least raw_size() bytes.
+   */
+  ContainerError decompress(utils::bytes::MutableByteView output,
+      utils::thread_pool::ThreadPool &pool = utils::thread_pool::ThreadPool::shared()) const
+  {
+    return decompress_blocks(0, blocks_.size(), output, pool);
+  }
+
+private:
+  /**
+   * \brief The index of the block holding the uncompressed byte at \p offset.
+   */
+  std::size_t block_at(std::uint64_t offset) const noexcept
+  {
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), offset,
+        [](std::uint64_t value, const Block &block) { return value < block.raw_offset; });
+
+    return std::distance(blocks_.begin(), it) - 1;
+  }
+
+  static ContainerError first_error(const std::vector<ContainerError> &errors) noexcept
+  {
+    for (auto error : errors)
+    {
+      if (error != ContainerError::None)
+      {
+        return error;
+      }
+    }
+
+    return ContainerError::None;
+  }
+
+  ContainerError open()
+  {
+    if (auto error = detail::ContainerHeader::read(container_, header_);
+        error != ContainerError::None)
+    {
+      return error;
+    }
+
+    auto entry_size = header_.block_header_size();
+    auto min_size = detail::CONTAINER_HEADER_SIZE + entry_size + detail::CONTAINER_FOOTER_SIZE;
+    if (container_.size() < min_size)
+    {
+      return ContainerError::Truncated;
+    }
+
+    auto footer = container_.data() + container_.size() - detail::CONTAINER_FOOTER_SIZE;
+    if (!std::equal(detail::CONTAINER_MAGIC.begin(), detail::CONTAINER_MAGIC.end(), footer + 8))
+    {
+      return ContainerError::Truncated;
+    }
+
+    // The block table sits between the end of blocks and the footer.
+    auto blocks_count = detail::get_le<std::uint64_t>(footer);
+    auto table_room = footer - container_.data() - detail::CONTAINER_HEADER_SIZE - entry_size;
+    if (blocks_count > std::uint64_t(table_room) / entry_size)
+    {
+      return ContainerError::CorruptBlock;
+    }
+
+    auto table = footer - blocks_count * entry_size;
+    auto table_offset = std::uint64_t(table - container_.data());
+    blocks_.reserve(blocks_count);
+
+    std::uint64_t raw_offset = 0;
+    std::uint64_t offset = detail::CONTAINER_HEADER_SIZE;
+
+    for (std::size_t i = 0; i < blocks_count; i++)
+    {
+      auto header = detail::BlockHeader::read(table + i * entry_size, header_.checksums());
+      if (header.raw_size == 0 || header.raw_size > header_.block_size)
+      {
+        return ContainerError::CorruptBlock;
+      }
+
+      offset += entry_size;
+      if (offset + header.size > table_offset)
+      {
+        return ContainerError::CorruptBlock;
+      }
+
+      blocks_.push_back(Block{raw_offset, offset, header});
+
+      raw_offset += header.raw_size;
+      offset += header.size;
+    }
+
+    // The blocks must be followed by the end of blocks, and then by the table.
+    if (offset + entry_size != table_offset)
+    {
+      return ContainerError::CorruptBlock;
+    }
+
+    return ContainerError::None;
+  }
+
+  utils::bytes::ByteView container_;
+  detail::ContainerHeader header_{};
+  std::vector<Block> blocks_;
+  ContainerError error_;
+};
+
+}  // namespace compression
@@ -0,0 +1,282 @@
+#pragma once
+
+#include "utils/bytes.h"
+#include "utils/stats.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace compression
+{
+
+static constexpr std::size_t ASCII_TABLE_SIZE = 256;
+
+/**
+ * \brief Dictionary implementation for the LZW compressor.
+ *
+ * Every entry is a flat (parent, symbol) pair stored in a single arena, so an entry costs 8 bytes
+ * plus its share of an open-addressing hash table that maps (parent, symbol) to the child index.
+ * The first ASCII_TABLE_SIZE entries are the single byte sequences; they have no parent and are
+ * addressed directly by their symbol. They may be followed by reserved codes, which the formats use
+ * as in-stream control codes and which never resemble a sequence.
+ *
+ * Operations complexities:
+ *  - put_sequence: O(m)
+ *  - put_symbol: O(1) amortized
+ *  - child_at: O(1) expected
+ *  - contains: O(1)
+ *  - find: O(m)
+ *  - at/operator[]: O(m)
+ * where m := length(seq)
+ */
+class Dictionary
+{
+public:
+  using Index = std::uint32_t;
+
+  static constexpr Index npos = std::numeric_limits<Index>::max();
+
+  struct Node
+  {
+    Index parent;
+    std::byte symbol;
+  };
+
+  explicit Dictionary(std::size_t reserved_codes = 0) :
+      initial_size_{ASCII_TABLE_SIZE + reserved_codes}
+  {
+    nodes_.reserve(INITIAL_CAPACITY);
+    for (std::size_t i = 0; i != ASCII_TABLE_SIZE; i++)
+    {
+      nodes_.push_back(Node{npos, std::byte(i)});
+    }
+
+    nodes_.resize(initial_size_, Node{npos, std::byte{0}});
+    slots_.assign(INITIAL_CAPACITY * 2, npos);
+  }
+
+  /**
+   * \brief Drop every sequence longer than one byte. The memory already held is kept for reuse.
+   */
+  void reset() noexcept
+  {
+    nodes_.resize(initial_size_);
+    std::fill(slots_.begin(), slots_.end(), npos);
+  }
+
+  /**
+   * \brief Add a new sequence into the dictionary.
+   * \param seq The byte sequence to be added
+   * \returns The index of the last node that has been added.
+   */
+  std::size_t put_sequence(const utils::bytes::ByteSequence &seq) noexcept
+  {
+    if (seq.empty())
+    {
+      return npos;
+    }
+
+    std::size_t curr = std::to_integer<std::size_t>(seq.front());
+
+    for (std::size_t front = 1; front < seq.size(); front++)
+    {
+      auto chr = seq[front];
+      auto child = child_at(curr, chr);
+
+      curr = child ? *child : put_symbol(curr, chr);
+    }
+
+    return curr;
+  }
+
+  /**
+   * \brief Add the sequence resembled by \p parent_idx extended with \p symbol.
+   *
+   * The caller must make sure that the child does not already exist.
+   * \returns The index of the newly added entry.
+   */
+  std::size_t put_symbol(std::size_t parent_idx, std::byte symbol) noexcept
+  {
+    if ((nodes_.size() + 1) * 2 > slots_.size())
+    {
+      grow();
+    }
+
+    auto node_idx = static_cast<Index>(nodes_.size());
+    nodes_.push_back(Node{static_cast<Index>(parent_idx), symbol});
+    slots_[probe(parent_idx, symbol)] = node_idx;
+
+    return node_idx;
+  }
+
+  /**
+   * \brief Find the entry that extends \p parent_idx with \p symbol.
+   * \returns The index of the child, or an empty optional if the dictionary has no such entry.
+   */
+  std::optional<std::size_t> child_at(std::size_t parent_idx, std::byte symbol) const noexcept
+  {
+    auto slot = slots_[probe(parent_idx, symbol)];
+    if (slot == npos)
+    {
+      return std::nullopt;
+    }
+
+    return slot;
+  }
+
+  /**
+   * \brief Checks whether a sequence with the given index exists in the dictionary.
+   * \param index The index to be checked.
+   */
+  bool contains(std::size_t index) const noexcept
+  {
+    return nodes_.size() > index;
+  }
+
+  /**
+   * \brief Find the node resembling the last symbol of \p bytes.
+   *
+   * The returned pointer refers to the dictionary arena and is invalidated by the next insertion.
+   */
+  const Node *find_node(const utils::bytes::ByteSequence &bytes) const noexcept
+  {
+    auto idx = find(bytes);
+    if (!idx)
+    {
+      return nullptr;
+    }
+
+    return &nodes_[*idx];
+  }
+
+  /**
+   * \brief Find the index of the given sequence within the dictionary.
+   * \param bytes The byte array to be searched for.
+   * \return The index of the last node in the given sequence, or an empty optional otherwise.
+   */
+  std::optional<std::size_t> find(const utils::bytes::ByteSequence &bytes) const noexcept
+  {
+    if (bytes.empty())
+    {
+      return std::nullopt;
+    }
+
+    std::optional<std::size_t> curr = std::to_integer<std::size_t>(bytes.front());
+
+    for (std::size_t front = 1; curr && front < bytes.size(); front++)
+    {
+      curr = child_at(*curr, bytes[front]);
+    }
+
+    return curr;
+  }
+
+  /**
+   * \brief Get the bytes sequence resembled by the last node, found at \p index.
+   *
+   * Note that this function performs checked access which is slower than unchecked access. For
+   * unchecked access, see the subscript operator.
+   * \param index The index of the node representing the last symbol of the sequence.
+   * \returns A byte sequence containing the found sequence, or an empty sequence if the sequence
+   * does not exist.
+   */
+  utils::bytes::ByteSequence at(std::size_t index) const noexcept
+  {
+    if (!contains(index))
+    {
+      return {};
+    }
+
+    return operator[](index);
+  }
+
+  /**
+   * \brief Performs unchecked access on the dictionary.
+   * \see Dictionary::at
+   */
+  utils::bytes::ByteSequence operator[](std::size_t index) const noexcept
+  {
+    std::size_t length = 0;
+    for (auto curr = static_cast<Index>(index); curr != npos; curr = nodes_[curr].parent)
+    {
+      length++;
+    }
+
+    utils::bytes::ByteSequence bytes(length);
+    for (auto curr = static_cast<Index>(index); curr != npos; curr = nodes_[curr].parent)
+    {
+      bytes[--length] = nodes_[curr].symbol;
+    }
+
+    return bytes;
+  }
+
+  const Node *entry(std::size_t idx) const noexcept
+  {
+    return &nodes_[idx];
+  }
+
+  std::size_t size() const noexcept
+  {
+    return nodes_.size();
+  }
+
+  /**
+   * \brief The number of bytes held by the dictionary arena and its lookup table.
+   */
+  std::size_t memory_usage() const noexcept
+  {
+    return nodes_.capacity() * sizeof(Node) + slots_.capacity() * sizeof(Index);
+  }
+
+private:
+  static constexpr std::size_t INITIAL_CAPACITY = 1024;
+
+  /**
+   * \brief Find the slot holding the child (parent_idx, symbol), or the empty slot where it should
+   * be inserted. The table is kept at most half full, so linear probing always terminates.
+   */
+  std::size_t probe(std::size_t parent_idx, std::byte symbol) const noexcept
+  {
+    auto mask = slots_.size() - 1;
+    auto key = (static_cast<std::uint64_t>(parent_idx) << 8) |
+        std::to_integer<std::uint64_t>(symbol);
+    auto pos = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+
+    while (slots_[pos] != npos)
+    {
+      const auto &node = nodes_[slots_[pos]];
+      if (node.parent == parent_idx && node.symbol == symbol)
+      {
+        break;
+      }
+
+      pos = (pos + 1) & mask;
+    }
+
+    return pos;
+  }
+
+  void grow()
+  {
+    utils::stats::PhaseTimer timer{"dictionary.grow"};
+    utils::stats::add("dictionary.grows", 1);
+
+    slots_.assign(slots_.size() * 2, npos);
+
+    for (std::size_t i = initial_size_; i < nodes_.size(); i++)
+    {
+      slots_[probe(nodes_[i].parent, nodes_[i].symbol)] = static_cast<Index>(i);
+    }
+  }
+
+  std::size_t initial_size_;
+  std::vector<Node> nodes_;
+  std::vector<Index> slots_;
+};
+
+}  // namespace compression
@@ -2,321 +2,1163 @@
 
 #include "utils/unaligned_storage.h"
 #include "utils/bytes.h"
-#include "utils/numeric.h"
+#include "utils/histogram.h"
+#include "utils/stats.h"
 
 #include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdint>
-#include <iostream>  // TODO Remove after completing.
-#include <map>
-#include <memory>
-#include <queue>
+#include <optional>
+#include <type_traits>
 #include <utility>
-#include <bitset>
 #include <stack>
+#include <vector>
 #include <cmath>
 
 namespace compression
 {
 
-class Huffman
+/**
+ * \brief Canonical Huffman coding with code lengths limited to \p MaxCodeLength bits.
+ *
+ * Archive structure:
+ *  - control byte: mask 11110000 gives the size of the elements counter, mask 00001111 the header
+ *    flags (SPARSE_LENGTHS, and log2 of the streams count under STREAMS_MASK).
+ *  - elements counter.
+ *  - code lengths, 4 bits each, either for the dense range [first, last] of symbols, or as a list
+ *    of the used symbols followed by their lengths, whichever is shorter.
+ *  - jump table: the size in bytes of every stream but the last, on as many bytes as the elements
+ *    counter.
+ *  - the streams of codes, LSB-first.
+ *
+ * The codes are canonical, so the lengths are all the decoder needs to rebuild them.
+ *
+ * An input made of a single symbol needs no code: the elements counter says how many times it
+ * repeats. Only runs of up to MAX_RUN_SIZE symbols are coded that way, so that a small archive
+ * cannot claim an unbounded output; the longer ones get a one-bit code.
+ *
+ * The input is cut into \p StreamsCount segments of equal length, the last one possibly shorter,
+ * each coded as its own stream. Decoding a stream is a serial dependency chain, since a code starts
+ * where the previous one ends; decoding the streams side by side keeps several independent chains
+ * in flight. Inputs shorter than MIN_INTERLEAVED_SIZE are coded as a single stream.
+ *
+ * The symbols are bytes by default. An \p AlphabetSize above 256 codes wider symbols, such as the
+ * codes of another compressor (see Chain), through encode_symbols() and decode_symbols(); the
+ * symbols in the header then take two bytes each.
+ */
+template <std::uint8_t MaxCodeLength = 15, std::uint8_t StreamsCount = 4,
+    std::size_t AlphabetSize = 256>
+class BasicHuffman
 {
-  using FreqMap = std::map<std::byte, std::size_t>;
-  using SymbolEncoding = std::pair<std::bitset<256>, std::uint8_t>;
+  static_assert(MaxCodeLength <= 15, "Lengths are stored on 4 bits.");
+  static_assert(StreamsCount == 1 || StreamsCount == 2 || StreamsCount == 4 || StreamsCount == 8,
+      "The streams count is stored as its log2 on 2 bits.");
+  static_assert(AlphabetSize >= 256 && AlphabetSize <= 1024,
+      "The decoding table of the largest alphabets would not fit on the stack.");
+  static_assert((std::size_t{1} << MaxCodeLength) >= AlphabetSize,
+      "Codes of MaxCodeLength bits must be enough for every symbol of the alphabet.");
+
+public:
+  /**
+   * \brief The same codec over \p Size symbols.
+   */
+  template <std::size_t Size>
+  using WithAlphabet = BasicHuffman<MaxCodeLength, StreamsCount, Size>;
+
+  using Symbol = std::conditional_t<AlphabetSize == 256, std::byte, std::uint16_t>;
+
+  /**
+   * \brief The longest run of a single symbol held by an archive without codes.
+   */
+  static constexpr std::size_t MAX_RUN_SIZE = std::size_t{1} << 24;
 
-  struct Node
+private:
+  using CodeLengths = std::array<std::uint8_t, AlphabetSize>;
+
+  /**
+   * \brief The bytes a symbol takes in the header.
+   */
+  static constexpr std::size_t SYMBOL_BYTES = AlphabetSize == 256 ? 1 : 2;
+
+  /**
+   * \brief The largest code lengths section of the header: the dense range of the whole alphabet.
+   */
+  static constexpr std::size_t MAX_LENGTHS_SIZE = 2 * SYMBOL_BYTES + AlphabetSize / 2;
+
+  static constexpr std::uint8_t SPARSE_LENGTHS = 0x1;
+  static constexpr std::uint8_t STREAMS_MASK = 0x6;
+
+  static constexpr std::size_t MIN_INTERLEAVED_SIZE = 1024;
+
+  /**
+   * \brief The first byte of every stream, followed by the end of the last one.
+   */
+  using StreamBounds = std::array<const std::byte *, 8 + 1>;
+
+  /**
+   * \brief How many codes fit in the bit I/O buffers between two commits or refills.
+   */
+  static constexpr std::size_t CODES_PER_COMMIT = 57 / MaxCodeLength;
+  static constexpr std::size_t CODES_PER_REFILL = 56 / MaxCodeLength;
+
+  /**
+   * \brief The used symbols, sorted by increasing frequency.
+   */
+  struct Frequencies
   {
-    std::byte symbol;
-    std::size_t freq;
-    Node *parent;
-    Node *left;
-    Node *right;
+    struct Leaf
+    {
+      std::size_t freq;
+      std::uint16_t symbol;
+    };
 
-    Node(std::byte symbol, std::size_t freq, Node *left, Node *right) :
-        symbol{symbol}, freq{freq}, left{left}, right{right}
+    std::array<Leaf, AlphabetSize> leaves;
+    std::size_t size = 0;
+
+    template <class Histogram>
+    static Frequencies make(const Histogram &histogram) noexcept
     {
-      if (left)
+      Frequencies freqs;
+      for (std::size_t symbol = 0; symbol < histogram.size(); symbol++)
       {
-        left->parent = this;
+        if (histogram[symbol])
+        {
+          freqs.leaves[freqs.size++] = Leaf{histogram[symbol], std::uint16_t(symbol)};
+        }
       }
 
-      if (right)
-      {
-        right->parent = this;
-      }
+      std::sort(freqs.leaves.begin(), freqs.leaves.begin() + freqs.size, [](auto &&a, auto &&b) {
+        return a.freq < b.freq || (a.freq == b.freq && a.symbol < b.symbol);
+      });
+
+      return freqs;
     }
+  };
+
+  /**
+   * \brief Huffman tree held in a flat arena.
+   *
+   * The leaves come first, in the order of Frequencies, followed by the internal nodes in the order
+   * they are created. Children therefore always precede their parent, and the root is the last
+   * node.
+   */
+  struct FreqTree
+  {
+    struct Node
+    {
+      std::size_t freq;
+      std::uint16_t left;
+      std::uint16_t right;
+    };
 
-    Node(std::byte symbol, std::size_t freq) : Node{symbol, freq, nullptr, nullptr}
-    {}
+    std::array<Node, 2 * AlphabetSize - 1> nodes;
+    std::size_t size;
 
-    ~Node()
+    /**
+     * \brief Build the tree by the two-queue method.
+     *
+     * Merged nodes are created with nondecreasing frequencies, so the internal nodes form a second
+     * sorted queue. The two lightest nodes are always found at the fronts of the two queues, in
+     * linear time overall.
+     */
+    static FreqTree make(const Frequencies &freqs) noexcept
     {
-      delete left;
-      delete right;
+      FreqTree tree;
+      for (std::size_t i = 0; i < freqs.size; i++)
+      {
+        tree.nodes[i] = Node{freqs.leaves[i].freq, 0, 0};
+      }
+
+      tree.size = freqs.size;
+
+      std::size_t next_leaf = 0;
+      std::size_t next_inner = freqs.size;
+
+      auto pop_lightest = [&]() {
+        if (next_leaf < freqs.size &&
+            (next_inner == tree.size || tree.nodes[next_leaf].freq <= tree.nodes[next_inner].freq))
+        {
+          return std::uint16_t(next_leaf++);
+        }
+
+        return std::uint16_t(next_inner++);
+      };
+
+      while (tree.size < 2 * freqs.size - 1)
+      {
+        auto left = pop_lightest();
+        auto right = pop_lightest();
+
+        tree.nodes[tree.size++] =
+            Node{tree.nodes[left].freq + tree.nodes[right].freq, left, right};
+      }
+
+      return tree;
     }
 
-    bool is_leaf() const noexcept
+    /**
+     * \brief The depth of every leaf, which is the length of its code, in a single top-down pass.
+     */
+    CodeLengths to_lengths(const Frequencies &freqs) const noexcept
     {
-      return !left && !right;
+      std::array<std::uint8_t, 2 * AlphabetSize - 1> depths;
+      depths[size - 1] = 0;
+
+      for (auto i = size - 1; i >= freqs.size; i--)
+      {
+        auto depth = std::uint8_t(depths[i] + 1);
+        depths[nodes[i].left] = depth;
+        depths[nodes[i].right] = depth;
+      }
+
+      CodeLengths lengths{};
+      for (std::size_t i = 0; i < freqs.size; i++)
+      {
+        lengths[freqs.leaves[i].symbol] = depths[i];
+      }
+
+      return lengths;
     }
+  };
 
-    SymbolEncoding encoding() const noexcept
+  /**
+   * \brief Flat encoding table: the code of every symbol, bit-reversed so that it can be written
+   * LSB-first, and its length.
+   */
+  struct CodeTable
+  {
+    std::array<std::uint16_t, AlphabetSize> codes{};
+    CodeLengths lengths{};
+
+    static CodeTable make(const CodeLengths &lengths)
     {
-      std::stack<bool> path;
-      auto curr = this;
-      while (curr->parent)
+      CodeTable table;
+      table.lengths = lengths;
+
+      std::array<std::uint16_t, MaxCodeLength + 2> next_code{};
+      for (auto len : lengths)
+      {
+        next_code[len + 1]++;
+      }
+
+      /*
+       * Canonical codes: the codes of a given length are consecutive, in symbol order, and follow
+       * the codes of the shorter lengths, shifted by one bit.
+       */
+      next_code[1] = 0;
+      for (std::size_t len = 1; len <= MaxCodeLength; len++)
       {
-        /*
-         * If this is the left child of its parent, then the path from the parent to the current
-         * node is "1". If it is the right child, the path is "0". In other words, the edges of this
-         * binary tree are each given a number: the left edge is always 1, and the right edge is
-         * always 0.
-         */
-        path.push(curr == curr->parent->left);
+        next_code[len + 1] = (next_code[len] + next_code[len + 1]) << 1;
+      }
 
-        curr = curr->parent;
+      for (std::size_t symbol = 0; symbol < lengths.size(); symbol++)
+      {
+        if (auto len = lengths[symbol])
+        {
+          table.codes[symbol] = reverse(next_code[len]++, len);
+        }
       }
 
-      std::bitset<256> binary_path;
-      std::uint8_t binary_path_size = 0;
+      return table;
+    }
 
-      while (!path.empty())
+  private:
+    static std::uint16_t reverse(std::uint16_t code, std::size_t len) noexcept
+    {
+      std::uint16_t reversed = 0;
+      for (std::size_t i = 0; i < len; i++)
       {
-        binary_path.set(binary_path_size++, path.top());
-        path.pop();
+        reversed = (reversed << 1) | ((code >> i) & 1);
       }
 
-      return std::make_pair(binary_path, binary_path_size);
+      return reversed;
     }
   };
 
-  struct FreqTree
+  /**
+   * \brief Two-level lookup table resolving a whole code at a time.
+   *
+   * The primary table is indexed by the next PRIMARY_BITS bits of the stream. Codes that fit are
+   * resolved in a single hit: the entry holds the symbol and the code length. Longer codes lead to
+   * a secondary table, indexed by the bits following the primary ones. Since codes are at most
+   * MaxCodeLength bits long, two levels are always enough.
+   */
+  struct DecodeTable
   {
-    Node *root;
+    static constexpr std::size_t PRIMARY_BITS = 11;
+
+    /**
+     * \brief Every code longer than PRIMARY_BITS may have a secondary table of its own, and such a
+     * table indexes at most the MaxCodeLength - PRIMARY_BITS remaining bits.
+     */
+    static constexpr std::size_t MAX_ENTRIES = MaxCodeLength <= PRIMARY_BITS ?
+        std::size_t{1} << MaxCodeLength :
+        (std::size_t{1} << PRIMARY_BITS) + (AlphabetSize << (MaxCodeLength - PRIMARY_BITS));
+
+    struct Entry
+    {
+      std::uint16_t value;  ///< The symbol of a leaf, or the offset of the secondary table.
+      std::uint8_t length;  ///< The code length, or the secondary table index bits.
+      bool is_leaf;
+    };
+
+    std::array<Entry, MAX_ENTRIES> entries;
+    std::size_t size;
+    std::size_t primary_bits;
+
+    const Entry &operator[](std::size_t idx) const noexcept
+    {
+      return entries[idx];
+    }
 
-    std::map<std::byte, SymbolEncoding> to_table()
+    static DecodeTable make(const CodeTable &code_table)
     {
-      std::map<std::byte, SymbolEncoding> table;
-      std::stack<Node *> stack;
+      const auto &codes = code_table.codes;
+      const auto &lengths = code_table.lengths;
+      auto max_length = *std::max_element(lengths.begin(), lengths.end());
+
+      // The codes of an incomplete code set leave some entries unused, which then decode as 0.
+      DecodeTable table{};
+      table.primary_bits = std::min<std::size_t>(max_length, PRIMARY_BITS);
+      table.size = std::size_t{1} << table.primary_bits;
+
+      auto primary_mask = (std::size_t{1} << table.primary_bits) - 1;
+
+      // The longest code sharing a primary prefix gives the size of the prefix's secondary table.
+      std::array<std::uint8_t, std::size_t{1} << PRIMARY_BITS> secondary_bits{};
+      for (std::size_t symbol = 0; symbol < lengths.size(); symbol++)
+      {
+        if (lengths[symbol] > table.primary_bits)
+        {
+          auto &bits = secondary_bits[codes[symbol] & primary_mask];
+          bits = std::max<std::size_t>(bits, lengths[symbol] - table.primary_bits);
+        }
+      }
 
-      stack.push(root);
+      for (std::size_t prefix = 0; prefix <= primary_mask; prefix++)
+      {
+        if (secondary_bits[prefix])
+        {
+          auto offset = table.size;
+          table.size += std::size_t{1} << secondary_bits[prefix];
+          table.entries[prefix] = Entry{std::uint16_t(offset), secondary_bits[prefix], false};
+        }
+      }
 
-      while (!stack.empty())
+      for (std::size_t symbol = 0; symbol < lengths.size(); symbol++)
       {
-        auto curr = stack.top();
-        stack.pop();
+        auto len = lengths[symbol];
+        if (!len)
+        {
+          continue;
+        }
+
+        Entry entry{std::uint16_t(symbol), len, true};
+        std::size_t code = codes[symbol];
+        std::size_t offset = 0;
+        std::size_t table_bits = table.primary_bits;
 
-        if (curr->is_leaf())
+        if (len > table.primary_bits)
         {
-          table[curr->symbol] = curr->encoding();
+          const auto &link = table.entries[code & primary_mask];
+
+          offset = link.value;
+          table_bits = link.length;
+          code >>= table.primary_bits;
+          entry.length = len - table.primary_bits;
         }
-        else
+
+        // The bits past the code are the start of the next one, so they may take any value.
+        auto table_size = std::size_t{1} << table_bits;
+        for (auto idx = code; idx < table_size; idx += std::size_t{1} << entry.length)
         {
-          stack.push(curr->right);
-          stack.push(curr->left);
+          table.entries[offset + idx] = entry;
         }
       }
 
       return table;
     }
+  };
+
+protected:
+  /**
+   * \brief The largest archive of \p raw_size bytes: every code takes MaxCodeLength bits at most,
+   * and every stream ends with a partial byte.
+   */
+  static constexpr std::size_t compress_bound(std::size_t raw_size) noexcept
+  {
+    std::size_t elems_count_size = (utils::bytes::count_bits(raw_size) + 7) / 8;
+
+    return 1 + elems_count_size + MAX_LENGTHS_SIZE + (StreamsCount - 1) * elems_count_size +
+        (raw_size * MaxCodeLength + 7) / 8 + StreamsCount;
+  }
 
-    ~FreqTree()
+  /**
+   * \brief The code length of every symbol of \p histogram, 0 for the absent ones: the tree build
+   * of encode() on its own.
+   */
+  template <class Histogram>
+  static CodeLengths code_lengths(const Histogram &histogram)
+  {
+    auto freqs = Frequencies::make(histogram);
+    return freqs.size ? make_lengths(freqs) : CodeLengths{};
+  }
+
+  static utils::bytes::ByteSequence encode(utils::bytes::ByteView raw)
+  {
+    utils::bytes::ByteSequence output;
+    encode_into(raw, output);
+
+    return output;
+  }
+
+  static std::optional<std::size_t> encode(
+      utils::bytes::ByteView raw, utils::bytes::MutableByteView output)
+  {
+    utils::bytes::FixedBuffer buffer{output};
+    encode_into(raw, buffer);
+
+    if (buffer.overflowed())
     {
-      delete root;
+      return std::nullopt;
     }
-  };
 
-protected:
-  static utils::bytes::ByteSequence encode(const utils::bytes::ByteSequence &raw)
+    return buffer.size();
+  }
+
+  static utils::bytes::ByteSequence decode(utils::bytes::ByteView encoded)
   {
-    /*
-     * This must be left intact to be written in the encoded output.
-     */
-    const auto freq_map = make_freq_map(raw);
-    auto symbols_tree = make_tree(freq_map);
-    auto symbol_codes = symbols_tree.to_table();
+    utils::bytes::ByteSequence decompressed(symbols_count(encoded));
+    if (!decode(encoded, decompressed))
+    {
+      return {};
+    }
+
+    return decompressed;
+  }
+
+  static std::optional<std::size_t> decode(
+      utils::bytes::ByteView encoded, utils::bytes::MutableByteView output)
+  {
+    return decode_symbols(encoded, output);
+  }
+
+  /**
+   * \brief Append the archive of \p symbols to \p output, either a ByteSequence or a FixedBuffer.
+   */
+  template <class Output>
+  static void encode_symbols(utils::bytes::Span<const Symbol> symbols, Output &output)
+  {
+    encode_into(symbols, output);
+  }
 
-    for (const auto &[byte, freq] : freq_map)
+  /**
+   * \brief The number of symbols held by \p encoded, or 0 if it cannot hold that many: the streams
+   * take a bit per symbol at least, and only the archives of a single used symbol have none, for
+   * MAX_RUN_SIZE symbols at most.
+   */
+  static std::size_t symbols_count(utils::bytes::ByteView encoded)
+  {
+    if (encoded.empty())
     {
-      auto chr = std::to_integer<std::size_t>(byte);
-      auto [code, codelen] = symbol_codes[byte];
-      auto codestr = code.to_string();
+      return 0;
     }
 
-    utils::bytes::ByteSequence output;
-    output.reserve(raw.size());
+    auto control = std::to_integer<std::uint8_t>(encoded[0]);
+    std::size_t elems_count_size = control >> 4;
+    if (!valid_counter_size(elems_count_size))
+    {
+      return 0;
+    }
+
+    auto elems_count = read_elems_count(encoded);
+    if (elems_count <= encoded.size() * 8)
+    {
+      return elems_count;
+    }
+
+    if (elems_count_size >= encoded.size() || elems_count > MAX_RUN_SIZE)
+    {
+      return 0;
+    }
+
+    auto front = encoded.begin() + 1 + elems_count_size;
+    auto lengths = read_lengths(front, encoded.end(), control & 0xF);
+    if (!lengths || std::count(lengths->begin(), lengths->end(), 0) != AlphabetSize - 1)
+    {
+      return 0;
+    }
+
+    return elems_count;
+  }
+
+  /**
+   * \brief Decode the symbols of \p encoded into \p output.
+   * \returns The number of symbols, or nothing if they do not fit in \p output.
+   */
+  static std::optional<std::size_t> decode_symbols(
+      utils::bytes::ByteView encoded, utils::bytes::Span<Symbol> output)
+  {
+    if (encoded.empty())
+    {
+      return std::nullopt;
+    }
+
+    auto front = encoded.begin();
 
-    auto max_freq = std::max_element(freq_map.cbegin(), freq_map.cend(), [](auto &&a, auto &&b) {
-      return a.second < b.second;
-    });
-    auto freq_bits_count = utils::bytes::count_bits(max_freq->second);
-    std::uint8_t freq_bytes_count = std::ceil(freq_bits_count / 8.);
+    auto control = std::to_integer<std::uint8_t>(*front++);
+    auto flags = control & 0xF;
+    std::size_t elems_count_size = (control & 0xF0) >> 4;
+
+    auto elems_count = read_elems_count(encoded);
+    if (!valid_counter_size(elems_count_size) || elems_count_size >= encoded.size())
+    {
+      return std::nullopt;
+    }
+
+    std::advance(front, elems_count_size);
+
+    if (elems_count > output.size())
+    {
+      return std::nullopt;
+    }
+
+    auto decompressed = output.first(elems_count);
+    if (!elems_count)
+    {
+      return elems_count;
+    }
+
+    utils::stats::PhaseTimer timer{"huffman.decode.table"};
+    auto read = read_lengths(front, encoded.end(), flags);
+    if (!read)
+    {
+      return std::nullopt;
+    }
+
+    const auto &lengths = *read;
+
+    auto used = [](auto len) { return len != 0; };
+    auto used_count = std::count_if(lengths.begin(), lengths.end(), used);
+    if (!used_count)
+    {
+      return std::nullopt;
+    }
+
+    if (used_count == 1)
+    {
+      if (elems_count > MAX_RUN_SIZE)
+      {
+        return std::nullopt;
+      }
+
+      auto symbol_it = std::find_if(lengths.begin(), lengths.end(), used);
+      auto symbol = std::distance(lengths.begin(), symbol_it);
+
+      std::fill(decompressed.begin(), decompressed.end(), Symbol(symbol));
+      return elems_count;
+    }
+
+    if (!is_prefix_code(lengths))
+    {
+      return std::nullopt;
+    }
+
+    auto table = DecodeTable::make(CodeTable::make(lengths));
+    auto streams_count = std::size_t{1} << ((flags & STREAMS_MASK) >> 1);
+
+    timer.next("huffman.decode.streams");
+
+    StreamBounds bounds;
+    auto payload = front;
+
+    auto jump_table_size = (streams_count - 1) * elems_count_size;
+    if (jump_table_size > std::size_t(encoded.end() - payload))
+    {
+      return std::nullopt;
+    }
+
+    // The streams of a truncated archive end with it, and decode as zero bits past its end.
+    bounds[0] = payload + jump_table_size;
+    for (std::size_t i = 1; i < streams_count; i++)
+    {
+      std::array<std::byte, sizeof(std::size_t)> stream_size_bytes{};
+      std::copy_n(payload, elems_count_size, stream_size_bytes.begin());
+      payload += elems_count_size;
+
+      auto stream_size = utils::bytes::from_bytes<std::size_t>(stream_size_bytes);
+      bounds[i] = bounds[i - 1] + std::min<std::size_t>(stream_size, encoded.end() - bounds[i - 1]);
+    }
+
+    bounds[streams_count] = encoded.end();
+
+    switch (streams_count)
+    {
+      case 1:
+        decode_streams(table, bounds, decompressed, std::make_index_sequence<1>{});
+        break;
+      case 2:
+        decode_streams(table, bounds, decompressed, std::make_index_sequence<2>{});
+        break;
+      case 4:
+        decode_streams(table, bounds, decompressed, std::make_index_sequence<4>{});
+        break;
+      default:
+        decode_streams(table, bounds, decompressed, std::make_index_sequence<8>{});
+        break;
+    }
+
+    return elems_count;
+  }
+
+private:
+  /**
+   * \brief Append the archive of \p raw to \p output, either a ByteSequence or a FixedBuffer.
+   *
+   * A FixedBuffer too small for the archive overflows, and the archive is then left incomplete.
+   */
+  template <class Output>
+  static void encode_into(utils::bytes::Span<const Symbol> raw, Output &output)
+  {
     // how many bytes the number of elements in the archive takes
     std::uint8_t elems_count_size = std::ceil(utils::bytes::count_bits(raw.size()) / 8.);
 
+    if (raw.empty())
+    {
+      output.push_back(std::byte(elems_count_size << 4));
+      output.push_back(std::byte{0});
+
+      return;
+    }
+
+    utils::stats::PhaseTimer timer{"huffman.encode.histogram"};
+    auto freqs = Frequencies::make(make_histogram(raw));
+    if (freqs.size == 1 && raw.size() > MAX_RUN_SIZE)
+    {
+      // An unused symbol completes a one-bit code for the run.
+      freqs.leaves[1] = freqs.leaves[0];
+      freqs.leaves[0] = {0, std::uint16_t((freqs.leaves[1].symbol + 1) % AlphabetSize)};
+      freqs.size = 2;
+    }
+
+    timer.next("huffman.encode.tree");
+    const auto code_table = CodeTable::make(make_lengths(freqs));
+
+    timer.next("huffman.encode.streams");
+
     /*
-     * Control byte structure:
-     * Mask 11110000 must be applied to obtain the size of archive counter.
-     * Mask 00001111 must be applied to obtain the size of frequency values.
+     * The code lengths give the exact payload size, so the whole archive fits in one allocation:
+     * at most MAX_LENGTHS_SIZE bytes of lengths, and a spare word for the bit writer. A single
+     * symbol has no payload.
      */
-    output.push_back(std::byte{freq_bytes_count | (elems_count_size << 4)});
-    output.push_back(std::byte{symbol_codes.size()});  // how many symbols have been emitted.
+    std::size_t payload_bits = 0;
+    for (std::size_t i = 0; freqs.size > 1 && i < freqs.size; i++)
+    {
+      payload_bits += freqs.leaves[i].freq * code_table.lengths[freqs.leaves[i].symbol];
+    }
+
+    record_stats(raw.size(), payload_bits, freqs, code_table);
 
-    for (const auto &[byte, freq] : freq_map)
+    std::size_t streams_count = raw.size() < MIN_INTERLEAVED_SIZE ? 1 : StreamsCount;
+    auto jump_table_size = (streams_count - 1) * elems_count_size;
+
+    output.reserve(1 + elems_count_size + MAX_LENGTHS_SIZE + jump_table_size + payload_bits / 8 +
+        streams_count * sizeof(std::uint64_t));
+
+    std::uint8_t streams_log = utils::bytes::count_bits(streams_count) - 1;
+    write_header(output, code_table.lengths, raw.size(), elems_count_size, streams_log << 1);
+
+    /*
+     * A single symbol needs no code at all: the element counter says how many times it repeats.
+     */
+    if (freqs.size == 1)
     {
-      output.push_back(byte);
+      return;
+    }
+
+    auto jump_table = output.size();
+    output.resize(jump_table + jump_table_size);
 
-      auto fb = utils::bytes::to_bytes(freq);
-      std::copy_n(std::make_move_iterator(fb.begin()), freq_bytes_count, std::back_inserter(output));
+    if (utils::bytes::overflowed(output))
+    {
+      return;
     }
 
-    auto elems_count_bytes = utils::bytes::to_bytes(raw.size());
-    std::copy_n(std::make_move_iterator(elems_count_bytes.begin()), elems_count_size, std::back_inserter(output));
+    /*
+     * The stream sizes fit on elems_count_size bytes, like raw.size(), because a stream takes fewer
+     * bytes than the whole input: there are several streams from MIN_INTERLEAVED_SIZE symbols on
+     * only, so a segment holds raw.size() / 2 + 1 symbols at most, coded on 15 bits at most each,
+     * plus a partial last byte.
+     */
+    auto segment_size = (raw.size() + streams_count - 1) / streams_count;
+    for (std::size_t i = 0; i < streams_count; i++)
+    {
+      auto first = raw.data() + i * segment_size;
+      auto last = raw.data() + std::min(raw.size(), (i + 1) * segment_size);
 
-    utils::unaligned_storage::Writer write_unaligned{output};
+      auto stream_start = output.size();
+      encode_stream(first, last, code_table, output);
+
+      if (i + 1 < streams_count)
+      {
+        auto stream_size_bytes = utils::bytes::to_bytes(output.size() - stream_start);
+        std::copy_n(stream_size_bytes.begin(), elems_count_size,
+            output.begin() + jump_table + i * elems_count_size);
+      }
+    }
+  }
 
-    for (auto byte : raw)
+  /**
+   * \brief The number of occurrences of every symbol of \p raw. The bytes are counted on several
+   * tables side by side, which the wider symbols are too sparse to need.
+   */
+  static auto make_histogram(utils::bytes::Span<const Symbol> raw) noexcept
+  {
+    if constexpr (AlphabetSize == 256)
     {
-      const auto &[coding, coding_size] = symbol_codes[byte];
-      write_unaligned(coding, coding_size);
+      return utils::histogram::count_parallel(raw.data(), raw.data() + raw.size());
     }
+    else
+    {
+      std::array<std::size_t, AlphabetSize> histogram{};
+      for (auto symbol : raw)
+      {
+        histogram[symbol]++;
+      }
 
-    return output;
+      return histogram;
+    }
   }
 
-  static utils::bytes::ByteSequence decode(const utils::bytes::ByteSequence &encoded)
+  static std::size_t to_index(Symbol symbol) noexcept
   {
-    auto front = encoded.begin();
+    if constexpr (AlphabetSize == 256)
+    {
+      return std::to_integer<std::size_t>(symbol);
+    }
+    else
+    {
+      return symbol;
+    }
+  }
 
-    auto control = std::to_integer<std::uint8_t>(*front++);
-    auto freq_size = control & 0xF;
-    auto elems_count_size = (control & 0xF0) >> 4;
+  /**
+   * \brief Whether an elements counter of \p elems_count_size bytes may come from encode_into(),
+   * which writes 1 to sizeof(std::size_t) of them. The jump table entries take as many bytes.
+   */
+  static constexpr bool valid_counter_size(std::size_t elems_count_size) noexcept
+  {
+    return elems_count_size != 0 && elems_count_size <= sizeof(std::size_t);
+  }
 
-    auto table_size = std::to_integer<std::size_t>(*front++);
+  /**
+   * \brief The decompressed size stored in the header of \p encoded.
+   */
+  static std::size_t read_elems_count(utils::bytes::ByteView encoded) noexcept
+  {
+    if (encoded.empty())
+    {
+      return 0;
+    }
+
+    auto elems_count_size = std::to_integer<std::size_t>(encoded[0] >> 4);
+    elems_count_size = std::min({elems_count_size, encoded.size() - 1, sizeof(std::size_t)});
+
+    std::array<std::byte, sizeof(std::size_t)> elems_count_bytes{};
+    std::copy_n(encoded.begin() + 1, elems_count_size, elems_count_bytes.begin());
+
+    return utils::bytes::from_bytes<std::size_t>(elems_count_bytes);
+  }
 
-    FreqMap freq_map;
-    for (std::size_t i = 0; i < table_size; i++)
+  /**
+   * \brief Record the symbols coded, the payload they take and the histogram of the code lengths.
+   */
+  static void record_stats(std::size_t symbols_count, std::size_t payload_bits,
+      const Frequencies &freqs, const CodeTable &code_table)
+  {
+    if constexpr (utils::stats::ENABLED)
     {
-      std::byte symbol = *front++;
-      utils::bytes::ByteSequence bf(front, std::next(front, freq_size));
-      std::advance(front, freq_size);
+      utils::stats::add("huffman.symbols", symbols_count);
+      utils::stats::add("huffman.payload_bits", payload_bits);
+      utils::stats::ratio("huffman.bits_per_symbol", "huffman.payload_bits", "huffman.symbols");
 
-      auto freq = utils::bytes::from_bytes<std::size_t>(std::move(bf));
+      std::array<std::uint64_t, MaxCodeLength + 1> lengths_histogram{};
+      for (std::size_t i = 0; i < freqs.size; i++)
+      {
+        lengths_histogram[code_table.lengths[freqs.leaves[i].symbol]]++;
+      }
 
-      freq_map.emplace(symbol, freq);
+      for (std::size_t length = 0; length <= MaxCodeLength; length++)
+      {
+        utils::stats::add_to_histogram("huffman.code_lengths", length, lengths_histogram[length]);
+      }
     }
+  }
 
-    utils::bytes::ByteSequence decompressed;
+  template <class Output>
+  static void encode_stream(
+      const Symbol *first, const Symbol *last, const CodeTable &code_table, Output &output)
+  {
+    utils::unaligned_storage::BitWriter write_bits{output};
 
-    auto symbols_tree = make_tree(freq_map);
-    auto symbol_codes = symbols_tree.to_table();
+    auto write_code = [&write_bits, &code_table](Symbol value) {
+      auto symbol = to_index(value);
+      write_bits.write(code_table.codes[symbol], code_table.lengths[symbol]);
+    };
 
-    for (const auto &[byte, freq] : freq_map)
+    for (auto n = (last - first) / CODES_PER_COMMIT; n; n--)
     {
-      auto chr = std::to_integer<std::size_t>(byte);
-      auto [code, codelen] = symbol_codes[byte];
-      auto codestr = code.to_string();
+      for (std::size_t i = 0; i < CODES_PER_COMMIT; i++)
+      {
+        write_code(*first++);
+      }
+
+      write_bits.commit();
     }
 
-    auto elems_count_bytes = utils::bytes::ByteSequence(front, std::next(front, elems_count_size));
-    auto elems_count = utils::bytes::from_bytes<std::size_t>(std::move(elems_count_bytes));
-    std::advance(front, elems_count_size);
+    for (; first != last; ++first)
+    {
+      write_code(*first);
+      write_bits.commit();
+    }
+
+    write_bits.flush();
+  }
+
+  static Symbol decode_symbol(
+      utils::unaligned_storage::BitReader &bits, const DecodeTable &table) noexcept
+  {
+    auto entry = table[bits.peek(table.primary_bits)];
+    if (!entry.is_leaf)
+    {
+      bits.consume(table.primary_bits);
+      entry = table[entry.value + bits.peek(entry.length)];
+    }
+
+    bits.consume(entry.length);
+    return Symbol(entry.value);
+  }
+
+  template <std::size_t... Streams>
+  static auto make_readers(const StreamBounds &bounds, std::index_sequence<Streams...>) noexcept
+  {
+    return std::array<utils::unaligned_storage::BitReader, sizeof...(Streams)>{
+        utils::unaligned_storage::BitReader{bounds[Streams], bounds[Streams + 1]}...};
+  }
+
+  /**
+   * \brief Decode the streams delimited by \p bounds side by side, each into its segment of
+   * \p decompressed.
+   *
+   * The steps of every stream are expanded over the Streams pack rather than looped over, so that
+   * each bit reader gets its own registers and the chains of the streams overlap.
+   */
+  template <std::size_t... Streams>
+  static void decode_streams(const DecodeTable &table, const StreamBounds &bounds,
+      utils::bytes::Span<Symbol> decompressed, std::index_sequence<Streams...> streams)
+  {
+    constexpr auto N = sizeof...(Streams);
+    auto readers = make_readers(bounds, streams);
+    auto segment_size = (decompressed.size() + N - 1) / N;
+
+    std::array<Symbol *, N> outs;
+    for (std::size_t i = 0; i < N; i++)
+    {
+      outs[i] = decompressed.data() + std::min(decompressed.size(), i * segment_size);
+    }
+
+    // The last segment is the shortest one, so every stream has at least that many symbols.
+    std::size_t last_segment_size = decompressed.data() + decompressed.size() - outs[N - 1];
+    for (auto n = last_segment_size / CODES_PER_REFILL; n; n--)
+    {
+      (std::get<Streams>(readers).refill(), ...);
 
-    auto curr = symbols_tree.root;
+      for (std::size_t i = 0; i < CODES_PER_REFILL; i++)
+      {
+        ((*std::get<Streams>(outs)++ = decode_symbol(std::get<Streams>(readers), table)), ...);
+      }
+    }
+
+    for (std::size_t stream = 0; stream < N; stream++)
+    {
+      auto segment_last =
+          decompressed.data() + std::min(decompressed.size(), (stream + 1) * segment_size);
+
+      for (; outs[stream] != segment_last; ++outs[stream])
+      {
+        readers[stream].refill();
+        *outs[stream] = decode_symbol(readers[stream], table);
+      }
+    }
+  }
+
+  /**
+   * \brief Optimal code lengths of at most MaxCodeLength bits.
+   *
+   * The depths of the Huffman tree are used whenever they fit, which is the common case. Otherwise
+   * the lengths are computed by package-merge.
+   */
+  static CodeLengths make_lengths(const Frequencies &freqs)
+  {
+    if (freqs.size == 1)
+    {
+      CodeLengths lengths{};
+      lengths[freqs.leaves[0].symbol] = 1;
+
+      return lengths;
+    }
+
+    auto lengths = FreqTree::make(freqs).to_lengths(freqs);
+    if (*std::max_element(lengths.begin(), lengths.end()) <= MaxCodeLength)
+    {
+      return lengths;
+    }
+
+    return package_merge(freqs);
+  }
+
+  /**
+   * \brief Length-limited code lengths, by the package-merge algorithm.
+   *
+   * The symbols are coins whose denominations are 2^-1 ... 2^-MaxCodeLength and whose values are
+   * their frequencies. Starting from the smallest denomination, the cheapest items are packaged in
+   * pairs and merged with the coins of the next denomination. The cheapest 2n - 2 items of the
+   * last list are selected, and the length of a symbol is the number of its coins among them.
+   */
+  static CodeLengths package_merge(const Frequencies &freqs)
+  {
+    struct Item
+    {
+      std::size_t weight;
+      std::int32_t symbol;  ///< The symbol of a coin, or -1 for a package.
+      std::uint16_t first;  ///< The first of the two packaged items, in the previous list.
+    };
+
+    auto lighter = [](auto &&a, auto &&b) { return a.weight < b.weight; };
 
-    utils::unaligned_storage::Reader reader{front};
+    std::vector<Item> coins;
+    for (std::size_t i = 0; i < freqs.size; i++)
+    {
+      coins.push_back(Item{freqs.leaves[i].freq, freqs.leaves[i].symbol, 0});
+    }
 
-    while (elems_count)
+    std::vector<std::vector<Item>> lists{coins};
+    for (std::size_t level = 1; level < MaxCodeLength; level++)
     {
-      if (curr->is_leaf())
+      const auto &prev = lists.back();
+
+      std::vector<Item> packages;
+      for (std::size_t i = 0; i + 1 < prev.size(); i += 2)
       {
-        decompressed.push_back(curr->symbol);
-        curr = symbols_tree.root;
-        elems_count--;
+        packages.push_back(Item{prev[i].weight + prev[i + 1].weight, -1, std::uint16_t(i)});
       }
 
-      bool bit = reader.read();
-      if (bit == 1)  // the left edge must be picked
+      std::vector<Item> merged;
+      std::merge(coins.begin(), coins.end(), packages.begin(), packages.end(),
+          std::back_inserter(merged), lighter);
+
+      lists.push_back(std::move(merged));
+    }
+
+    CodeLengths lengths{};
+    std::stack<std::pair<std::size_t, std::size_t>> stack;  // (list, item)
+
+    for (std::size_t i = 0; i < 2 * coins.size() - 2; i++)
+    {
+      stack.emplace(lists.size() - 1, i);
+    }
+
+    while (!stack.empty())
+    {
+      auto [list, idx] = stack.top();
+      stack.pop();
+
+      const auto &item = lists[list][idx];
+      if (item.symbol >= 0)
       {
-        curr = curr->left;
+        lengths[item.symbol]++;
       }
-      else  // if 0, the right edge must be picked
+      else
       {
-        curr = curr->right;
+        stack.emplace(list - 1, item.first);
+        stack.emplace(list - 1, item.first + 1);
       }
     }
 
-    return decompressed;
+    return lengths;
   }
 
-private:
-  static FreqMap make_freq_map(const utils::bytes::ByteSequence &raw)
+  template <class Output>
+  static void write_header(Output &output, const CodeLengths &lengths,
+      std::size_t elems_count, std::uint8_t elems_count_size, std::uint8_t flags)
   {
-    FreqMap freq_map;
-
-    for (auto byte : raw)
+    std::array<std::uint16_t, AlphabetSize> symbols;
+    std::size_t symbols_count = 0;
+    for (std::size_t symbol = 0; symbol < lengths.size(); symbol++)
     {
-      if (freq_map.find(byte) == freq_map.end())
+      if (lengths[symbol])
       {
-        freq_map.emplace(byte, 0);
+        symbols[symbols_count++] = std::uint16_t(symbol);
       }
+    }
+
+    std::size_t first = symbols[0];
+    std::size_t last = symbols[symbols_count - 1];
 
-      freq_map[byte]++;
+    auto dense_size = 2 * SYMBOL_BYTES + (last - first + 2) / 2;
+    auto sparse_size = (1 + symbols_count) * SYMBOL_BYTES + (symbols_count + 1) / 2;
+    if (sparse_size < dense_size)
+    {
+      flags |= SPARSE_LENGTHS;
     }
 
-    std::vector<std::size_t> frequencies(freq_map.size(), 0);
-    std::transform(freq_map.begin(), freq_map.end(), frequencies.begin(), [](auto &&p) {
-      return p.second;
-    });
+    output.push_back(std::byte(flags | (elems_count_size << 4)));
+
+    auto elems_count_bytes = utils::bytes::to_bytes(elems_count);
+    std::copy_n(elems_count_bytes.begin(), elems_count_size, std::back_inserter(output));
 
-    std::size_t gcd = utils::numeric::gcd(frequencies.begin(), frequencies.end());
+    std::array<std::uint8_t, AlphabetSize> nibbles;
+    std::size_t nibbles_count = 0;
 
-    for (auto &[byte, freq] : freq_map)
+    if (flags & SPARSE_LENGTHS)
     {
-      freq /= gcd;
+      write_symbol(output, symbols_count - 1);
+      for (std::size_t i = 0; i < symbols_count; i++)
+      {
+        write_symbol(output, symbols[i]);
+        nibbles[nibbles_count++] = lengths[symbols[i]];
+      }
+    }
+    else
+    {
+      write_symbol(output, first);
+      write_symbol(output, last);
+      nibbles_count = std::copy(lengths.begin() + first, lengths.begin() + last + 1,
+                          nibbles.begin()) - nibbles.begin();
     }
 
-    return freq_map;
+    for (std::size_t i = 0; i < nibbles_count; i += 2)
+    {
+      auto high = i + 1 < nibbles_count ? nibbles[i + 1] : 0;
+      output.push_back(std::byte(nibbles[i] | (high << 4)));
+    }
+  }
+
+  template <class Output>
+  static void write_symbol(Output &output, std::size_t symbol)
+  {
+    for (std::size_t i = 0; i < SYMBOL_BYTES; i++)
+    {
+      output.push_back(std::byte(symbol >> (i << 3)));
+    }
   }
 
-  static Node *make_subtree(Node *left, Node *right)
+  /**
+   * \brief Read a symbol written by write_symbol(). The values past the alphabet, which only a
+   * malformed header holds, are clamped to its last symbol.
+   */
+  template <class InputIt>
+  static std::size_t read_symbol(InputIt &front)
   {
-    return new Node(std::byte{0}, left->freq + right->freq, left, right);
+    std::size_t symbol = 0;
+    for (std::size_t i = 0; i < SYMBOL_BYTES; i++)
+    {
+      symbol |= std::to_integer<std::size_t>(*front++) << (i << 3);
+    }
+
+    return std::min(symbol, AlphabetSize - 1);
   }
 
-  static FreqTree make_tree(const FreqMap &freq_map)
+  /**
+   * \brief Read the code lengths section of the header, which must end before \p last.
+   * \returns The code lengths, or nothing if the section is truncated.
+   */
+  template <class InputIt>
+  static std::optional<CodeLengths> read_lengths(InputIt &front, InputIt last, std::uint8_t flags)
   {
-    auto cmp = [](auto &&a, auto &&b) {
-      if (a->freq == b->freq)
+    auto available = [&front, last](std::size_t size) {
+      return size <= std::size_t(last - front);
+    };
+
+    std::array<std::uint16_t, AlphabetSize> symbols;
+    std::size_t symbols_count = 0;
+
+    if (flags & SPARSE_LENGTHS)
+    {
+      if (!available(SYMBOL_BYTES))
       {
-        return a->symbol < b->symbol;
+        return std::nullopt;
       }
 
-      return b->freq < a->freq;
-    };
+      symbols_count = read_symbol(front) + 1;
+      if (!available(symbols_count * SYMBOL_BYTES))
+      {
+        return std::nullopt;
+      }
 
-    std::priority_queue<Node *, std::vector<Node *>, decltype(cmp)> pq(cmp);
-    for (auto [b, f] : freq_map)
+      for (std::size_t i = 0; i < symbols_count; i++)
+      {
+        symbols[i] = std::uint16_t(read_symbol(front));
+      }
+    }
+    else
     {
-      pq.push(new Node(b, f));
+      if (!available(2 * SYMBOL_BYTES))
+      {
+        return std::nullopt;
+      }
+
+      auto first = read_symbol(front);
+      auto last_symbol = read_symbol(front);
+      for (auto symbol = first; symbol <= last_symbol; symbol++)
+      {
+        symbols[symbols_count++] = std::uint16_t(symbol);
+      }
     }
 
-    while (pq.size() > 1)
+    if (!available((symbols_count + 1) / 2))
     {
-      auto left = pq.top();
-      pq.pop();
-      auto right = pq.top();
-      pq.pop();
+      return std::nullopt;
+    }
 
-      pq.push(make_subtree(left, right));
+    CodeLengths lengths{};
+    for (std::size_t i = 0; i < symbols_count; i += 2)
+    {
+      auto packed = std::to_integer<std::uint8_t>(*front++);
+
+      lengths[symbols[i]] = packed & 0xF;
+      if (i + 1 < symbols_count)
+      {
+        lengths[symbols[i + 1]] = packed >> 4;
+      }
     }
 
-    auto root = pq.top();
-    pq.pop();
+    return lengths;
+  }
+
+  /**
+   * \brief Whether \p lengths, read from an archive, make a complete prefix code within
+   * MaxCodeLength bits: the Kraft sum of the lengths is 1, so that every code reads a symbol.
+   * Archives of a single used symbol have no code, and do not get there.
+   */
+  static bool is_prefix_code(const CodeLengths &lengths) noexcept
+  {
+    std::size_t kraft_sum = 0;
+    for (auto len : lengths)
+    {
+      if (len > MaxCodeLength)
+      {
+        return false;
+      }
+
+      kraft_sum += len ? std::size_t{1} << (MaxCodeLength - len) : 0;
+    }
 
-    return FreqTree{root};
+    return kraft_sum == std::size_t{1} << MaxCodeLength;
   }
 };
 
+using Huffman = BasicHuffman<>;
+
 }  // namespace compression
@@ -1,19 +1,18 @@
 #pragma once
 
-#include "compression/seq.h"
+#include "compression/dictionary.h"
 #include "utils/bytes.h"
+#include "utils/stats.h"
+#include "utils/unaligned_storage.h"
 
 #include <algorithm>
-#include <array>
-#include <cmath>
 #include <cstddef>
 #include <cstdint>
-#include <cstdio>
-#include <iostream>  // FIXME Remove include
+#include <cstring>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <optional>
-#include <stack>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -21,344 +20,869 @@
 namespace compression
 {
 
-static constexpr std::size_t ASCII_TABLE_SIZE = 256;
+namespace detail
+{
+
+  /**
+   * \brief The number of whole bytes needed by a dictionary pointer below \p dict_size.
+   */
+  constexpr std::size_t ptr_size_for(std::size_t dict_size) noexcept
+  {
+    return (utils::bytes::count_bits(dict_size) + 7) / 8;
+  }
+
+  inline void put_ptr(utils::bytes::ByteSequence &out, std::size_t ptr, std::size_t ptr_size)
+  {
+    for (std::size_t i = 0; i < ptr_size; i++)
+    {
+      out.push_back(std::byte((ptr >> (i << 3)) & 0xFF));
+    }
+  }
+
+  template <class OutputIt>
+  OutputIt write_ptr(OutputIt out, std::size_t ptr, std::size_t ptr_size)
+  {
+    for (std::size_t i = 0; i < ptr_size; i++)
+    {
+      *out++ = std::byte((ptr >> (i << 3)) & 0xFF);
+    }
+
+    return out;
+  }
+
+  template <class InputIt>
+  std::size_t read_ptr(InputIt &it, std::size_t ptr_size)
+  {
+    std::size_t ptr = 0;
+    for (std::size_t i = 0; i < ptr_size; i++)
+    {
+      ptr |= std::to_integer<std::size_t>(*it++) << (i << 3);
+    }
+
+    return ptr;
+  }
+
+  /**
+   * \brief Record the \p codes_count phrases the encoder \p name emitted for \p raw_size bytes, and
+   * the size of its final dictionary.
+   */
+  inline void record_encoder_stats(std::string_view name, std::size_t raw_size,
+      std::size_t codes_count, const Dictionary &dict)
+  {
+    if constexpr (utils::stats::ENABLED)
+    {
+      std::string codec{name};
+
+      utils::stats::add(codec + ".raw_bytes", raw_size);
+      utils::stats::add(codec + ".codes", codes_count);
+      utils::stats::ratio(codec + ".phrase_length", codec + ".raw_bytes", codec + ".codes");
+      utils::stats::maximum(codec + ".dictionary_entries", dict.size());
+      utils::stats::maximum(codec + ".dictionary_bytes", dict.memory_usage());
+    }
+  }
+
+}  // namespace detail
+
+/**
+ * \brief What the LZW encoder does once the dictionary reaches its maximum size.
+ */
+enum class DictionaryPolicy : std::uint8_t
+{
+  Freeze,  ///< Keep encoding with the full dictionary, without adding new entries.
+  Reset,  ///< Emit the CLEAR code and start over with a fresh dictionary.
+  Monitor,  ///< Freeze, and reset with a CLEAR code once the compression ratio degrades.
+};
 
 /**
- * \brief Dictionary implementation for the LZW compressor.
+ * \brief Single pass LZW encoding loop.
+ *
+ * The encoder keeps a cursor on the dictionary entry resembling the current sequence. Every input
+ * byte either moves the cursor to a child entry, or ends the current sequence: its code is handed
+ * to the sink, the new entry is added straight off the cursor and the cursor restarts from the
+ * single byte entry. Nothing is allocated besides the dictionary growth.
  *
- * Operations complexities:
- *  - put_sequence: O(m)
- *  - contains: O(1)
- *  - find: O(m)
- *  - at/operator[]: O(1)
- * where m := length(seq)
+ * The sink is always called before the dictionary is modified, so the emitted code is below the
+ * dictionary size at that point.
  */
-class Dictionary
+class LZWEncoder
 {
 public:
-  struct Node
-  {
-    Node *parent;
-    std::size_t index;
-    std::byte symbol;
-    std::array<Node *, ASCII_TABLE_SIZE> children;
-
-    Node(Node *parent, std::size_t index, std::byte symbol) :
-        parent{parent},
-        index{index},
-        symbol{symbol},
-        children{}
-    {
-      children.fill(nullptr);
-    }
+  static constexpr std::size_t CLEAR_CODE = ASCII_TABLE_SIZE;
+
+  explicit LZWEncoder(Dictionary &dict, std::size_t max_size = Dictionary::npos,
+      DictionaryPolicy policy = DictionaryPolicy::Freeze) noexcept :
+      dict_{std::addressof(dict)},
+      max_size_{max_size},
+      policy_{policy}
+  {}
 
-    Node *add_child(std::size_t index, std::byte symbol)
+  /**
+   * \brief Encode the bytes in [first, last), passing every completed code to \p emit.
+   */
+  template <class InputIt, class CodeSink>
+  void feed(InputIt first, InputIt last, CodeSink &&emit)
+  {
+    auto curr = curr_;
+
+    for (; first != last; ++first)
     {
-      auto n = std::make_unique<Node>(this, index, symbol);
-      auto symbol_pos = std::to_integer<std::size_t>(symbol);
+      std::byte x = *first;
+      if (curr == Dictionary::npos)
+      {
+        curr = std::to_integer<std::size_t>(x);
+        continue;
+      }
+
+      auto next = dict_->child_at(curr, x);
 
-      if (children[symbol_pos])
+      if (!next)  // We don't have the entry Ix in dictionary
       {
-        return nullptr;
+        emit(curr);
+
+        if (dict_->size() < max_size_)
+        {
+          dict_->put_symbol(curr, x);
+          clear_pending_ |= dict_->size() == max_size_ && policy_ == DictionaryPolicy::Reset;
+        }
+
+        if (clear_pending_)
+        {
+          emit(CLEAR_CODE);
+          dict_->reset();
+          clear_pending_ = false;
+        }
+
+        curr = std::to_integer<std::size_t>(x);
+        continue;
       }
 
-      children[std::to_integer<std::size_t>(symbol)] = n.release();
-      return children[symbol_pos];
+      curr = *next;
     }
 
-    Node *child_at(std::byte s) noexcept
+    curr_ = curr;
+  }
+
+  /**
+   * \brief Emit the code of the pending sequence, if any.
+   *
+   * After the EOF condition is met, we need to make sure to emit the dictionary pointer of the
+   * last sequence.
+   */
+  template <class CodeSink>
+  void flush(CodeSink &&emit)
+  {
+    if (curr_ != Dictionary::npos)
     {
-      return children[std::to_integer<std::size_t>(s)];
+      emit(curr_);
+      curr_ = Dictionary::npos;
     }
+  }
+
+  /**
+   * \brief Emit the CLEAR code and reset the dictionary once the current sequence ends.
+   *
+   * The dictionary must have been created with the CLEAR code reserved.
+   */
+  void clear() noexcept
+  {
+    clear_pending_ = true;
+  }
+
+  bool full() const noexcept
+  {
+    return dict_->size() >= max_size_;
+  }
+
+private:
+  Dictionary *dict_;
+  std::size_t max_size_;
+  DictionaryPolicy policy_;
+  std::size_t curr_{Dictionary::npos};
+  bool clear_pending_{false};
+};
+
+/**
+ * \brief Decoding side of the LZW dictionary.
+ *
+ * Every dictionary entry is recorded as the (offset, length) of an occurrence of its sequence
+ * within the decoded output. Emitting a phrase is then a bounded copy out of the output itself,
+ * instead of a walk over parent pointers. Single byte entries are written directly.
+ *
+ * The output either grows geometrically and is only trimmed to its final size by release(), or is
+ * a caller-owned buffer of fixed size, which overflows instead of growing.
+ */
+class PhraseBuffer
+{
+public:
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  struct Phrase
+  {
+    std::size_t offset;
+    std::size_t length;
+  };
+
+  explicit PhraseBuffer(std::size_t reserved_codes = 0, std::size_t size_hint = 0) :
+      initial_size_{ASCII_TABLE_SIZE + reserved_codes},
+      phrases_(initial_size_, Phrase{npos, 1}),
+      owned_(size_hint),
+      out_{owned_}
+  {}
+
+  PhraseBuffer(std::size_t reserved_codes, utils::bytes::MutableByteView storage) :
+      initial_size_{ASCII_TABLE_SIZE + reserved_codes},
+      phrases_(initial_size_, Phrase{npos, 1}),
+      out_{storage},
+      fixed_{true}
+  {}
 
-    ~Node()
+  PhraseBuffer(const PhraseBuffer &) = delete;
+  PhraseBuffer &operator=(const PhraseBuffer &) = delete;
+
+  /**
+   * \brief Drop every entry longer than one byte. The decoded output is kept.
+   */
+  void reset() noexcept
+  {
+    phrases_.resize(initial_size_);
+  }
+
+  void add(Phrase phrase)
+  {
+    phrases_.push_back(phrase);
+  }
+
+  Phrase &phrase(std::size_t code) noexcept
+  {
+    return phrases_[code];
+  }
+
+  /**
+   * \brief The number of dictionary entries.
+   */
+  std::size_t entries() const noexcept
+  {
+    return phrases_.size();
+  }
+
+  /**
+   * \brief The number of bytes decoded so far.
+   */
+  std::size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  /**
+   * \brief Whether the fixed output was too small for the decoded bytes.
+   */
+  bool overflowed() const noexcept
+  {
+    return overflowed_;
+  }
+
+  /**
+   * \brief Append the sequence of \p code to the output, unless it overflows.
+   *
+   * The recorded occurrence must start before the current end of the output. It may run past it:
+   * the bytes are then copied one at a time, so they are produced before being read.
+   */
+  void emit(std::size_t code)
+  {
+    if (code < ASCII_TABLE_SIZE)
     {
-      for (auto &node_ptr : children)
+      if (auto dst = extend(1))
       {
-        delete node_ptr;
+        *dst = std::byte(code);
       }
+
+      return;
     }
-  };
 
-  Dictionary()
-  {
-    entries_.reserve(ASCII_TABLE_SIZE);
-    for (std::size_t i = 0; i != ASCII_TABLE_SIZE; i++)
+    auto [offset, length] = phrases_[code];
+    auto dst = extend(length);
+    if (!dst)
     {
-      entries_.push_back(root_->add_child(size_++, std::byte{i}));
+      return;
+    }
+
+    auto src = out_.data() + offset;
+
+    if (offset + length <= size_ - length)
+    {
+      std::memcpy(dst, src, length);
+    }
+    else
+    {
+      for (std::size_t i = 0; i < length; i++)
+      {
+        dst[i] = src[i];
+      }
     }
   }
 
   /**
-   * \brief Add a new sequence into the dictionary.
-   * \param seq The byte sequence to be added
-   * \returns The index of the last node that has been added.
+   * \brief Append \p length bytes to the output, to be written by the caller.
+   * \returns The first appended byte, valid until the next call, or nullptr if the fixed output
+   * overflows.
    */
-  std::size_t put_sequence(const utils::bytes::ByteSequence &seq) noexcept
+  std::byte *extend(std::size_t length)
   {
-    Node *curr = root_.get();
-    std::size_t front = 0;
-
-    while (front < seq.size())
+    if (size_ + length > out_.size())
     {
-      auto chr = seq[front++];
-      if (!curr->child_at(chr))
+      if (fixed_)
       {
-        entries_.push_back(curr->add_child(size_++, chr));
+        overflowed_ = true;
+        return nullptr;
       }
 
-      curr = curr->child_at(chr);
+      owned_.resize(std::max(owned_.size() * 2, size_ + length));
+      out_ = owned_;
     }
 
-    return curr->index;
+    auto dst = out_.data() + size_;
+    size_ += length;
+
+    return dst;
   }
 
-  Node *put_symbol(std::size_t parent_idx, std::byte symbol) noexcept
+  std::byte *data() noexcept
   {
-    auto node_idx = size_++;
-    Node *parent = entries_[parent_idx];
-    Node *child = parent->add_child(node_idx, symbol);
-    entries_.push_back(child);
+    return out_.data();
+  }
 
-    return child;
+  /**
+   * \brief The growing output, trimmed to the bytes decoded.
+   */
+  utils::bytes::ByteSequence release()
+  {
+    owned_.resize(size_);
+    return std::move(owned_);
   }
 
+private:
+  std::size_t initial_size_;
+  std::vector<Phrase> phrases_;
+  utils::bytes::ByteSequence owned_;
+  utils::bytes::MutableByteView out_;
+  std::size_t size_{0};
+  bool fixed_{false};
+  bool overflowed_{false};
+};
+
+class LZW
+{
+protected:
   /**
-   * \brief Checks whether a sequence with the given index exists in the dictionary.
-   * \param index The index to be checked.
+   * \brief The largest archive of \p raw_size bytes: one dictionary entry and one code per input
+   * byte, at the widest pointer size.
    */
-  bool contains(std::size_t index) const noexcept
+  static constexpr std::size_t compress_bound(std::size_t raw_size) noexcept
   {
-    return size_ > index;
+    auto ptr_size = detail::ptr_size_for(ASCII_TABLE_SIZE + raw_size);
+
+    return 1 + ptr_size + raw_size * (2 * ptr_size + 1);
   }
 
-  Node *find_node(const utils::bytes::ByteSequence &bytes) const noexcept
+  static utils::bytes::ByteSequence encode(utils::bytes::ByteView raw)
   {
-    Node *curr = root_.get();
-    std::size_t front = 0;
+    Dictionary dict;
+    LZWEncoder encoder{dict};
 
-    while (front < bytes.size())
+    /*
+     * The dictionary grows by at most one entry per input byte, so every code fits in the width
+     * required by ASCII_TABLE_SIZE + raw.size(). The codes are written straight into the output
+     * with this width, and narrowed once the final dictionary size is known.
+     */
+    auto wide_ptr_size = detail::ptr_size_for(ASCII_TABLE_SIZE + raw.size());
+
+    utils::bytes::ByteSequence encoded;
+    encoded.reserve(raw.size() / 2);
+
+    auto emit = [&encoded, wide_ptr_size](std::size_t code) {
+      detail::put_ptr(encoded, code, wide_ptr_size);
+    };
+
+    utils::stats::PhaseTimer timer{"lzw.encode.codes"};
+    encoder.feed(raw.begin(), raw.end(), emit);
+    encoder.flush(emit);
+
+    timer.next("lzw.encode.header");
+
+    /*
+     * We need to determine how many bits per dictionary pointer our archive requires. Currently,
+     * this implementation will round this to the next byte. That is, dictionary pointers are not
+     * going to be stored on split bytes.
+     */
+    auto ptr_size = detail::ptr_size_for(dict.size());
+    auto ptrs_count = encoded.size() / wide_ptr_size;
+    detail::record_encoder_stats("lzw", raw.size(), ptrs_count, dict);
+
+    if (ptr_size != wide_ptr_size)
     {
-      auto chr = bytes[front++];
-      if (!curr->child_at(chr))
+      // Narrowing in place is safe, since every code is moved to a lower or the same offset.
+      for (std::size_t i = 0; i < ptrs_count; i++)
       {
-        return nullptr;
+        std::copy_n(std::next(encoded.begin(), i * wide_ptr_size), ptr_size,
+            std::next(encoded.begin(), i * ptr_size));
       }
+    }
 
-      curr = curr->child_at(chr);
+    auto entries_count = dict.size() - ASCII_TABLE_SIZE;
+    auto header_size = 1 + ptr_size + entries_count * (ptr_size + 1);
+    auto ptrs_size = ptrs_count * ptr_size;
+
+    encoded.resize(header_size + ptrs_size);
+    std::copy_backward(encoded.begin(), std::next(encoded.begin(), ptrs_size), encoded.end());
+
+    auto out = encoded.begin();
+    *out++ = std::byte(ptr_size);
+    out = detail::write_ptr(out, entries_count, ptr_size);
+
+    for (std::size_t i = ASCII_TABLE_SIZE; i < dict.size(); i++)
+    {
+      auto node = dict.entry(i);
+
+      out = detail::write_ptr(out, node->parent, ptr_size);
+      *out++ = node->symbol;
     }
 
-    return curr;
+    return encoded;
   }
 
   /**
-   * \brief Find the index of the given sequence within the dictionary.
-   * \param bytes The byte array to be searched for.
-   * \return The index of the last node in the given sequence, or an empty optional otherwise.
+   * \brief The header depends on the final dictionary, and is only known once the codes are
+   * written, so the archive is staged in a ByteSequence before being copied to \p output.
    */
-  std::optional<std::size_t> find(const utils::bytes::ByteSequence &bytes) const noexcept
+  static std::optional<std::size_t> encode(
+      utils::bytes::ByteView raw, utils::bytes::MutableByteView output)
   {
-    auto node = find_node(bytes);
-    if (node)
-    {
-      return node->index;
-    }
-    else
+    auto encoded = encode(raw);
+    if (encoded.size() > output.size())
     {
       return std::nullopt;
     }
+
+    std::copy(encoded.begin(), encoded.end(), output.begin());
+    return encoded.size();
   }
 
   /**
-   * \brief Get the bytes sequence resembled by the last node, found at \p index.
-   *
-   * Note that this function performs checked access which is slower than unchecked access. For
-   * unchecked access, see the subscript operator.
-   * \param index The index of the node representing the last symbol of the sequence.
-   * \returns A byte sequence containing the found sequence, or an empty sequence if the sequence
-   * does not exist.
+   * \returns The decompressed data, or nothing if the archive is malformed.
    */
-  utils::bytes::ByteSequence at(std::size_t index) const noexcept
+  static utils::bytes::ByteSequence decode(utils::bytes::ByteView encoded)
   {
-    if (!contains(index))
+    PhraseBuffer phrases{0, encoded.size() * 2};
+    if (!decode_into(encoded, phrases))
     {
       return {};
     }
 
-    return operator[](index);
+    return phrases.release();
   }
 
+  static std::optional<std::size_t> decode(
+      utils::bytes::ByteView encoded, utils::bytes::MutableByteView output)
+  {
+    PhraseBuffer phrases{0, output};
+    if (!decode_into(encoded, phrases) || phrases.overflowed())
+    {
+      return std::nullopt;
+    }
+
+    return phrases.size();
+  }
+
+private:
   /**
-   * \brief Performs unchecked access on the dictionary.
-   * \see Dictionary::at
+   * \returns Whether the archive is well formed, as far as it was read: every pointer of the
+   * dictionary refers to an earlier entry, and every code to an entry.
    */
-  utils::bytes::ByteSequence operator[](std::size_t index) const noexcept
+  static bool decode_into(utils::bytes::ByteView encoded, PhraseBuffer &phrases)
   {
-    utils::bytes::ByteSequence bytes;  // TODO Find the average sequence length and reserve it here.
-    std::stack<std::byte> rev;
-    auto curr = entries_[index];
+    if (encoded.empty())
+    {
+      return false;
+    }
 
-    while (curr->parent)
+    auto ptr_size = std::to_integer<std::size_t>(encoded[0]);
+    if (ptr_size == 0 || ptr_size > sizeof(std::size_t) || encoded.size() < 1 + ptr_size)
     {
-      rev.push(curr->symbol);
-      curr = curr->parent;
+      return false;
     }
 
-    bytes.reserve(rev.size());
-    while (!rev.empty())
+    auto it = std::next(encoded.begin());
+
+    auto ptrs_count = detail::read_ptr(it, ptr_size);
+
+    // The dictionary must fit in the archive before it is allocated.
+    auto codes_size = encoded.size() - 1 - ptr_size;
+    if (ptrs_count > codes_size / (ptr_size + 1) ||
+        (codes_size - ptrs_count * (ptr_size + 1)) % ptr_size)
     {
-      bytes.push_back(rev.top());
-      rev.pop();
+      return false;
     }
 
-    return bytes;
+    auto entries_count = ASCII_TABLE_SIZE + ptrs_count;
+
+    utils::stats::PhaseTimer timer{"lzw.decode.dictionary"};
+    std::vector<Dictionary::Node> entries(entries_count);
+
+    for (std::size_t i = ASCII_TABLE_SIZE; i < entries_count; i++)
+    {
+      auto parent = detail::read_ptr(it, ptr_size);
+      auto symbol = *(it++);
+      if (parent >= i)
+      {
+        return false;
+      }
+
+      entries[i] = Dictionary::Node{static_cast<Dictionary::Index>(parent), symbol};
+      phrases.add(PhraseBuffer::Phrase{PhraseBuffer::npos, phrases.phrase(parent).length + 1});
+    }
+
+    timer.next("lzw.decode.codes");
+    while (it != encoded.end())
+    {
+      auto ptr = detail::read_ptr(it, ptr_size);
+      if (ptr >= entries_count)
+      {
+        return false;
+      }
+
+      if (ptr < ASCII_TABLE_SIZE || phrases.phrase(ptr).offset != PhraseBuffer::npos)
+      {
+        phrases.emit(ptr);
+        continue;
+      }
+
+      /*
+       * First occurrence of the entry: its symbols are written backwards while climbing up to the
+       * closest ancestor that has already been decoded, and every entry on the way is recorded at
+       * this offset since it is a prefix of the current sequence.
+       */
+      auto offset = phrases.size();
+      auto length = phrases.phrase(ptr).length;
+      auto dst = phrases.extend(length);
+      if (!dst)
+      {
+        return true;
+      }
+
+      auto curr = ptr;
+      while (curr >= ASCII_TABLE_SIZE && phrases.phrase(curr).offset == PhraseBuffer::npos)
+      {
+        phrases.phrase(curr).offset = offset;
+        dst[--length] = entries[curr].symbol;
+        curr = entries[curr].parent;
+      }
+
+      if (curr < ASCII_TABLE_SIZE)
+      {
+        dst[0] = std::byte(curr);
+      }
+      else
+      {
+        std::memcpy(dst, phrases.data() + phrases.phrase(curr).offset, length);
+      }
+    }
+
+    return true;
   }
+};
+
+/**
+ * \brief LZW variant whose archives hold the code stream only.
+ *
+ * The dictionary is not serialized: the decoder rebuilds it incrementally, adding one entry per
+ * code read, exactly as the encoder did while emitting it. Since the decoder is always one entry
+ * behind the encoder, it may receive the code of the entry it is about to add (the KwKwK case).
+ *
+ * Codes are bit-packed, and the width of every code grows with the dictionary size that both sides
+ * know at that point: 9, 10, 11... bits up to MaxCodeBits. The padding of the last byte is shorter
+ * than any code, so no end marker is needed.
+ *
+ * The dictionary holds at most 2^MaxCodeBits entries, which bounds the memory of both sides. What
+ * happens once it is full is up to the encoder's \p Policy; the decoder only needs to follow the
+ * CLEAR codes, so the archive header stores MaxCodeBits alone.
+ */
+template <std::uint8_t MaxCodeBits = 20, DictionaryPolicy Policy = DictionaryPolicy::Monitor>
+class BasicImplicitLZW
+{
+  static_assert(MaxCodeBits > 8 && MaxCodeBits < 32, "Codes must fit in 9 to 31 bits.");
+
+  static constexpr std::size_t CLEAR_CODE = LZWEncoder::CLEAR_CODE;
+
+  /**
+   * \brief How many input bytes the Monitor policy encodes between two ratio checks.
+   */
+  static constexpr std::size_t CHECK_GAP = 10000;
 
-  const Node *entry(std::size_t idx) const noexcept
+protected:
+  static constexpr std::size_t RESERVED_CODES = 1;
+  static constexpr std::size_t MAX_CODE_BITS = MaxCodeBits;
+
+  /**
+   * \brief The largest archive of \p raw_size bytes: at most one code per input byte, plus the
+   * CLEAR codes, each on MaxCodeBits at most.
+   */
+  static constexpr std::size_t compress_bound(std::size_t raw_size) noexcept
   {
-    return entries_[idx];
+    auto codes_count = raw_size + raw_size / 255 + 2;
+
+    return 1 + (codes_count * MaxCodeBits + 7) / 8;
   }
 
-  std::size_t size() const noexcept
+  static utils::bytes::ByteSequence encode(utils::bytes::ByteView raw)
   {
-    return size_;
-  }
+    utils::bytes::ByteSequence encoded;
+    encoded.reserve(raw.size() / 2);
+    encode_into(raw, encoded);
 
-private:
-  std::unique_ptr<Node> root_ = std::make_unique<Node>(nullptr, 0, std::byte{0});
-  std::vector<Node *> entries_;
-  std::size_t size_{0};
-};
+    return encoded;
+  }
 
-class LZW
-{
-protected:
-  static utils::bytes::ByteSequence encode(const utils::bytes::ByteSequence &raw)
+  /**
+   * \brief Encode straight into \p output. Only the dictionary is allocated.
+   */
+  static std::optional<std::size_t> encode(
+      utils::bytes::ByteView raw, utils::bytes::MutableByteView output)
   {
-    Dictionary dict;
-    utils::bytes::ByteSequence temp;
+    utils::bytes::FixedBuffer buffer{output};
+    encode_into(raw, buffer);
 
-    std::vector<std::size_t> dict_ptrs;
-    dict_ptrs.reserve(raw.size());
+    if (buffer.overflowed())
+    {
+      return std::nullopt;
+    }
 
-    int pos_count = 0;
+    return buffer.size();
+  }
 
-    Dictionary::Node *curr_node = nullptr;
+  /**
+   * \returns The decompressed data, or nothing if the archive is malformed.
+   */
+  static utils::bytes::ByteSequence decode(utils::bytes::ByteView encoded)
+  {
+    PhraseBuffer phrases{RESERVED_CODES, encoded.size() * 3};
+    if (!decode_into(encoded, phrases))
+    {
+      return {};
+    }
 
-    for (std::size_t i = 0; i != raw.size(); i++)
+    return phrases.release();
+  }
+
+  static std::optional<std::size_t> decode(
+      utils::bytes::ByteView encoded, utils::bytes::MutableByteView output)
+  {
+    PhraseBuffer phrases{RESERVED_CODES, output};
+    if (!decode_into(encoded, phrases) || phrases.overflowed())
     {
-      std::byte x = raw[i];
-      if (!curr_node)
-      {
-        curr_node = dict.find_node(temp);
-      }
+      return std::nullopt;
+    }
 
-      utils::bytes::ByteSequence next_seq{seq::emplace_back_copy(temp, x)};
+    return phrases.size();
+  }
 
-      if (!curr_node->child_at(x))  // We don't have the entry Ix in dictionary
-      {
-        dict.put_sequence(next_seq);
-        auto p = *dict.find(temp);
+  /**
+   * \brief Encode \p raw into its code stream, calling emit_code(code, limit) with every code.
+   *
+   * The limit is the dictionary size when the code is emitted, which the decoder knows as well when
+   * it reads the code: the code is below it, and the archives store it on count_bits(limit - 1)
+   * bits.
+   */
+  template <class CodeSink>
+  static void encode_codes(utils::bytes::ByteView raw, CodeSink &&emit_code)
+  {
+    Dictionary dict{RESERVED_CODES};
+    LZWEncoder encoder{dict, std::size_t{1} << MaxCodeBits, Policy};
 
-        dict_ptrs.push_back(p);
+    std::size_t bits_out = 0;
+    [[maybe_unused]] std::size_t codes_count = 0;
 
-        temp.clear();
-        temp.emplace_back(x);
-        curr_node = nullptr;
+    auto emit = [&emit_code, &dict, &bits_out, &codes_count](std::size_t code) {
+      emit_code(code, dict.size());
+      bits_out += utils::bytes::count_bits(dict.size() - 1);
 
-        continue;
+      if constexpr (utils::stats::ENABLED)
+      {
+        codes_count++;
       }
+    };
 
-      temp.push_back(x);
-      curr_node = curr_node->child_at(x);
-    }
+    utils::stats::PhaseTimer timer{"implicit_lzw.encode"};
 
-    /*
-     * After the EOF condition is met, we need to make sure to create and emit the dictionary
-     * pointer of the last sequence.
-     */
-    auto temp_ptr = dict.find(temp);
-    if (!temp_ptr.has_value())
+    if constexpr (Policy != DictionaryPolicy::Monitor)
+    {
+      encoder.feed(raw.begin(), raw.end(), emit);
+    }
+    else
     {
-      temp_ptr = dict.put_sequence(temp);
+      /*
+       * Like compress(1), the ratio since the last reset is checked every CHECK_GAP input bytes
+       * once the dictionary is full, and the dictionary is reset as soon as it drops.
+       */
+      std::size_t bits_in = 0;
+      std::size_t best_ratio = 0;
+
+      for (std::size_t i = 0; i < raw.size(); i += CHECK_GAP)
+      {
+        auto last = std::min(i + CHECK_GAP, raw.size());
+        encoder.feed(std::next(raw.begin(), i), std::next(raw.begin(), last), emit);
+        bits_in += (last - i) * 8;
+
+        if (!encoder.full())
+        {
+          continue;
+        }
+
+        auto ratio = (bits_in << 8) / std::max<std::size_t>(bits_out, 1);
+        if (ratio >= best_ratio)
+        {
+          best_ratio = ratio;
+        }
+        else
+        {
+          encoder.clear();
+          bits_in = bits_out = best_ratio = 0;
+
+          utils::stats::add("implicit_lzw.resets", 1);
+        }
+      }
     }
 
-    dict_ptrs.push_back(*temp_ptr);
+    encoder.flush(emit);
+
+    detail::record_encoder_stats("implicit_lzw", raw.size(), codes_count, dict);
+  }
+
+  /**
+   * \brief Decode the code stream read by read_code(limit) into \p phrases, up to the first code
+   * it returns nothing for. The limit is the one encode_codes() passed along with the code.
+   * \returns Whether every code read refers to an entry of the dictionary.
+   */
+  template <class CodeSource>
+  static bool decode_codes(CodeSource &&read_code, std::size_t max_size, PhraseBuffer &phrases)
+  {
 
     /*
-     * We need to determine how many bits per dictionary pointer our archive requires. Currently,
-     * this implementation will round this to the next byte. That is, dictionary pointers are not
-     * going to be stored on split bytes.
+     * The previous phrase, as it occurs right before the current one. The entry the decoder owes
+     * the encoder is that occurrence extended with the first byte of the current phrase. It is
+     * empty before the first code and after a CLEAR code, when no entry is owed.
      */
-    auto ptr_bits_count = utils::bytes::count_bits(dict.size());
-    auto ptr_size = std::ceil(ptr_bits_count / 8.);
+    PhraseBuffer::Phrase prev{0, 0};
 
-    utils::bytes::ByteSequence encoded{std::byte{ptr_size}};
-    encoded.reserve(dict_ptrs.size() * sizeof(size_t));
+    while (true)
+    {
+      /*
+       * The decoder adds the entry of the previous code only after reading the current one, so
+       * the encoder's dictionary was one entry larger when it emitted this code, unless full.
+       */
+      auto grows = prev.length && phrases.entries() < max_size;
+      auto next = read_code(phrases.entries() + grows);
+      if (!next)
+      {
+        break;
+      }
 
-    auto encoded_ptrs_count = utils::bytes::to_bytes(dict.size() - ASCII_TABLE_SIZE);
-    std::copy_n(std::make_move_iterator(encoded_ptrs_count.cbegin()), ptr_size,
-        std::back_inserter(encoded));
+      auto code = *next;
+      if (code == CLEAR_CODE)
+      {
+        phrases.reset();
+        prev = PhraseBuffer::Phrase{0, 0};
 
-    for (std::size_t i = ASCII_TABLE_SIZE; i < dict.size(); i++)
-    {
-      auto node = dict.entry(i);
-      auto encoded_parent_ptr = utils::bytes::to_bytes(node->parent->index);
+        continue;
+      }
 
-      std::copy_n(std::make_move_iterator(encoded_parent_ptr.cbegin()), ptr_size,
-          std::back_inserter(encoded));
-      encoded.push_back(node->symbol);
-    }
+      /*
+       * The new entry ends with the first byte of the current phrase, which is right after the
+       * previous one in the output. In the KwKwK case the current phrase is that very entry, and
+       * the copy produces its last byte before reading it.
+       */
+      if (grows)
+      {
+        phrases.add(PhraseBuffer::Phrase{prev.offset, prev.length + 1});
+      }
 
-    for (auto p : dict_ptrs)
-    {
-      auto encoded_ptr = utils::bytes::to_bytes(p);
-      std::copy_n(
-          std::make_move_iterator(encoded_ptr.cbegin()), ptr_size, std::back_inserter(encoded));
+      if (code >= phrases.entries())
+      {
+        return false;
+      }
+
+      auto offset = phrases.size();
+      phrases.emit(code);
+      if (phrases.overflowed())
+      {
+        return true;
+      }
+
+      prev = PhraseBuffer::Phrase{offset, phrases.size() - offset};
     }
 
-    return encoded;
+    return true;
   }
 
-  static utils::bytes::ByteSequence decode(const utils::bytes::ByteSequence &encoded)
+private:
+  template <class Output>
+  static void encode_into(utils::bytes::ByteView raw, Output &encoded)
   {
-    auto ptr_size = std::to_integer<std::size_t>(encoded.front());
+    encoded.push_back(std::byte{MaxCodeBits});
 
-    auto it = std::next(encoded.begin());
+    utils::unaligned_storage::BitWriter write_bits{encoded};
+    encode_codes(raw, [&write_bits](std::size_t code, std::size_t limit) {
+      write_bits(code, utils::bytes::count_bits(limit - 1));
+    });
 
-    std::vector<std::byte> b(it, std::next(it, ptr_size));
-    auto ptrs_count = utils::bytes::from_bytes<std::size_t>(std::move(b));
-    std::advance(it, ptr_size);
+    write_bits.flush();
+  }
 
-    Dictionary dict;
+  static bool decode_into(utils::bytes::ByteView encoded, PhraseBuffer &phrases)
+  {
+    if (encoded.empty())
+    {
+      return false;
+    }
 
-    for (std::size_t i = 0; i < ptrs_count; i++)
+    // Only the code widths of the encoders are valid, whatever the decoder's own width.
+    auto max_code_bits = std::to_integer<std::size_t>(encoded[0]);
+    if (max_code_bits < 9 || max_code_bits > 31)
     {
-      std::vector<std::byte> encoded_parent_ptr(it, std::next(it, ptr_size));
-      std::advance(it, ptr_size);
+      return false;
+    }
 
-      auto parent_ptr = utils::bytes::from_bytes<std::size_t>(std::move(encoded_parent_ptr));
-      auto symbol = *(it++);
+    auto max_size = std::size_t{1} << max_code_bits;
+    utils::stats::PhaseTimer timer{"implicit_lzw.decode"};
 
-      dict.put_symbol(parent_ptr, symbol);
-    }
+    utils::unaligned_storage::BitReader reader{encoded.data() + 1, encoded.data() + encoded.size()};
+    auto bits_left = (encoded.size() - 1) * 8;
+    bool well_formed = true;
 
-    utils::bytes::ByteSequence decompressed;
+    auto read_code = [&reader, &bits_left, &well_formed](
+                         std::size_t limit) -> std::optional<std::size_t> {
+      auto code_bits = utils::bytes::count_bits(limit - 1);
+      if (code_bits > bits_left)
+      {
+        return std::nullopt;
+      }
 
-    while (it != encoded.end())
-    {
-      std::vector<std::byte> encoded_ptr(it, std::next(it, ptr_size));
-      std::advance(it, ptr_size);
+      bits_left -= code_bits;
+      auto code = reader.read(code_bits);
 
-      auto ptr = utils::bytes::from_bytes<std::size_t>(std::move(encoded_ptr));
-      auto seq = dict[ptr];
+      // Codes of count_bits(limit - 1) bits may still be past the limit in a malformed archive.
+      if (code >= limit)
+      {
+        well_formed = false;
+        return std::nullopt;
+      }
 
-      std::copy(std::make_move_iterator(seq.cbegin()), std::make_move_iterator(seq.cend()),
-          std::back_inserter(decompressed));
-    }
+      return code;
+    };
 
-    return decompressed;
+    return decode_codes(read_code, max_size, phrases) && well_formed;
   }
 };
 
+using ImplicitLZW = BasicImplicitLZW<>;
+
 }  // namespace compression
@@ -0,0 +1,363 @@
+#pragma once
+
+#include "compression/compressor.h"
+#include "utils/bytes.h"
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace compression
+{
+
+/**
+ * \brief Receives the output of the stream encoders and decoders, chunk by chunk. The chunk is only
+ * valid during the call.
+ */
+using Sink = std::function<void(utils::bytes::ByteView)>;
+
+namespace detail
+{
+
+/**
+ * \brief Every frame starts with the size of its archive, on FRAME_HEADER_SIZE bytes.
+ */
+static constexpr std::size_t FRAME_HEADER_SIZE = 4;
+
+/**
+ * \brief Cuts the input into blocks of block_size bytes, and compresses each of them with \p Algo
+ * into a frame, behind a frame header of header_size bytes left to the caller.
+ *
+ * Without a thread pool, a block is compressed as soon as it is complete. With one, the blocks are
+ * gathered in batches of twice as many blocks as threads and compressed side by side. Either way,
+ * the frames are handed over in input order, so the output does not depend on the pool.
+ */
+template <class Algo>
+class BlockBatcher : protected Algo
+{
+public:
+  BlockBatcher(std::size_t block_size, std::size_t header_size,
+      utils::thread_pool::ThreadPool *pool) :
+      block_size_{block_size},
+      header_size_{header_size},
+      pool_{pool},
+      frames_(pool ? 2 * (pool->size() + 1) : 1),
+      archive_sizes_(frames_.size())
+  {}
+
+  /**
+   * \brief Compress the blocks completed by \p input.
+   * \param finish Called as finish(block, frame, archive_size) right after the block is compressed,
+   * on the same thread, to write the frame header.
+   * \param emit Called as emit(frame) on the calling thread, in input order.
+   */
+  template <class Finish, class Emit>
+  void feed(utils::bytes::ByteView input, Finish &&finish, Emit &&emit)
+  {
+    auto batch_size = frames_.size() * block_size_;
+
+    while (!input.empty())
+    {
+      // Whole blocks are compressed straight from the input.
+      if (pending_.empty() && input.size() >= block_size_)
+      {
+        auto size = std::min(batch_size, input.size() / block_size_ * block_size_);
+        compress(input.first(size), finish, emit);
+        input = input.subspan(size);
+        continue;
+      }
+
+      auto count = std::min(batch_size - pending_.size(), input.size());
+      pending_.insert(pending_.end(), input.begin(), input.begin() + count);
+      input = input.subspan(count);
+
+      if (pending_.size() == batch_size)
+      {
+        compress(pending_, finish, emit);
+        pending_.clear();
+      }
+    }
+  }
+
+  /**
+   * \brief Compress the pending blocks, the last one possibly partial.
+   */
+  template <class Finish, class Emit>
+  void flush(Finish &&finish, Emit &&emit)
+  {
+    if (!pending_.empty())
+    {
+      compress(pending_, finish, emit);
+      pending_.clear();
+    }
+  }
+
+private:
+  /**
+   * \brief Compress the blocks of \p data, at most one per frame buffer, then emit them in order.
+   */
+  template <class Finish, class Emit>
+  void compress(utils::bytes::ByteView data, Finish &finish, Emit &emit)
+  {
+    auto count = (data.size() + block_size_ - 1) / block_size_;
+
+    auto compress_block = [this, data, &finish](std::size_t i) {
+      auto offset = i * block_size_;
+      auto block = data.subspan(offset, std::min(block_size_, data.size() - offset));
+
+      auto &frame = frames_[i];
+      frame.resize(header_size_ + Algo::compress_bound(block_size_));
+
+      utils::bytes::MutableByteView frame_view{frame};
+      archive_sizes_[i] = *Algo::encode(block, frame_view.subspan(header_size_));
+      finish(block, frame_view, archive_sizes_[i]);
+    };
+
+    if (pool_ && count > 1)
+    {
+      utils::thread_pool::parallel_for(*pool_, count, compress_block);
+    }
+    else
+    {
+      for (std::size_t i = 0; i < count; i++)
+      {
+        compress_block(i);
+      }
+    }
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+      utils::bytes::MutableByteView frame{frames_[i]};
+      emit(frame.first(header_size_ + archive_sizes_[i]));
+    }
+  }
+
+  std::size_t block_size_;
+  std::size_t header_size_;
+  utils::thread_pool::ThreadPool *pool_;
+  utils::bytes::ByteSequence pending_;
+  std::vector<utils::bytes::ByteSequence> frames_;
+  std::vector<std::size_t> archive_sizes_;
+};
+
+}  // namespace detail
+
+/**
+ * \brief Incremental compression with \p Algo, holding at most one batch of blocks at a time.
+ *
+ * The input is cut into blocks of \p BlockSize bytes, each compressed into a frame as soon as it is
+ * complete. Given a thread pool, the blocks are rather compressed a batch at a time, side by side.
+ * Output starts flowing after the first block or batch, in input order, and memory does not depend
+ * on the length of the input.
+ *
+ * Stream structure:
+ *  - frames: the size of the archive on 4 bytes, then the archive of one block.
+ *  - end of stream: a frame of size 0.
+ */
+template <class Algo, std::size_t BlockSize = 256 * 1024>
+class StreamEncoder
+{
+  static_assert(BlockSize > 0, "Blocks must not be empty.");
+  static_assert(Compressor<Algo>::compress_bound(BlockSize) <= UINT32_MAX,
+      "The archive of a block must fit in the frame header.");
+
+public:
+  explicit StreamEncoder(Sink sink) : StreamEncoder(std::move(sink), nullptr)
+  {}
+
+  StreamEncoder(Sink sink, utils::thread_pool::ThreadPool &pool) :
+      StreamEncoder(std::move(sink), &pool)
+  {}
+
+  /**
+   * \brief Compress \p input, emitting the frames of the blocks it completes.
+   */
+  void feed(utils::bytes::ByteView input)
+  {
+    blocks_.feed(input, write_frame_header, sink_);
+  }
+
+  /**
+   * \brief Compress the last, partial block, and end the stream.
+   */
+  void flush()
+  {
+    blocks_.flush(write_frame_header, sink_);
+
+    auto bytes = utils::bytes::to_bytes(std::uint32_t{0});
+    sink_(utils::bytes::ByteView{bytes.data(), detail::FRAME_HEADER_SIZE});
+  }
+
+private:
+  StreamEncoder(Sink sink, utils::thread_pool::ThreadPool *pool) :
+      sink_{std::move(sink)},
+      blocks_{BlockSize, detail::FRAME_HEADER_SIZE, pool}
+  {}
+
+  static void write_frame_header(
+      utils::bytes::ByteView, utils::bytes::MutableByteView frame, std::size_t archive_size)
+  {
+    auto bytes = utils::bytes::to_bytes(static_cast<std::uint32_t>(archive_size));
+    std::copy_n(bytes.begin(), detail::FRAME_HEADER_SIZE, frame.begin());
+  }
+
+  Sink sink_;
+  detail::BlockBatcher<Algo> blocks_;
+};
+
+/**
+ * \brief Incremental decompression of the streams written by StreamEncoder<Algo> with blocks of at
+ * most \p BlockSize bytes.
+ *
+ * A frame is decompressed as soon as all its bytes have been fed, so the decoder holds at most one
+ * frame and its decompressed block at a time. Given a thread pool, the complete frames are rather
+ * gathered in batches of twice as many frames as threads, decompressed side by side, and emitted in
+ * order. Input past the end of the stream is ignored.
+ *
+ * Frames larger than the archive of a whole block are rejected before being buffered, so memory
+ * stays bounded by the block size whatever the input. Decoding stops at the first malformed frame.
+ */
+template <class Algo, std::size_t BlockSize = 256 * 1024>
+class StreamDecoder : protected Algo
+{
+  static_assert(BlockSize > 0, "Blocks must not be empty.");
+  static_assert(Compressor<Algo>::compress_bound(BlockSize) <= UINT32_MAX,
+      "The archive of a block must fit in the frame header.");
+
+public:
+  explicit StreamDecoder(Sink sink) : StreamDecoder(std::move(sink), nullptr)
+  {}
+
+  StreamDecoder(Sink sink, utils::thread_pool::ThreadPool &pool) :
+      StreamDecoder(std::move(sink), &pool)
+  {}
+
+  /**
+   * \brief Consume \p input, emitting the blocks of the frames it completes.
+   */
+  void feed(utils::bytes::ByteView input)
+  {
+    while (!input.empty() && !ended_ && !failed_)
+    {
+      if (header_size_ < detail::FRAME_HEADER_SIZE)
+      {
+        auto count = std::min(detail::FRAME_HEADER_SIZE - header_size_, input.size());
+        std::copy_n(input.begin(), count, header_.begin() + header_size_);
+        header_size_ += count;
+        input = input.subspan(count);
+
+        if (header_size_ == detail::FRAME_HEADER_SIZE)
+        {
+          archive_size_ = utils::bytes::from_bytes<std::uint32_t>(header_);
+          if (archive_size_ > Algo::compress_bound(BlockSize))
+          {
+            failed_ = true;
+            break;
+          }
+
+          ended_ = archive_size_ == 0;
+          archives_[archives_count_].reserve(archive_size_);
+
+          if (ended_)
+          {
+            decode_archives();
+          }
+        }
+
+        continue;
+      }
+
+      auto &archive = archives_[archives_count_];
+      auto count = std::min(archive_size_ - archive.size(), input.size());
+      archive.insert(archive.end(), input.begin(), input.begin() + count);
+      input = input.subspan(count);
+
+      if (archive.size() == archive_size_)
+      {
+        header_size_ = 0;
+
+        if (++archives_count_ == archives_.size())
+        {
+          decode_archives();
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief End the input, emitting the blocks of the frames still pending.
+   * \returns Whether the input held a whole, well-formed stream, up to its end.
+   */
+  bool flush()
+  {
+    decode_archives();
+    return ended_ && !failed_;
+  }
+
+private:
+  StreamDecoder(Sink sink, utils::thread_pool::ThreadPool *pool) :
+      sink_{std::move(sink)},
+      pool_{pool},
+      archives_(pool ? 2 * (pool->size() + 1) : 1),
+      blocks_(archives_.size()),
+      block_sizes_(archives_.size())
+  {}
+
+  /**
+   * \brief Decompress the complete frames gathered so far, and emit their blocks in order, up to
+   * the first one that does not decode.
+   */
+  void decode_archives()
+  {
+    auto decode_archive = [this](std::size_t i) {
+      blocks_[i].resize(BlockSize);
+      block_sizes_[i] = Algo::decode(archives_[i], blocks_[i]);
+      archives_[i].clear();
+    };
+
+    if (pool_ && archives_count_ > 1)
+    {
+      utils::thread_pool::parallel_for(*pool_, archives_count_, decode_archive);
+    }
+    else
+    {
+      for (std::size_t i = 0; i < archives_count_; i++)
+      {
+        decode_archive(i);
+      }
+    }
+
+    for (std::size_t i = 0; i < archives_count_ && !failed_; i++)
+    {
+      if (!block_sizes_[i])
+      {
+        failed_ = true;
+        break;
+      }
+
+      sink_(utils::bytes::ByteView{blocks_[i].data(), *block_sizes_[i]});
+    }
+
+    archives_count_ = 0;
+  }
+
+  Sink sink_;
+  utils::thread_pool::ThreadPool *pool_;
+  std::array<std::byte, detail::FRAME_HEADER_SIZE> header_;
+  std::size_t header_size_ = 0;
+  std::size_t archive_size_ = 0;
+  std::vector<utils::bytes::ByteSequence> archives_;
+  std::vector<utils::bytes::ByteSequence> blocks_;
+  std::vector<std::optional<std::size_t>> block_sizes_;
+  std::size_t archives_count_ = 0;
+  bool ended_ = false;
+  bool failed_ = false;
+};
+
+}  // namespace compression
@@ -1,13 +1,31 @@
 #pragma once
 
+#include "compression/adaptive.h"
+#include "compression/ans.h"
+#include "compression/blocked.h"
+#include "compression/chain.h"
 #include "compression/compressor.h"
 #include "compression/huffman.h"
 #include "compression/lzw.h"
+#include "compression/stream.h"
 
 namespace compression::variants
 {
 
 using LZWCompressor = compression::Compressor<compression::LZW>;
+using ImplicitLZWCompressor = compression::Compressor<compression::ImplicitLZW>;
 using HuffmanCoding = compression::Compressor<compression::Huffman>;
+using ANSCoding = compression::Compressor<compression::ANS>;
+using BlockedHuffmanCoding = compression::Compressor<compression::Blocked<compression::Huffman>>;
+using BlockedImplicitLZWCompressor =
+    compression::Compressor<compression::Blocked<compression::ImplicitLZW>>;
+using LZWHuffmanCompressor =
+    compression::Compressor<compression::Chain<compression::ImplicitLZW, compression::Huffman>>;
+using AdaptiveCompressor = compression::Compressor<compression::Adaptive>;
+
+using LZWStreamEncoder = compression::StreamEncoder<compression::LZW>;
+using LZWStreamDecoder = compression::StreamDecoder<compression::LZW>;
+using HuffmanStreamEncoder = compression::StreamEncoder<compression::Huffman>;
+using HuffmanStreamDecoder = compression::StreamDecoder<compression::Huffman>;
 
 }  // namespace compression::variants
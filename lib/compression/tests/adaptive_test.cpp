@@ -0,0 +1,134 @@
+#include "compression/adaptive.h"
+#include "compression/compressor.h"
+#include "lib/compression/tests/caller_owned_buffers.h"
+#include "utils/bytes.h"
+
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string>
+
+namespace compression
+{
+
+namespace
+{
+
+utils::bytes::ByteSequence random_bytes(std::size_t size, int max, unsigned seed)
+{
+  std::mt19937 gen{seed};
+  std::uniform_int_distribution<int> dist(0, max);
+
+  utils::bytes::ByteSequence raw(size);
+  for (auto &b : raw)
+  {
+    b = std::byte(dist(gen));
+  }
+
+  return raw;
+}
+
+utils::bytes::ByteSequence log_lines(std::size_t count)
+{
+  std::mt19937 gen{3};
+  std::uniform_int_distribution<int> path(0, 40);
+
+  std::string text;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    text += "{\"level\": \"info\", \"path\": \"/api/v1/items/" + std::to_string(path(gen)) +
+        "\", \"ms\": " + std::to_string(i * 37 % 500) + "}\n";
+  }
+
+  return utils::bytes::to_byte_array(text);
+}
+
+AdaptiveMethod method_of(const utils::bytes::ByteSequence &archive)
+{
+  return AdaptiveMethod(std::to_integer<std::uint8_t>(archive.at(0)));
+}
+
+}  // namespace
+
+using Coding = Compressor<Adaptive>;
+
+TEST(Adaptive, Strings)
+{
+  std::string inputs[]{"", "a", "aaaaaaaaaaaaaaaa", "TOBEORNOTTOBEORTOBEORNOT",
+      "the quick brown fox jumps over the lazy dog"};
+
+  for (auto it = std::begin(inputs); it != std::end(inputs); it++)
+  {
+    SCOPED_TRACE(*it);
+
+    auto raw = utils::bytes::to_byte_array(*it);
+    auto archive = Coding::compress(raw);
+
+    EXPECT_LE(archive.size(), raw.size() + 1);
+    EXPECT_EQ(Coding::decompress(archive), raw);
+  }
+}
+
+TEST(Adaptive, ChoosesPerData)
+{
+  auto logs = log_lines(5000);
+  auto logs_archive = Coding::compress(logs);
+  EXPECT_EQ(method_of(logs_archive), AdaptiveMethod::Repetitive);
+  EXPECT_EQ(Coding::decompress(logs_archive), logs);
+
+  // Uniform bytes within a small alphabet barely repeat, but take 4 bits each.
+  auto nibbles = random_bytes(100000, 15, 1);
+  auto nibbles_archive = Coding::compress(nibbles);
+  EXPECT_EQ(method_of(nibbles_archive), AdaptiveMethod::Skewed);
+  EXPECT_EQ(Coding::decompress(nibbles_archive), nibbles);
+
+  auto noise = random_bytes(100000, 255, 2);
+  auto noise_archive = Coding::compress(noise);
+  EXPECT_EQ(method_of(noise_archive), AdaptiveMethod::Stored);
+  EXPECT_EQ(noise_archive.size(), noise.size() + 1);
+  EXPECT_EQ(Coding::decompress(noise_archive), noise);
+}
+
+TEST(Adaptive, CallerOwnedBuffers)
+{
+  for (int max : {15, 255})
+  {
+    for (std::size_t size : {0, 1, 2, 300, 20000})
+    {
+      SCOPED_TRACE(size);
+
+      check_caller_owned_buffers<Adaptive>(random_bytes(size, max, 5));
+    }
+  }
+}
+
+TEST(Adaptive, UndersizedOutput)
+{
+  for (int max : {15, 255})
+  {
+    SCOPED_TRACE(max);
+
+    auto raw = random_bytes(4000, max, 6);
+    utils::bytes::ByteSequence archive(16);
+    EXPECT_FALSE(Coding::compress(raw, archive));
+  }
+
+  auto logs = log_lines(200);
+  utils::bytes::ByteSequence archive(logs.size() / 20);
+  EXPECT_FALSE(Coding::compress(logs, archive));
+}
+
+TEST(Adaptive, Malformed)
+{
+  utils::bytes::ByteSequence decoded(16);
+
+  EXPECT_FALSE(Coding::decompress(utils::bytes::ByteView{}, decoded));
+
+  utils::bytes::ByteSequence unknown_method{std::byte{7}, std::byte{'a'}};
+  EXPECT_FALSE(Coding::decompress(unknown_method, decoded));
+  EXPECT_TRUE(Coding::decompress(unknown_method).empty());
+}
+
+}  // namespace compression
@@ -0,0 +1,157 @@
+#include "compression/ans.h"
+#include "compression/compressor.h"
+#include "compression/huffman.h"
+#include "lib/compression/tests/caller_owned_buffers.h"
+#include "utils/bytes.h"
+
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <iterator>
+#include <random>
+#include <string>
+
+namespace compression
+{
+
+namespace
+{
+
+utils::bytes::ByteSequence random_bytes(std::size_t size, int max, unsigned seed)
+{
+  std::mt19937 gen{seed};
+  std::uniform_int_distribution<int> dist(0, max);
+
+  utils::bytes::ByteSequence raw(size);
+  for (auto &b : raw)
+  {
+    b = std::byte(dist(gen));
+  }
+
+  return raw;
+}
+
+/**
+ * \brief Bytes of a geometric distribution, where the likeliest byte takes a fraction of a bit.
+ */
+utils::bytes::ByteSequence skewed_bytes(std::size_t size, unsigned seed)
+{
+  std::mt19937 gen{seed};
+  std::geometric_distribution<int> dist(0.7);
+
+  utils::bytes::ByteSequence raw(size);
+  for (auto &b : raw)
+  {
+    b = std::byte('a' + dist(gen) % 26);
+  }
+
+  return raw;
+}
+
+}  // namespace
+
+template <class Algo>
+class ANSRoundTrip : public ::testing::Test
+{};
+
+using ANSVariants = ::testing::Types<ANS, BasicANS<9, 1>, BasicANS<12, 2>, BasicANS<10, 8>>;
+TYPED_TEST_SUITE(ANSRoundTrip, ANSVariants);
+
+TYPED_TEST(ANSRoundTrip, Strings)
+{
+  using Coding = Compressor<TypeParam>;
+
+  std::string inputs[]{"", "a", "ab", "aaaaaaaaaaaaaaaa", "TOBEORNOTTOBEORTOBEORNOT",
+      "the quick brown fox jumps over the lazy dog"};
+
+  for (auto it = std::begin(inputs); it != std::end(inputs); it++)
+  {
+    SCOPED_TRACE(*it);
+
+    auto raw = utils::bytes::to_byte_array(*it);
+    EXPECT_EQ(Coding::decompress(Coding::compress(raw)), raw);
+  }
+}
+
+TYPED_TEST(ANSRoundTrip, Random)
+{
+  using Coding = Compressor<TypeParam>;
+
+  // Odd sizes leave segments of different lengths, and a lone byte at their end.
+  for (std::size_t size : {1023, 1024, 100001, 1 << 19})
+  {
+    SCOPED_TRACE(size);
+
+    for (int max : {1, 15, 255})
+    {
+      auto raw = random_bytes(size, max, unsigned(size + max));
+      EXPECT_EQ(Coding::decompress(Coding::compress(raw)), raw);
+    }
+
+    auto skewed = skewed_bytes(size, 4);
+    EXPECT_EQ(Coding::decompress(Coding::compress(skewed)), skewed);
+  }
+}
+
+TYPED_TEST(ANSRoundTrip, CallerOwnedBuffers)
+{
+  for (std::size_t size : {0, 1, 2, 300, 20000})
+  {
+    SCOPED_TRACE(size);
+
+    // Random bytes are the worst case for the archive size.
+    check_caller_owned_buffers<TypeParam>(random_bytes(size, 255, 5));
+  }
+}
+
+TEST(ANS, SmallerThanHuffmanOnSkewedBytes)
+{
+  auto raw = skewed_bytes(1 << 18, 6);
+
+  auto ans = Compressor<ANS>::compress(raw);
+  auto huffman = Compressor<Huffman>::compress(raw);
+
+  EXPECT_LT(ans.size(), huffman.size());
+}
+
+TEST(ANS, Malformed)
+{
+  using Coding = Compressor<ANS>;
+
+  auto raw = skewed_bytes(5000, 7);
+  auto archive = Coding::compress(raw);
+
+  utils::bytes::ByteSequence decoded(raw.size());
+  for (std::size_t size : {0, 1, 3, 20, 40})
+  {
+    SCOPED_TRACE(size);
+
+    EXPECT_FALSE(Coding::decompress(utils::bytes::ByteView{archive.data(), size}, decoded));
+  }
+
+  // Streams cut short, or with a bit flipped, do not end in the state their encoding started from.
+  EXPECT_FALSE(Coding::decompress(
+      utils::bytes::ByteView{archive.data(), archive.size() - 1}, decoded));
+
+  auto flipped = archive;
+  flipped[archive.size() / 2] ^= std::byte{0x10};
+  auto decoded_size = Coding::decompress(flipped, decoded);
+  EXPECT_TRUE(!decoded_size || decoded != raw);
+
+  // A count widened to 7 bytes, far more than the streams of a small archive could hold.
+  auto small_archive = Coding::compress(utils::bytes::to_byte_array(std::string("abcabd")));
+  auto count_size = std::to_integer<std::size_t>(small_archive[0] >> 4);
+  utils::bytes::ByteSequence widened{
+      (small_archive[0] & std::byte{0x0F}) | std::byte{0x70}, small_archive[1]};
+  widened.insert(widened.end(), 7, std::byte{0x7f});
+  widened.insert(widened.end(), small_archive.begin() + std::ptrdiff_t(2 + count_size),
+      small_archive.end());
+  EXPECT_TRUE(Coding::decompress(widened).empty());
+  EXPECT_FALSE(Coding::decompress(widened, decoded));
+
+  // Counts not summing to the table size.
+  auto bad_counts = archive;
+  bad_counts[2 + 2 + 32] ^= std::byte{0x01};
+  EXPECT_FALSE(Coding::decompress(bad_counts, decoded));
+}
+
+}  // namespace compression
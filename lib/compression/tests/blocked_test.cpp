@@ -0,0 +1,156 @@
+#include "compression/blocked.h"
+#include "compression/compressor.h"
+#include "compression/huffman.h"
+#include "compression/lzw.h"
+#include "lib/compression/tests/caller_owned_buffers.h"
+#include "utils/bytes.h"
+#include "utils/stats.h"
+
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <random>
+#include <string>
+
+namespace compression
+{
+
+namespace
+{
+
+utils::bytes::ByteSequence skewed_bytes(std::size_t size, std::uint32_t seed, double skew = 0.08)
+{
+  std::mt19937 gen{seed};
+  std::geometric_distribution<int> dist(skew);
+
+  utils::bytes::ByteSequence raw(size);
+  for (auto &b : raw)
+  {
+    b = std::byte(std::min(dist(gen), 255));
+  }
+
+  return raw;
+}
+
+}  // namespace
+
+TEST(Blocked, RoundTrip)
+{
+  using SmallBlocks = Compressor<Blocked<Huffman, 1000>>;
+
+  for (std::size_t size : {0, 1, 999, 1000, 1001, 5000, 123456})
+  {
+    SCOPED_TRACE(size);
+
+    auto raw = skewed_bytes(size, size);
+    EXPECT_EQ(SmallBlocks::decompress(SmallBlocks::compress(raw)), raw);
+  }
+}
+
+TEST(Blocked, CallerOwnedBuffers)
+{
+  for (std::size_t size : {0, 1, 1000, 5000})
+  {
+    SCOPED_TRACE(size);
+
+    check_caller_owned_buffers<Blocked<Huffman, 1000>>(skewed_bytes(size, size, 0.5));
+  }
+}
+
+TEST(Blocked, OtherAlgorithm)
+{
+  using BlockedLZW = Compressor<Blocked<ImplicitLZW, 4096>>;
+
+  auto raw = utils::bytes::to_byte_array(std::string(20000, 'x') + "TOBEORNOTTOBEORTOBEORNOT");
+  EXPECT_EQ(BlockedLZW::decompress(BlockedLZW::compress(raw)), raw);
+}
+
+TEST(Blocked, Malformed)
+{
+  using SmallBlocks = Compressor<Blocked<Huffman, 1000>>;
+
+  auto raw = skewed_bytes(2000, 3);
+  auto archive = SmallBlocks::compress(raw);
+
+  // Header with 8-byte counters, to rewrite the sizes of the two blocks.
+  auto put = [](utils::bytes::ByteSequence &out, std::size_t value) {
+    auto bytes = utils::bytes::to_bytes(value);
+    out.insert(out.end(), bytes.begin(), bytes.end());
+  };
+
+  auto counter_size = std::to_integer<std::size_t>(archive[0]);
+  auto header_size = 1 + 4 * counter_size;
+  auto archives_size = archive.size() - header_size;
+
+  // Sizes adding up to the right total once wrapped around.
+  utils::bytes::ByteSequence wrapped{std::byte{8}};
+  put(wrapped, raw.size());
+  put(wrapped, 1000);
+  put(wrapped, std::size_t(-2));
+  put(wrapped, archives_size + 2);
+  wrapped.insert(wrapped.end(), archive.begin() + std::ptrdiff_t(header_size), archive.end());
+
+  utils::bytes::ByteSequence decoded(raw.size());
+  EXPECT_FALSE(SmallBlocks::decompress(wrapped, decoded));
+  EXPECT_TRUE(SmallBlocks::decompress(wrapped).empty());
+
+  // An input size no block count in the archive could reach.
+  utils::bytes::ByteSequence oversized{std::byte{8}};
+  put(oversized, 0x7f7f7f7f7f7f7f7f);
+  put(oversized, 0x7f7f7f7f7f7f7f7f);
+  EXPECT_TRUE(SmallBlocks::decompress(oversized).empty());
+
+  utils::bytes::ByteSequence many_blocks{std::byte{8}};
+  put(many_blocks, 0x7f7f7f7f7f7f7f7f);
+  put(many_blocks, 1000);
+  put(many_blocks, archives_size);
+  EXPECT_TRUE(SmallBlocks::decompress(many_blocks).empty());
+
+  for (std::size_t size : {std::size_t{0}, std::size_t{1}, header_size, archive.size() - 1})
+  {
+    SCOPED_TRACE(size);
+
+    utils::bytes::ByteSequence truncated(archive.begin(), archive.begin() + std::ptrdiff_t(size));
+    EXPECT_FALSE(SmallBlocks::decompress(truncated, decoded));
+    EXPECT_TRUE(SmallBlocks::decompress(truncated).empty());
+  }
+}
+
+TEST(Blocked, ForgedBlockSize)
+{
+  using BlockedHuffman = Compressor<Blocked<Huffman>>;
+
+  // 4-byte counters claiming a single block of MAX_BLOCK_SIZE bytes, followed by a 5-byte one.
+  auto block = Compressor<Huffman>::compress(utils::bytes::to_byte_array(std::string{"hello"}));
+
+  utils::bytes::ByteSequence forged{std::byte{4}};
+  auto max_block_size = Blocked<Huffman>::MAX_BLOCK_SIZE;
+  for (std::size_t counter : {max_block_size, max_block_size, block.size()})
+  {
+    auto bytes = utils::bytes::to_bytes(counter);
+    forged.insert(forged.end(), bytes.begin(), bytes.begin() + 4);
+  }
+
+  forged.insert(forged.end(), block.begin(), block.end());
+
+  auto before = utils::stats::allocated_bytes.load();
+  EXPECT_TRUE(BlockedHuffman::decompress(forged).empty());
+  EXPECT_LT(utils::stats::allocated_bytes - before, 1u << 20);
+}
+
+TEST(Blocked, AdaptsToChangingStatistics)
+{
+  // Two halves using disjoint symbols: one table for both wastes a bit on every code.
+  auto raw = skewed_bytes(1 << 18, 1, 0.3);
+  auto second_half = skewed_bytes(1 << 18, 2, 0.3);
+  for (auto b : second_half)
+  {
+    raw.push_back(std::byte(255 - std::to_integer<int>(b)));
+  }
+
+  auto single = Compressor<Huffman>::compress(raw).size();
+  auto blocked = Compressor<Blocked<Huffman, 1 << 18>>::compress(raw).size();
+
+  EXPECT_LT(blocked, single);
+}
+
+}  // namespace compression
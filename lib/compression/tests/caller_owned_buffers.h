@@ -0,0 +1,40 @@
+#pragma once
+
+#include "compression/compressor.h"
+#include "utils/bytes.h"
+
+#include "gtest/gtest.h"
+
+namespace compression
+{
+
+/**
+ * \brief Compress \p raw into a buffer of compress_bound() bytes and decompress it back into one of
+ * its size, both matching the allocating calls, then check that buffers one byte too small are
+ * rejected.
+ */
+template <class Algo>
+void check_caller_owned_buffers(const utils::bytes::ByteSequence &raw)
+{
+  using Coding = Compressor<Algo>;
+
+  utils::bytes::ByteSequence archive(Coding::compress_bound(raw.size()));
+  auto archive_size = Coding::compress(raw, archive);
+  ASSERT_TRUE(archive_size);
+  EXPECT_EQ(*archive_size, Coding::compress(raw).size());
+
+  archive.resize(*archive_size);
+  utils::bytes::ByteSequence decoded(raw.size());
+  EXPECT_EQ(Coding::decompress(archive, decoded), raw.size());
+  EXPECT_EQ(decoded, raw);
+
+  if (!raw.empty())
+  {
+    utils::bytes::ByteSequence small(raw.size() - 1);
+    EXPECT_FALSE(Coding::decompress(archive, small));
+    EXPECT_FALSE(Coding::compress(raw, utils::bytes::MutableByteView{archive}.first(
+                                           *archive_size - 1)));
+  }
+}
+
+}  // namespace compression
@@ -0,0 +1,182 @@
+#include "compression/chain.h"
+#include "compression/compressor.h"
+#include "compression/huffman.h"
+#include "compression/lzw.h"
+#include "lib/compression/tests/caller_owned_buffers.h"
+#include "utils/bytes.h"
+
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <iterator>
+#include <random>
+#include <string>
+
+namespace compression
+{
+
+namespace
+{
+
+utils::bytes::ByteSequence log_lines(std::size_t count)
+{
+  std::mt19937 gen{17};
+  std::uniform_int_distribution<int> status(0, 5);
+  std::uniform_int_distribution<int> path(0, 40);
+
+  const char *statuses[]{"200", "200", "200", "304", "404", "500"};
+
+  std::string text;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    text += "2024-03-01T12:" + std::to_string(i % 60) + ":00Z GET /api/v1/items/" +
+        std::to_string(path(gen)) + " HTTP/1.1 " + statuses[status(gen)] + " " +
+        std::to_string(i * 37 % 5000) + "\n";
+  }
+
+  return utils::bytes::to_byte_array(text);
+}
+
+}  // namespace
+
+template <class Algo>
+class ChainRoundTrip : public ::testing::Test
+{};
+
+using Chains = ::testing::Types<Chain<ImplicitLZW, Huffman>,
+    Chain<BasicImplicitLZW<9, DictionaryPolicy::Reset>, Huffman>,
+    Chain<BasicImplicitLZW<12, DictionaryPolicy::Freeze>, BasicHuffman<15, 1>>>;
+TYPED_TEST_SUITE(ChainRoundTrip, Chains);
+
+TYPED_TEST(ChainRoundTrip, Strings)
+{
+  using Coding = Compressor<TypeParam>;
+
+  std::string inputs[]{"", "a", "aaaaaaaaaaaaaaaa", "TOBEORNOTTOBEORTOBEORNOT",
+      "abababababababababababab", "the quick brown fox jumps over the lazy dog"};
+
+  for (auto it = std::begin(inputs); it != std::end(inputs); it++)
+  {
+    SCOPED_TRACE(*it);
+
+    auto raw = utils::bytes::to_byte_array(*it);
+    EXPECT_EQ(Coding::decompress(Coding::compress(raw)), raw);
+  }
+}
+
+TYPED_TEST(ChainRoundTrip, Random)
+{
+  using Coding = Compressor<TypeParam>;
+
+  std::mt19937 gen{7};
+  std::uniform_int_distribution<int> dist(0, 15);
+
+  utils::bytes::ByteSequence raw(1 << 19);
+  for (auto &b : raw)
+  {
+    b = std::byte(dist(gen));
+  }
+
+  EXPECT_EQ(Coding::decompress(Coding::compress(raw)), raw);
+}
+
+TYPED_TEST(ChainRoundTrip, CallerOwnedBuffers)
+{
+  std::mt19937 gen{5};
+  std::uniform_int_distribution<int> dist(0, 255);
+
+  for (std::size_t size : {0, 1, 2, 300, 20000})
+  {
+    SCOPED_TRACE(size);
+
+    // Random bytes barely repeat, which is the worst case for the archive size.
+    utils::bytes::ByteSequence raw(size);
+    for (auto &b : raw)
+    {
+      b = std::byte(dist(gen));
+    }
+
+    check_caller_owned_buffers<TypeParam>(raw);
+  }
+}
+
+TEST(Chain, SmallerThanLZWAlone)
+{
+  auto raw = log_lines(20000);
+
+  auto chained = Compressor<Chain<ImplicitLZW, Huffman>>::compress(raw);
+  auto lzw = Compressor<ImplicitLZW>::compress(raw);
+
+  EXPECT_LT(chained.size(), lzw.size());
+}
+
+TEST(Chain, Malformed)
+{
+  using Coding = Compressor<Chain<ImplicitLZW, Huffman>>;
+
+  auto raw = log_lines(500);
+  auto archive = Coding::compress(raw);
+
+  utils::bytes::ByteSequence decoded(raw.size());
+  for (std::size_t size : {0, 1, 3})
+  {
+    SCOPED_TRACE(size);
+
+    EXPECT_FALSE(Coding::decompress(utils::bytes::ByteView{archive.data(), size}, decoded));
+  }
+
+  // A symbols counter claiming more codes than the output holds.
+  auto size_bytes = std::to_integer<std::size_t>(archive[0]);
+  std::size_t raw_bits_size = 0;
+  for (std::size_t i = 0; i < size_bytes; i++)
+  {
+    raw_bits_size |= std::to_integer<std::size_t>(archive[1 + i]) << (8 * i);
+  }
+
+  auto overcounted = archive;
+  auto symbols_count_front = overcounted.begin() + 1 + size_bytes + raw_bits_size + 1;
+  std::fill_n(symbols_count_front, 2, std::byte{0xFF});
+  EXPECT_FALSE(Coding::decompress(overcounted, decoded));
+
+  // Past the header, the symbols of a truncated archive decode to other data; the checksums of the
+  // container are what catches it.
+  auto decoded_size = Coding::decompress(
+      utils::bytes::ByteView{archive.data(), archive.size() / 2}, decoded);
+  EXPECT_TRUE(!decoded_size || decoded != raw);
+
+  // A malformed archive decodes to nothing, rather than to the data before the error.
+  std::mt19937 gen{13};
+  std::uniform_int_distribution<std::size_t> position(0, archive.size() - 1);
+  for (std::size_t i = 0; i < 200; i++)
+  {
+    auto corrupt = archive;
+    corrupt[position(gen)] = std::byte(gen());
+
+    auto allocated = Coding::decompress(corrupt);
+    utils::bytes::ByteSequence exact(allocated.size());
+    if (!allocated.empty())
+    {
+      EXPECT_EQ(Coding::decompress(corrupt, exact), allocated.size());
+    }
+  }
+}
+
+TEST(Chain, ForgedSymbolsCount)
+{
+  using Coding = Compressor<Chain<ImplicitLZW, Huffman>>;
+
+  // No raw bits, then symbols archives of a single used symbol, 'a', repeated 2^24 - 1 and 2^40 - 1
+  // times: the first passes the checks of Huffman, but not the codes count a chain can hold.
+  for (std::size_t counter_size : {3, 5})
+  {
+    SCOPED_TRACE(counter_size);
+
+    utils::bytes::ByteSequence forged{std::byte{1}, std::byte{0}, std::byte(counter_size << 4)};
+    forged.insert(forged.end(), counter_size, std::byte{0xFF});
+    forged.insert(forged.end(), {std::byte{'a'}, std::byte{0}, std::byte{'a'}, std::byte{0}});
+    forged.push_back(std::byte{0x1});
+
+    EXPECT_TRUE(Coding::decompress(forged).empty());
+  }
+}
+
+}  // namespace compression
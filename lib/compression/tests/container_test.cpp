@@ -0,0 +1,318 @@
+#include "compression/container.h"
+#include "compression/huffman.h"
+#include "compression/lzw.h"
+#include "utils/bytes.h"
+#include "utils/thread_pool.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace compression
+{
+
+namespace
+{
+
+utils::bytes::ByteSequence text(std::size_t size)
+{
+  std::string words[]{"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog\n"};
+  std::mt19937 gen{6};
+  std::uniform_int_distribution<std::size_t> dist(0, std::size(words) - 1);
+
+  utils::bytes::ByteSequence raw;
+  while (raw.size() < size)
+  {
+    for (auto chr : words[dist(gen)])
+    {
+      raw.push_back(std::byte(chr));
+    }
+  }
+
+  raw.resize(size);
+  return raw;
+}
+
+auto append_to(utils::bytes::ByteSequence &output)
+{
+  return [&output](utils::bytes::ByteView chunk) {
+    output.insert(output.end(), chunk.begin(), chunk.end());
+  };
+}
+
+template <class Algo>
+utils::bytes::ByteSequence pack(const utils::bytes::ByteSequence &raw, bool checksums = true,
+    utils::thread_pool::ThreadPool *pool = nullptr, std::size_t chunk_size = 0)
+{
+  utils::bytes::ByteSequence container;
+  FramedEncoder<Algo> encoder{append_to(container), FramedOptions{checksums, 4096, pool}};
+
+  utils::bytes::ByteView input{raw};
+  chunk_size = chunk_size ? chunk_size : raw.size();
+  for (std::size_t offset = 0; offset < input.size(); offset += chunk_size)
+  {
+    encoder.feed(input.subspan(offset, std::min(chunk_size, input.size() - offset)));
+  }
+
+  encoder.flush();
+
+  return container;
+}
+
+}  // namespace
+
+template <class Algo>
+class Container : public testing::Test
+{};
+
+using Algorithms =
+    testing::Types<Huffman, LZW, ImplicitLZW, Chain<ImplicitLZW, Huffman>, Adaptive>;
+TYPED_TEST_SUITE(Container, Algorithms);
+
+TYPED_TEST(Container, StreamRoundTrip)
+{
+  for (std::size_t size : {0, 1, 4095, 4096, 4097, 30000})
+  {
+    for (bool checksums : {false, true})
+    {
+      SCOPED_TRACE(size);
+
+      auto raw = text(size);
+      auto container = pack<TypeParam>(raw, checksums);
+
+      utils::bytes::ByteSequence decoded;
+      FramedDecoder decoder{append_to(decoded)};
+
+      // Feed a byte at a time, so that every field is split across calls.
+      for (auto byte : container)
+      {
+        EXPECT_TRUE(decoder.feed(utils::bytes::ByteView{&byte, 1}));
+      }
+
+      EXPECT_EQ(decoder.flush(), ContainerError::None);
+      EXPECT_EQ(decoder.codec(), CodecOf<TypeParam>::value);
+      EXPECT_EQ(decoded, raw);
+    }
+  }
+}
+
+TYPED_TEST(Container, ParallelEncodingKeepsTheOrder)
+{
+  utils::thread_pool::ThreadPool pool{3};
+
+  for (std::size_t size : {0, 4096, 30000, 200000})
+  {
+    SCOPED_TRACE(size);
+
+    auto raw = text(size);
+    auto serial = pack<TypeParam>(raw);
+
+    // Chunks that are not a multiple of the block size go through the pending batch.
+    for (std::size_t chunk_size : {std::size_t{0}, std::size_t{1000}, std::size_t{50000}})
+    {
+      SCOPED_TRACE(chunk_size);
+      EXPECT_EQ(pack<TypeParam>(raw, true, &pool, chunk_size), serial);
+    }
+  }
+}
+
+TEST(Container, InvalidBlockSize)
+{
+  utils::bytes::ByteSequence container;
+
+  EXPECT_THROW(
+      FramedEncoder<Huffman>(append_to(container), FramedOptions{true, 0}), std::invalid_argument);
+  EXPECT_THROW(FramedEncoder<Huffman>(append_to(container), FramedOptions{true, (1u << 30) + 1}),
+      std::invalid_argument);
+
+  // The archive of 2^30 bytes may take more than 2^32 bytes with LZW.
+  EXPECT_THROW(FramedEncoder<LZW>(append_to(container), FramedOptions{true, 1u << 30}),
+      std::invalid_argument);
+}
+
+TYPED_TEST(Container, RandomAccess)
+{
+  auto raw = text(30000);
+  auto container = pack<TypeParam>(raw);
+
+  FramedArchive archive{container};
+  ASSERT_EQ(archive.error(), ContainerError::None);
+  EXPECT_EQ(archive.codec(), CodecOf<TypeParam>::value);
+  EXPECT_EQ(archive.raw_size(), raw.size());
+  EXPECT_EQ(archive.blocks().size(), 8u);
+
+  utils::bytes::ByteSequence block(4096);
+  EXPECT_EQ(archive.decompress_block(3, block), ContainerError::None);
+  EXPECT_EQ(block, utils::bytes::ByteSequence(raw.begin() + 3 * 4096, raw.begin() + 4 * 4096));
+
+  utils::bytes::ByteSequence decoded(archive.raw_size());
+  EXPECT_EQ(archive.decompress(decoded), ContainerError::None);
+  EXPECT_EQ(decoded, raw);
+
+  EXPECT_EQ(archive.decompress_block(8, block), ContainerError::OutOfRange);
+  EXPECT_EQ(archive.decompress_block(std::size_t(-1), block), ContainerError::OutOfRange);
+  EXPECT_EQ(archive.decompress_blocks(7, 2, decoded), ContainerError::OutOfRange);
+  EXPECT_EQ(archive.decompress_blocks(8, 0, decoded), ContainerError::None);
+  EXPECT_EQ(archive.decompress_blocks(9, 0, decoded), ContainerError::OutOfRange);
+}
+
+TYPED_TEST(Container, Ranges)
+{
+  auto raw = text(30000);
+  auto container = pack<TypeParam>(raw);
+
+  FramedArchive archive{container};
+  ASSERT_EQ(archive.error(), ContainerError::None);
+
+  std::pair<std::size_t, std::size_t> ranges[]{{0, 0}, {0, 1}, {4095, 2}, {4096, 4096},
+      {100, 20000}, {29999, 1}, {0, 30000}, {30000, 0}};
+
+  for (auto [offset, length] : ranges)
+  {
+    SCOPED_TRACE(offset);
+    SCOPED_TRACE(length);
+
+    utils::bytes::ByteSequence slice(length);
+    EXPECT_EQ(archive.decompress_range(offset, slice), ContainerError::None);
+    auto expected = raw.begin() + offset;
+    EXPECT_EQ(slice, utils::bytes::ByteSequence(expected, expected + length));
+  }
+
+  utils::bytes::ByteSequence past_end(2);
+  EXPECT_EQ(archive.decompress_range(29999, past_end), ContainerError::OutOfRange);
+}
+
+TEST(Container, RangeDecodesCoveringBlocksOnly)
+{
+  auto raw = text(30000);
+  auto container = pack<Huffman>(raw);
+
+  FramedArchive archive{container};
+  ASSERT_EQ(archive.error(), ContainerError::None);
+
+  // Corrupt every block but the fourth: a range within it must not notice.
+  for (std::size_t i = 0; i < archive.blocks().size(); i++)
+  {
+    if (i != 3)
+    {
+      const auto &block = archive.blocks()[i];
+      std::fill_n(container.begin() + block.offset, block.header.size, std::byte{0xAA});
+    }
+  }
+
+  utils::bytes::ByteSequence slice(1000);
+  EXPECT_EQ(archive.decompress_range(3 * 4096 + 500, slice), ContainerError::None);
+  EXPECT_EQ(slice, utils::bytes::ByteSequence(raw.begin() + 3 * 4096 + 500,
+                       raw.begin() + 3 * 4096 + 1500));
+}
+
+TYPED_TEST(Container, CorruptBlockIsIsolated)
+{
+  auto raw = text(30000);
+  auto container = pack<TypeParam>(raw);
+
+  FramedArchive archive{container};
+  ASSERT_EQ(archive.error(), ContainerError::None);
+
+  // Flip a bit in the middle of the archive of block 2: the checksum rejects it before it is
+  // decoded.
+  const auto &victim = archive.blocks()[2];
+  container[victim.offset + victim.header.size / 2] ^= std::byte{0x10};
+
+  utils::bytes::ByteSequence block(4096);
+  EXPECT_EQ(archive.decompress_block(2, block), ContainerError::CorruptBlock);
+  EXPECT_EQ(archive.decompress_block(3, block), ContainerError::None);
+  EXPECT_EQ(archive.decompress(utils::bytes::ByteSequence(raw.size())),
+      ContainerError::CorruptBlock);
+
+  FramedDecoder decoder{[](utils::bytes::ByteView) {}};
+  EXPECT_FALSE(decoder.feed(container));
+  EXPECT_EQ(decoder.flush(), ContainerError::CorruptBlock);
+}
+
+TEST(Container, AdaptiveStoresIncompressibleBlocks)
+{
+  std::mt19937 gen{9};
+  std::uniform_int_distribution<int> dist(0, 255);
+
+  utils::bytes::ByteSequence noise(8 * 4096);
+  for (auto &b : noise)
+  {
+    b = std::byte(dist(gen));
+  }
+
+  auto raw = text(8 * 4096);
+  raw.insert(raw.end(), noise.begin(), noise.end());
+
+  auto container = pack<Adaptive>(raw);
+  FramedArchive archive{container};
+  ASSERT_EQ(archive.error(), ContainerError::None);
+  ASSERT_EQ(archive.blocks().size(), 16U);
+
+  // The text blocks shrink; the noise blocks cost their method byte only.
+  for (std::size_t i = 0; i < archive.blocks().size(); i++)
+  {
+    SCOPED_TRACE(i);
+
+    const auto &block = archive.blocks()[i];
+    if (i < 8)
+    {
+      EXPECT_LT(block.header.size, block.header.raw_size / 2);
+    }
+    else
+    {
+      EXPECT_EQ(block.header.size, block.header.raw_size + 1);
+    }
+  }
+
+  utils::bytes::ByteSequence decoded(raw.size());
+  EXPECT_EQ(archive.decompress(decoded), ContainerError::None);
+  EXPECT_EQ(decoded, raw);
+}
+
+TEST(Container, Malformed)
+{
+  auto container = pack<Huffman>(text(10000));
+
+  FramedDecoder truncated{[](utils::bytes::ByteView) {}};
+  truncated.feed(utils::bytes::ByteView{container}.first(container.size() / 2));
+  EXPECT_EQ(truncated.flush(), ContainerError::Truncated);
+  EXPECT_EQ(FramedArchive{utils::bytes::ByteView{container}.first(container.size() - 1)}.error(),
+      ContainerError::Truncated);
+
+  auto not_container = container;
+  not_container[0] = std::byte{'X'};
+  EXPECT_EQ(FramedArchive{not_container}.error(), ContainerError::BadMagic);
+
+  auto unknown_codec = container;
+  unknown_codec[5] = std::byte{0xEE};
+  FramedDecoder decoder{[](utils::bytes::ByteView) {}};
+  EXPECT_FALSE(decoder.feed(unknown_codec));
+  EXPECT_EQ(decoder.flush(), ContainerError::UnknownCodec);
+
+  auto newer = container;
+  newer[4] = std::byte{0xFF};
+  EXPECT_EQ(FramedArchive{newer}.error(), ContainerError::BadVersion);
+
+  // The last entry of the block table claims an archive running past the table.
+  auto overlong = container;
+  auto entry_size = 4 + 4 + 4;
+  auto last_entry = overlong.end() - detail::CONTAINER_FOOTER_SIZE - entry_size;
+  std::fill_n(last_entry + 4, 4, std::byte{0xFF});
+
+  FramedArchive corrupt{overlong};
+  EXPECT_EQ(corrupt.error(), ContainerError::CorruptBlock);
+  EXPECT_TRUE(corrupt.blocks().empty());
+  EXPECT_EQ(corrupt.raw_size(), 0u);
+
+  utils::bytes::ByteSequence decoded(10000);
+  EXPECT_EQ(corrupt.decompress(decoded), ContainerError::CorruptBlock);
+  EXPECT_EQ(corrupt.decompress_range(0, utils::bytes::MutableByteView{decoded}.first(0)),
+      ContainerError::CorruptBlock);
+}
+
+}  // namespace compression
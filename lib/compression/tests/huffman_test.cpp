@@ -0,0 +1,320 @@
+#include "compression/compressor.h"
+#include "compression/huffman.h"
+#include "lib/compression/tests/caller_owned_buffers.h"
+#include "utils/bytes.h"
+#include "utils/stats.h"
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace compression
+{
+
+using HuffmanCoding = Compressor<Huffman>;
+
+TEST(Huffman, RoundTrip)
+{
+  std::string inputs[]{"", "a", "aaaaaaaaaaaaaaaa", "ab", "TOBEORNOTTOBEORTOBEORNOT",
+      "the quick brown fox jumps over the lazy dog"};
+
+  for (auto it = std::begin(inputs); it != std::end(inputs); it++)
+  {
+    SCOPED_TRACE(*it);
+
+    auto raw = utils::bytes::to_byte_array(*it);
+    EXPECT_EQ(HuffmanCoding::decompress(HuffmanCoding::compress(raw)), raw);
+  }
+}
+
+TEST(Huffman, LongCodes)
+{
+  /*
+   * Fibonacci frequencies give the deepest possible tree, so that codes need several levels of
+   * decoding tables.
+   */
+  utils::bytes::ByteSequence raw;
+  std::size_t prev = 1, curr = 1;
+
+  for (std::size_t symbol = 0; symbol < 26; symbol++)
+  {
+    raw.insert(raw.end(), curr, std::byte(symbol));
+
+    auto next = prev + curr;
+    prev = curr;
+    curr = next;
+  }
+
+  std::shuffle(raw.begin(), raw.end(), std::mt19937{5});
+
+  EXPECT_EQ(HuffmanCoding::decompress(HuffmanCoding::compress(raw)), raw);
+}
+
+TEST(Huffman, LengthLimit)
+{
+  utils::bytes::ByteSequence raw;
+  std::size_t prev = 1, curr = 1;
+
+  for (std::size_t symbol = 0; symbol < 20; symbol++)
+  {
+    raw.insert(raw.end(), curr, std::byte(symbol));
+
+    auto next = prev + curr;
+    prev = curr;
+    curr = next;
+  }
+
+  for (std::size_t symbol = 20; symbol < 256; symbol++)
+  {
+    raw.push_back(std::byte(symbol));
+  }
+
+  std::shuffle(raw.begin(), raw.end(), std::mt19937{6});
+
+  using ShortCodes = Compressor<BasicHuffman<8>>;
+  EXPECT_EQ(ShortCodes::decompress(ShortCodes::compress(raw)), raw);
+}
+
+template <class Coding>
+void expect_round_trips()
+{
+  std::mt19937 gen{7};
+  std::geometric_distribution<int> dist(0.1);
+
+  for (std::size_t size : {1000, 1023, 1024, 1025, 4099, 100000})
+  {
+    SCOPED_TRACE(size);
+
+    utils::bytes::ByteSequence raw(size);
+    for (auto &b : raw)
+    {
+      b = std::byte(std::min(dist(gen), 255));
+    }
+
+    EXPECT_EQ(Coding::decompress(Coding::compress(raw)), raw);
+  }
+}
+
+TEST(Huffman, Streams)
+{
+  expect_round_trips<Compressor<BasicHuffman<15, 1>>>();
+  expect_round_trips<Compressor<BasicHuffman<15, 2>>>();
+  expect_round_trips<Compressor<BasicHuffman<15, 4>>>();
+  expect_round_trips<Compressor<BasicHuffman<15, 8>>>();
+}
+
+TEST(Huffman, WideSymbols)
+{
+  using Wide = BasicHuffman<15, 4, 600>;
+
+  struct Coder : Wide
+  {
+    using Wide::decode_symbols;
+    using Wide::encode_symbols;
+    using Wide::symbols_count;
+  };
+
+  std::mt19937 gen{13};
+  std::geometric_distribution<int> dist(0.01);
+
+  for (std::size_t size : {0, 1, 2, 100, 5000, 100000})
+  {
+    SCOPED_TRACE(size);
+
+    std::vector<Wide::Symbol> symbols(size);
+    for (auto &symbol : symbols)
+    {
+      symbol = Wide::Symbol(std::min(dist(gen), 599));
+    }
+
+    utils::bytes::ByteSequence encoded;
+    Coder::encode_symbols(symbols, encoded);
+    ASSERT_EQ(Coder::symbols_count(encoded), size);
+
+    std::vector<Wide::Symbol> decoded(size);
+    EXPECT_EQ(Coder::decode_symbols(encoded, decoded), size);
+    EXPECT_EQ(decoded, symbols);
+  }
+}
+
+TEST(Huffman, SymbolsCountBoundByArchive)
+{
+  // A single used symbol takes no bits at all, up to Huffman::MAX_RUN_SIZE of them.
+  utils::bytes::ByteSequence run(100000, std::byte{'a'});
+  EXPECT_EQ(HuffmanCoding::decompress(HuffmanCoding::compress(run)), run);
+
+  auto forged_run = HuffmanCoding::compress(run);
+  ASSERT_EQ(forged_run[0] & std::byte{0xF0}, std::byte{0x30});
+  forged_run[0] = (forged_run[0] & std::byte{0x0F}) | std::byte{0x50};
+  forged_run.insert(forged_run.begin() + 1, 2, std::byte{0xFF});
+  std::fill_n(forged_run.begin() + 1, 5, std::byte{0xFF});
+  EXPECT_TRUE(HuffmanCoding::decompress(forged_run).empty());
+
+  // Longer runs get a code.
+  utils::bytes::ByteSequence long_run(Huffman::MAX_RUN_SIZE + 1, std::byte{'a'});
+  auto long_run_archive = HuffmanCoding::compress(long_run);
+  EXPECT_GT(long_run_archive.size(), long_run.size() / 8);
+  EXPECT_EQ(HuffmanCoding::decompress(long_run_archive), long_run);
+
+  // Otherwise, a counter of 7 bytes claims far more symbols than the streams hold, and nothing is
+  // allocated for them.
+  auto archive = HuffmanCoding::compress(utils::bytes::to_byte_array(std::string{"hello, world"}));
+  archive[0] = (archive[0] & std::byte{0x0F}) | std::byte{0x70};
+  for (std::size_t i = 1; i < 8; i++)
+  {
+    archive.insert(archive.begin() + 1, std::byte{0xFF});
+  }
+
+  EXPECT_TRUE(HuffmanCoding::decompress(archive).empty());
+}
+
+TEST(Huffman, MalformedLengths)
+{
+  auto raw = utils::bytes::to_byte_array(std::string{"hello, world"});
+  utils::bytes::ByteSequence decoded(raw.size());
+
+  // 9 distinct symbols: their 5 bytes of lengths follow the control, counter and symbol bytes.
+  auto lengths_front = 1 + 1 + 1 + 9;
+
+  auto over_subscribed = HuffmanCoding::compress(raw);
+  std::fill_n(over_subscribed.begin() + lengths_front, 5, std::byte{0x11});
+  EXPECT_FALSE(HuffmanCoding::decompress(over_subscribed, decoded));
+  EXPECT_TRUE(HuffmanCoding::decompress(over_subscribed).empty());
+
+  // 9 codes of 4 bits leave codes that read no symbol.
+  auto incomplete = HuffmanCoding::compress(raw);
+  std::fill_n(incomplete.begin() + lengths_front, 5, std::byte{0x44});
+  EXPECT_FALSE(HuffmanCoding::decompress(incomplete, decoded));
+  EXPECT_TRUE(HuffmanCoding::decompress(incomplete).empty());
+
+  using ShortCodes = Compressor<BasicHuffman<8>>;
+  auto too_long = ShortCodes::compress(raw);
+  too_long[lengths_front] |= std::byte{0xF};
+  EXPECT_FALSE(ShortCodes::decompress(too_long, decoded));
+}
+
+TEST(Huffman, MalformedCounterSize)
+{
+  std::string text;
+  for (int i = 0; i < 200; i++)
+  {
+    text += "hello, world ";
+  }
+
+  auto raw = utils::bytes::to_byte_array(text);
+  utils::bytes::ByteSequence decoded(raw.size());
+
+  // Several streams, so that the jump table entries take as many bytes as the counter says.
+  auto archive = HuffmanCoding::compress(raw);
+  ASSERT_NE(archive[0] & std::byte{0x6}, std::byte{0});
+
+  for (auto counter_size : {std::byte{0x00}, std::byte{0x90}, std::byte{0xF0}})
+  {
+    auto malformed = archive;
+    malformed[0] = (malformed[0] & std::byte{0x0F}) | counter_size;
+
+    EXPECT_FALSE(HuffmanCoding::decompress(malformed, decoded));
+    EXPECT_TRUE(HuffmanCoding::decompress(malformed).empty());
+  }
+}
+
+TEST(Huffman, SmallHeader)
+{
+  auto raw = utils::bytes::to_byte_array(std::string{"hello, world"});
+
+  /*
+   * 9 distinct symbols: 1 control byte, 1 counter byte, 1 + 9 sparse symbol bytes, 5 bytes of
+   * lengths, then the codes.
+   */
+  EXPECT_LE(HuffmanCoding::compress(raw).size(), 17 + raw.size() / 2);
+}
+
+TEST(Huffman, SmallPayloadAllocations)
+{
+  auto raw = utils::bytes::to_byte_array(std::string{"GET /index.html HTTP/1.1\r\nHost: x\r\n"});
+
+  auto before = utils::stats::allocations_count.load();
+  auto encoded = HuffmanCoding::compress(raw);
+  auto encode_allocations = utils::stats::allocations_count - before;
+
+  before = utils::stats::allocations_count.load();
+  auto decoded = HuffmanCoding::decompress(encoded);
+  auto decode_allocations = utils::stats::allocations_count - before;
+
+  // The tree and the code tables live on the stack: only the output buffers are allocated.
+  EXPECT_LE(encode_allocations, 2u);
+  EXPECT_EQ(decode_allocations, 1u);
+  EXPECT_EQ(decoded, raw);
+}
+
+TEST(Huffman, CallerOwnedBuffers)
+{
+  std::mt19937 gen{3};
+  std::uniform_int_distribution<int> dist(0, 255);
+
+  for (std::size_t size : {0, 1, 100, 1023, 1024, 5000})
+  {
+    SCOPED_TRACE(size);
+
+    // Uniform bytes are the worst case, and must still fit in compress_bound().
+    utils::bytes::ByteSequence raw(size);
+    for (auto &b : raw)
+    {
+      b = std::byte(dist(gen));
+    }
+
+    check_caller_owned_buffers<Huffman>(raw);
+  }
+}
+
+TEST(Huffman, CallerOwnedBuffersAllocateNothing)
+{
+  auto raw = utils::bytes::to_byte_array(std::string{"GET /index.html HTTP/1.1\r\nHost: x\r\n"});
+
+  std::byte archive[256];
+  std::byte decoded[256];
+
+  // The statistics registry, when compiled in, allocates its entries on the first call.
+  if constexpr (utils::stats::ENABLED)
+  {
+    auto warm_up_size = HuffmanCoding::compress(raw, archive);
+    HuffmanCoding::decompress(utils::bytes::ByteView{archive, *warm_up_size}, decoded);
+  }
+
+  auto before = utils::stats::allocations_count.load();
+  auto archive_size = HuffmanCoding::compress(raw, archive);
+  auto decoded_size =
+      HuffmanCoding::decompress(utils::bytes::ByteView{archive, *archive_size}, decoded);
+
+  EXPECT_EQ(utils::stats::allocations_count - before, 0u);
+  EXPECT_EQ(utils::bytes::ByteSequence(decoded, decoded + *decoded_size), raw);
+}
+
+TEST(Huffman, DecodeThroughput)
+{
+  std::mt19937 gen{9};
+  std::geometric_distribution<int> dist(0.08);
+
+  utils::bytes::ByteSequence raw(1 << 22);
+  for (auto &b : raw)
+  {
+    b = std::byte(std::min(dist(gen), 255));
+  }
+
+  auto encoded = HuffmanCoding::compress(raw);
+
+  auto t1 = std::chrono::steady_clock::now();
+  auto decoded = HuffmanCoding::decompress(encoded);
+  auto t2 = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double> dur_s{t2 - t1};
+  RecordProperty("decode_mb_per_s", std::to_string(raw.size() / dur_s.count() / 1e6));
+
+  EXPECT_EQ(decoded, raw);
+}
+
+}  // namespace compression
@@ -1,10 +1,13 @@
 #include "compression/compressor.h"
 #include "compression/lzw.h"
+#include "lib/compression/tests/caller_owned_buffers.h"
 #include "utils/bytes.h"
 
 #include "gtest/gtest.h"
 #include <cstdint>
 #include <iterator>
+#include <map>
+#include <random>
 #include <string>
 
 namespace compression
@@ -89,4 +92,262 @@ TEST(Dictionary, At)
   EXPECT_TRUE(dict.at(512).empty());
 }
 
+TEST(Dictionary, ChildAt)
+{
+  Dictionary dict;
+
+  auto foo = dict.put_sequence(utils::bytes::to_byte_array(std::string{"foo"}));
+  auto fo = dict.find(utils::bytes::to_byte_array(std::string{"fo"}));
+
+  ASSERT_TRUE(fo);
+  EXPECT_EQ(dict.child_at(*fo, std::byte{'o'}), foo);
+  EXPECT_FALSE(dict.child_at(*fo, std::byte{'x'}));
+  EXPECT_EQ(dict.entry(foo)->parent, *fo);
+  EXPECT_EQ(dict.entry(foo)->symbol, std::byte{'o'});
+}
+
+TEST(Dictionary, MemoryPerEntry)
+{
+  Dictionary dict;
+
+  std::mt19937 gen{42};
+  std::uniform_int_distribution<std::size_t> dist(0, 255);
+
+  std::size_t curr = 0;
+  while (dict.size() < (1u << 20))
+  {
+    auto symbol = std::byte(dist(gen));
+    auto child = dict.child_at(curr, symbol);
+
+    curr = child ? *child : (dict.put_symbol(curr, symbol), std::to_integer<std::size_t>(symbol));
+  }
+
+  double bytes_per_entry = 1. * dict.memory_usage() / dict.size();
+  RecordProperty("bytes_per_entry", std::to_string(bytes_per_entry));
+
+  EXPECT_LT(bytes_per_entry, 32.);
+}
+
+TEST(LZWEncoder, Codes)
+{
+  Dictionary dict;
+  LZWEncoder encoder{dict};
+
+  std::vector<std::size_t> codes;
+  auto emit = [&codes](std::size_t code) { codes.push_back(code); };
+
+  auto raw = utils::bytes::to_byte_array(std::string{"abababab"});
+  encoder.feed(raw.begin(), std::next(raw.begin(), 3), emit);
+  encoder.feed(std::next(raw.begin(), 3), raw.end(), emit);
+  encoder.flush(emit);
+
+  EXPECT_EQ(codes, (std::vector<std::size_t>{'a', 'b', 256, 258, 'b'}));
+  EXPECT_EQ(dict.size(), ASCII_TABLE_SIZE + 4);
+}
+
+TEST(PhraseBuffer, OverlappingCopy)
+{
+  PhraseBuffer phrases;
+
+  phrases.emit('a');
+  phrases.emit('b');
+  phrases.add(PhraseBuffer::Phrase{0, 2});  // "ab"
+  phrases.add(PhraseBuffer::Phrase{1, 2});  // "bb", whose last byte is produced by the copy itself
+
+  phrases.emit(ASCII_TABLE_SIZE + 1);
+  phrases.emit(ASCII_TABLE_SIZE);
+
+  EXPECT_EQ(phrases.release(), utils::bytes::to_byte_array(std::string{"abbbab"}));
+}
+
+template <class Algo>
+class LZWRoundTrip : public ::testing::Test
+{};
+
+using LZWFormats = ::testing::Types<LZW, ImplicitLZW, BasicImplicitLZW<9, DictionaryPolicy::Freeze>,
+    BasicImplicitLZW<9, DictionaryPolicy::Reset>, BasicImplicitLZW<10, DictionaryPolicy::Monitor>>;
+TYPED_TEST_SUITE(LZWRoundTrip, LZWFormats);
+
+TYPED_TEST(LZWRoundTrip, Strings)
+{
+  using LZWCompressor = Compressor<TypeParam>;
+
+  std::string inputs[]{"", "a", "aaaaaaaaaaaaaaaa", "TOBEORNOTTOBEORTOBEORNOT",
+      "abababababababababababab", "the quick brown fox jumps over the lazy dog"};
+
+  for (auto it = std::begin(inputs); it != std::end(inputs); it++)
+  {
+    SCOPED_TRACE(*it);
+
+    auto raw = utils::bytes::to_byte_array(*it);
+    EXPECT_EQ(LZWCompressor::decompress(LZWCompressor::compress(raw)), raw);
+  }
+}
+
+TYPED_TEST(LZWRoundTrip, Random)
+{
+  using LZWCompressor = Compressor<TypeParam>;
+
+  std::mt19937 gen{7};
+  std::uniform_int_distribution<int> dist(0, 15);
+
+  /*
+   * A small alphabet makes the dictionary grow deep enough for the codes to need 3 bytes.
+   */
+  utils::bytes::ByteSequence raw(1 << 20);
+  for (auto &b : raw)
+  {
+    b = std::byte(dist(gen));
+  }
+
+  EXPECT_EQ(LZWCompressor::decompress(LZWCompressor::compress(raw)), raw);
+}
+
+TYPED_TEST(LZWRoundTrip, Malformed)
+{
+  using LZWCompressor = Compressor<TypeParam>;
+
+  EXPECT_TRUE(LZWCompressor::decompress(utils::bytes::ByteSequence{}).empty());
+
+  std::mt19937 gen{11};
+  std::uniform_int_distribution<int> dist(0, 15);
+
+  utils::bytes::ByteSequence raw(5000);
+  for (auto &b : raw)
+  {
+    b = std::byte(dist(gen));
+  }
+
+  auto archive = LZWCompressor::compress(raw);
+  utils::bytes::ByteSequence decoded(raw.size());
+
+  // Truncated archives and corrupt codes decode to other data, or are rejected, but are never
+  // read out of bounds.
+  for (std::size_t size = 0; size < archive.size(); size += 97)
+  {
+    LZWCompressor::decompress(utils::bytes::ByteView{archive.data(), size}, decoded);
+  }
+
+  std::uniform_int_distribution<std::size_t> position(0, archive.size() - 1);
+  for (std::size_t i = 0; i < 200; i++)
+  {
+    auto corrupt = archive;
+    corrupt[position(gen)] = std::byte(gen());
+
+    auto decoded_size = LZWCompressor::decompress(corrupt, decoded);
+    EXPECT_TRUE(!decoded_size || *decoded_size <= decoded.size());
+
+    // A malformed archive decodes to nothing, rather than to the data before the error.
+    auto allocated = LZWCompressor::decompress(corrupt);
+    utils::bytes::ByteSequence exact(allocated.size());
+    if (!allocated.empty())
+    {
+      EXPECT_EQ(LZWCompressor::decompress(corrupt, exact), allocated.size());
+    }
+  }
+}
+
+TEST(ImplicitLZW, MalformedHeader)
+{
+  using Coding = Compressor<ImplicitLZW>;
+
+  auto raw = utils::bytes::to_byte_array(std::string{"TOBEORNOTTOBEORTOBEORNOT"});
+  auto archive = Coding::compress(raw);
+  utils::bytes::ByteSequence decoded(64);
+
+  for (int max_code_bits : {0, 8, 32, 64, 255})
+  {
+    SCOPED_TRACE(max_code_bits);
+
+    archive[0] = std::byte(max_code_bits);
+    EXPECT_FALSE(Coding::decompress(archive, decoded));
+    EXPECT_TRUE(Coding::decompress(archive).empty());
+  }
+}
+
+TEST(LZWEncoder, MaxSize)
+{
+  Dictionary dict{1};
+  LZWEncoder encoder{dict, 512, DictionaryPolicy::Reset};
+
+  std::mt19937 gen{3};
+  std::uniform_int_distribution<int> dist(0, 3);
+
+  utils::bytes::ByteSequence raw(1 << 16);
+  for (auto &b : raw)
+  {
+    b = std::byte(dist(gen));
+  }
+
+  std::size_t clears = 0;
+  encoder.feed(raw.begin(), raw.end(), [&dict, &clears](std::size_t code) {
+    EXPECT_LT(code, dict.size());
+    EXPECT_LE(dict.size(), 512);
+
+    clears += code == LZWEncoder::CLEAR_CODE;
+  });
+
+  EXPECT_GT(clears, 0);
+}
+
+TEST(ImplicitLZW, MonitorResetsOnDrift)
+{
+  /*
+   * Two halves with disjoint alphabets: once the dictionary filled up on the first half, it is of
+   * no use for the second one, so the Monitor policy must be at least as good as freezing.
+   */
+  std::mt19937 gen{11};
+  std::uniform_int_distribution<int> dist(0, 7);
+
+  utils::bytes::ByteSequence raw(1 << 18);
+  for (std::size_t i = 0; i < raw.size(); i++)
+  {
+    raw[i] = std::byte((i < raw.size() / 2 ? 'a' : 'A') + dist(gen) * (i % 3 == 0));
+  }
+
+  using Monitor = Compressor<BasicImplicitLZW<12, DictionaryPolicy::Monitor>>;
+  using Freeze = Compressor<BasicImplicitLZW<12, DictionaryPolicy::Freeze>>;
+
+  auto monitored = Monitor::compress(raw);
+
+  EXPECT_EQ(Monitor::decompress(monitored), raw);
+  EXPECT_LT(monitored.size(), Freeze::compress(raw).size());
+}
+
+TEST(ImplicitLZW, SmallerThanStoredDictionary)
+{
+  std::string text;
+  for (int i = 0; i < 2000; i++)
+  {
+    text += "GET /index.html HTTP/1.1 200 " + std::to_string(i % 37) + "\n";
+  }
+
+  auto raw = utils::bytes::to_byte_array(text);
+
+  EXPECT_LT(Compressor<ImplicitLZW>::compress(raw).size() * 3,
+      Compressor<LZW>::compress(raw).size() * 2);
+}
+
+TEST(LZW, CallerOwnedBuffers)
+{
+  std::mt19937 gen{5};
+  std::uniform_int_distribution<int> dist(0, 255);
+
+  for (std::size_t size : {0, 1, 2, 300, 20000})
+  {
+    SCOPED_TRACE(size);
+
+    // Random bytes barely repeat, which is the worst case for the archive size.
+    utils::bytes::ByteSequence raw(size);
+    for (auto &b : raw)
+    {
+      b = std::byte(dist(gen));
+    }
+
+    check_caller_owned_buffers<LZW>(raw);
+    check_caller_owned_buffers<ImplicitLZW>(raw);
+    check_caller_owned_buffers<BasicImplicitLZW<9, DictionaryPolicy::Reset>>(raw);
+  }
+}
+
 }  // namespace compression
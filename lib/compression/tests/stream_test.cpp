@@ -0,0 +1,221 @@
+#include "compression/huffman.h"
+#include "compression/lzw.h"
+#include "compression/stream.h"
+#include "utils/bytes.h"
+#include "utils/thread_pool.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+namespace compression
+{
+
+namespace
+{
+
+utils::bytes::ByteSequence text(std::size_t size)
+{
+  std::string words[]{"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog\n"};
+  std::mt19937 gen{4};
+  std::uniform_int_distribution<std::size_t> dist(0, std::size(words) - 1);
+
+  utils::bytes::ByteSequence raw;
+  while (raw.size() < size)
+  {
+    for (auto chr : words[dist(gen)])
+    {
+      raw.push_back(std::byte(chr));
+    }
+  }
+
+  raw.resize(size);
+  return raw;
+}
+
+/**
+ * \brief Feed \p input in chunks of \p chunk_size bytes.
+ */
+template <class Stream>
+void feed_chunks(Stream &stream, const utils::bytes::ByteSequence &input, std::size_t chunk_size)
+{
+  utils::bytes::ByteView view{input};
+  while (!view.empty())
+  {
+    auto count = std::min(chunk_size, view.size());
+    stream.feed(view.first(count));
+    view = view.subspan(count);
+  }
+}
+
+auto append_to(utils::bytes::ByteSequence &output)
+{
+  return [&output](utils::bytes::ByteView chunk) {
+    output.insert(output.end(), chunk.begin(), chunk.end());
+  };
+}
+
+}  // namespace
+
+template <class Algo>
+class StreamRoundTrip : public testing::Test
+{};
+
+using StreamAlgorithms = testing::Types<Huffman, LZW, ImplicitLZW>;
+TYPED_TEST_SUITE(StreamRoundTrip, StreamAlgorithms);
+
+TYPED_TEST(StreamRoundTrip, Chunks)
+{
+  for (std::size_t size : {0, 1, 4095, 4096, 4097, 50000})
+  {
+    for (std::size_t chunk_size : {1, 1000, 100000})
+    {
+      SCOPED_TRACE(std::to_string(size) + " bytes by " + std::to_string(chunk_size));
+
+      auto raw = text(size);
+
+      utils::bytes::ByteSequence stream;
+      StreamEncoder<TypeParam, 4096> encoder{append_to(stream)};
+      feed_chunks(encoder, raw, chunk_size);
+      encoder.flush();
+
+      utils::bytes::ByteSequence decoded;
+      StreamDecoder<TypeParam> decoder{append_to(decoded)};
+      feed_chunks(decoder, stream, chunk_size);
+
+      EXPECT_TRUE(decoder.flush());
+      EXPECT_EQ(decoded, raw);
+    }
+  }
+}
+
+TYPED_TEST(StreamRoundTrip, ThreadPool)
+{
+  utils::thread_pool::ThreadPool pool{3};
+
+  for (std::size_t size : {0, 4096, 50000, 200000})
+  {
+    for (std::size_t chunk_size : {1000, 100000})
+    {
+      SCOPED_TRACE(std::to_string(size) + " bytes by " + std::to_string(chunk_size));
+
+      auto raw = text(size);
+
+      utils::bytes::ByteSequence serial;
+      StreamEncoder<TypeParam, 4096> serial_encoder{append_to(serial)};
+      feed_chunks(serial_encoder, raw, chunk_size);
+      serial_encoder.flush();
+
+      // The frames come out in input order, whatever the thread that compressed them.
+      utils::bytes::ByteSequence stream;
+      StreamEncoder<TypeParam, 4096> encoder{append_to(stream), pool};
+      feed_chunks(encoder, raw, chunk_size);
+      encoder.flush();
+
+      EXPECT_EQ(stream, serial);
+
+      utils::bytes::ByteSequence decoded;
+      StreamDecoder<TypeParam> decoder{append_to(decoded), pool};
+      feed_chunks(decoder, stream, chunk_size);
+
+      EXPECT_TRUE(decoder.flush());
+      EXPECT_EQ(decoded, raw);
+    }
+  }
+}
+
+TEST(Stream, EmitsBeforeFlush)
+{
+  std::size_t emitted = 0;
+  StreamEncoder<Huffman, 4096> encoder{[&](auto chunk) { emitted += chunk.size(); }};
+
+  encoder.feed(text(4095));
+  EXPECT_EQ(emitted, 0u);
+
+  encoder.feed(text(1));
+  EXPECT_GT(emitted, 0u);
+}
+
+TEST(Stream, Truncated)
+{
+  utils::bytes::ByteSequence stream;
+  StreamEncoder<Huffman, 4096> encoder{append_to(stream)};
+  encoder.feed(text(10000));
+  encoder.flush();
+
+  utils::bytes::ByteSequence decoded;
+  StreamDecoder<Huffman> decoder{append_to(decoded)};
+  // Cut the end of stream and the last byte of the last frame.
+  decoder.feed(utils::bytes::ByteView{stream}.first(stream.size() - detail::FRAME_HEADER_SIZE - 1));
+
+  EXPECT_FALSE(decoder.flush());
+  EXPECT_EQ(decoded, text(8192));
+}
+
+TEST(Stream, TruncatedWithThreadPool)
+{
+  utils::bytes::ByteSequence stream;
+  StreamEncoder<Huffman, 4096> encoder{append_to(stream)};
+  encoder.feed(text(10000));
+  encoder.flush();
+
+  // The complete frames still pending in the batch are emitted by flush().
+  utils::thread_pool::ThreadPool pool{3};
+  utils::bytes::ByteSequence decoded;
+  StreamDecoder<Huffman> decoder{append_to(decoded), pool};
+  decoder.feed(utils::bytes::ByteView{stream}.first(stream.size() - detail::FRAME_HEADER_SIZE - 1));
+
+  EXPECT_TRUE(decoded.empty());
+  EXPECT_FALSE(decoder.flush());
+  EXPECT_EQ(decoded, text(8192));
+}
+
+TEST(Stream, OversizedFrame)
+{
+  // The frame claims more bytes than the archive of a whole block could take.
+  auto stream = utils::bytes::to_bytes(std::uint32_t{0xffffffff});
+
+  utils::bytes::ByteSequence decoded;
+  StreamDecoder<Huffman, 4096> decoder{append_to(decoded)};
+  decoder.feed(stream);
+
+  EXPECT_FALSE(decoder.flush());
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST(Stream, MalformedFrame)
+{
+  utils::bytes::ByteSequence stream;
+  StreamEncoder<LZW, 4096> encoder{append_to(stream)};
+  encoder.feed(text(10000));
+  encoder.flush();
+
+  // Slip a frame with a null pointer size after the first one.
+  utils::bytes::ByteSequence header(stream.begin(), stream.begin() + detail::FRAME_HEADER_SIZE);
+  auto first_size = detail::FRAME_HEADER_SIZE + utils::bytes::from_bytes<std::uint32_t>(header);
+  auto size = utils::bytes::to_bytes(std::uint32_t{1});
+  utils::bytes::ByteSequence frame(size.begin(), size.end());
+  frame.push_back(std::byte{0});
+  stream.insert(stream.begin() + std::ptrdiff_t(first_size), frame.begin(), frame.end());
+
+  // The blocks before the malformed frame are still emitted.
+  utils::bytes::ByteSequence decoded;
+  StreamDecoder<LZW> decoder{append_to(decoded)};
+  decoder.feed(stream);
+
+  EXPECT_FALSE(decoder.flush());
+  EXPECT_EQ(decoded, text(4096));
+
+  utils::thread_pool::ThreadPool pool{3};
+  utils::bytes::ByteSequence pooled;
+  StreamDecoder<LZW> pooled_decoder{append_to(pooled), pool};
+  pooled_decoder.feed(stream);
+
+  EXPECT_FALSE(pooled_decoder.flush());
+  EXPECT_EQ(pooled, text(4096));
+}
+
+}  // namespace compression
@@ -4,6 +4,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace utils::bytes
@@ -94,6 +96,181 @@ static T from_bytes(const U (&array)[N])
 
 using ByteSequence = std::vector<std::byte>;
 
+/**
+ * \brief Non-owning view over contiguous elements of type \p T, standing in for C++20 std::span.
+ */
+template <class T>
+class Span
+{
+public:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  constexpr Span() noexcept = default;
+
+  constexpr Span(T *data, std::size_t size) noexcept : data_{data}, size_{size}
+  {}
+
+  template <class Container,
+      class = std::enable_if_t<
+          std::is_convertible_v<decltype(std::data(std::declval<Container &>())), T *>>>
+  constexpr Span(Container &&c) noexcept : Span{std::data(c), std::size(c)}
+  {}
+
+  constexpr T *data() const noexcept
+  {
+    return data_;
+  }
+
+  constexpr std::size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  constexpr bool empty() const noexcept
+  {
+    return size_ == 0;
+  }
+
+  constexpr T *begin() const noexcept
+  {
+    return data_;
+  }
+
+  constexpr T *end() const noexcept
+  {
+    return data_ + size_;
+  }
+
+  constexpr T &operator[](std::size_t idx) const noexcept
+  {
+    return data_[idx];
+  }
+
+  constexpr Span first(std::size_t count) const noexcept
+  {
+    return Span{data_, count};
+  }
+
+  constexpr Span subspan(std::size_t offset, std::size_t count = npos) const noexcept
+  {
+    return Span{data_ + offset, count == npos ? size_ - offset : count};
+  }
+
+private:
+  T *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+using ByteView = Span<const std::byte>;
+using MutableByteView = Span<std::byte>;
+
+/**
+ * \brief Vector-like facade over a caller-owned buffer, which lets the code written against
+ * ByteSequence fill a buffer it does not own.
+ *
+ * It never allocates: growing past the end of the buffer drops the excess bytes and marks the
+ * buffer as overflowed. Unlike std::vector, resize() leaves the new bytes uninitialized.
+ */
+class FixedBuffer
+{
+public:
+  using value_type = std::byte;
+  using pointer = std::byte *;
+  using iterator = std::byte *;
+
+  explicit FixedBuffer(MutableByteView storage) noexcept : storage_{storage}
+  {}
+
+  std::byte *data() const noexcept
+  {
+    return storage_.data();
+  }
+
+  std::size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  std::size_t capacity() const noexcept
+  {
+    return storage_.size();
+  }
+
+  bool empty() const noexcept
+  {
+    return size_ == 0;
+  }
+
+  std::byte *begin() const noexcept
+  {
+    return storage_.data();
+  }
+
+  std::byte *end() const noexcept
+  {
+    return storage_.data() + size_;
+  }
+
+  std::byte &back() const noexcept
+  {
+    return storage_[size_ - 1];
+  }
+
+  /**
+   * \brief Whether more bytes were written than the buffer holds.
+   */
+  bool overflowed() const noexcept
+  {
+    return overflowed_;
+  }
+
+  void reserve(std::size_t) noexcept
+  {}
+
+  void resize(std::size_t size) noexcept
+  {
+    if (size > capacity())
+    {
+      overflowed_ = true;
+      size = capacity();
+    }
+
+    size_ = size;
+  }
+
+  void push_back(std::byte value) noexcept
+  {
+    if (size_ == capacity())
+    {
+      overflowed_ = true;
+      return;
+    }
+
+    storage_[size_++] = value;
+  }
+
+private:
+  MutableByteView storage_;
+  std::size_t size_ = 0;
+  bool overflowed_ = false;
+};
+
+/**
+ * \brief Whether \p container overflowed. Only a FixedBuffer can.
+ */
+template <class Container>
+bool overflowed(const Container &container) noexcept
+{
+  if constexpr (std::is_same_v<Container, FixedBuffer>)
+  {
+    return container.overflowed();
+  }
+  else
+  {
+    return false;
+  }
+}
+
 template <class Container>
 ByteSequence to_byte_array(const Container &c)
 {
@@ -111,7 +288,7 @@ ByteSequence to_byte_array(const Container &c)
 }
 
 template <typename Integer>
-std::size_t count_bits(Integer n)
+constexpr std::size_t count_bits(Integer n)
 {
   static_assert(std::is_integral_v<Integer>);
 
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "utils/bytes.h"
+#include "utils/unaligned_storage.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace utils::checksum
+{
+
+namespace detail
+{
+
+using Crc32Tables = std::array<std::array<std::uint32_t, 256>, 8>;
+
+/**
+ * \brief Tables for slicing-by-8: tables[k][b] is the CRC of byte b followed by k zero bytes.
+ */
+constexpr Crc32Tables make_crc32_tables() noexcept
+{
+  Crc32Tables tables{};
+  for (std::uint32_t byte = 0; byte < 256; byte++)
+  {
+    auto crc = byte;
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+
+    tables[0][byte] = crc;
+  }
+
+  for (std::size_t byte = 0; byte < 256; byte++)
+  {
+    for (std::size_t k = 1; k < tables.size(); k++)
+    {
+      auto prev = tables[k - 1][byte];
+      tables[k][byte] = (prev >> 8) ^ tables[0][prev & 0xFF];
+    }
+  }
+
+  return tables;
+}
+
+inline constexpr Crc32Tables CRC32_TABLES = make_crc32_tables();
+
+}  // namespace detail
+
+/**
+ * \brief CRC-32 of \p data, as computed by zlib and PNG.
+ *
+ * Eight bytes are folded per step through as many tables, which breaks the byte-at-a-time
+ * dependency chain of the classic table-driven loop.
+ * \param crc The CRC of the preceding data, to checksum a sequence in several pieces.
+ */
+inline std::uint32_t crc32(bytes::ByteView data, std::uint32_t crc = 0) noexcept
+{
+  const auto &tables = detail::CRC32_TABLES;
+
+  auto first = data.data();
+  auto size = data.size();
+  crc = ~crc;
+
+  for (; size >= 8; first += 8, size -= 8)
+  {
+    auto word = unaligned_storage::detail::load_le64(first);
+    auto low = static_cast<std::uint32_t>(word) ^ crc;
+    auto high = static_cast<std::uint32_t>(word >> 32);
+
+    crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^
+        tables[4][low >> 24] ^ tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^
+        tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+  }
+
+  for (; size; first++, size--)
+  {
+    crc = (crc >> 8) ^ tables[0][(crc ^ std::to_integer<std::uint32_t>(*first)) & 0xFF];
+  }
+
+  return ~crc;
+}
+
+}  // namespace utils::checksum
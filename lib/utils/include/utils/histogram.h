@@ -0,0 +1,136 @@
+#pragma once
+
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace utils::histogram
+{
+
+/**
+ * \brief Occurrence count of every byte value.
+ */
+using Histogram = std::array<std::size_t, 256>;
+
+namespace detail
+{
+
+/**
+ * \brief Number of bytes counted into the 32-bit tables before they are folded into the result.
+ * Every table receives at most a quarter of a chunk, so no counter can overflow.
+ */
+static constexpr std::size_t CHUNK_SIZE = std::size_t{1} << 30;
+
+}  // namespace detail
+
+/**
+ * \brief Add the occurrences of every byte value within [first, last) to \p histogram, so that
+ * several ranges can be counted together.
+ *
+ * Consecutive bytes are often equal, and incrementing the same counter twice in a row stalls on
+ * store-to-load forwarding. Spreading the bytes over four interleaved tables keeps the increments
+ * independent; the tables are summed once the chunk is done.
+ */
+inline void accumulate(const std::byte *first, const std::byte *last, Histogram &histogram) noexcept
+{
+  std::array<std::array<std::uint32_t, 256>, 4> tables;
+
+  while (first != last)
+  {
+    auto chunk_last = first + std::min<std::size_t>(last - first, detail::CHUNK_SIZE);
+    for (auto &table : tables)
+    {
+      table.fill(0);
+    }
+
+    for (; chunk_last - first >= 4; first += 4)
+    {
+      tables[0][std::to_integer<std::uint8_t>(first[0])]++;
+      tables[1][std::to_integer<std::uint8_t>(first[1])]++;
+      tables[2][std::to_integer<std::uint8_t>(first[2])]++;
+      tables[3][std::to_integer<std::uint8_t>(first[3])]++;
+    }
+
+    for (; first != chunk_last; first++)
+    {
+      tables[0][std::to_integer<std::uint8_t>(*first)]++;
+    }
+
+    for (std::size_t i = 0; i < histogram.size(); i++)
+    {
+      histogram[i] += std::size_t{tables[0][i]} + tables[1][i] + tables[2][i] + tables[3][i];
+    }
+  }
+}
+
+/**
+ * \brief Inputs shorter than this, per thread, are not worth starting a thread for.
+ */
+static constexpr std::size_t MIN_BYTES_PER_THREAD = std::size_t{1} << 20;
+
+/**
+ * \brief Count every byte value within [first, last) on the calling thread.
+ */
+inline Histogram count(const std::byte *first, const std::byte *last) noexcept
+{
+  Histogram histogram{};
+  accumulate(first, last, histogram);
+
+  return histogram;
+}
+
+/**
+ * \brief Count every byte value within [first, last), splitting the input between up to
+ * \p max_threads threads of the shared pool.
+ *
+ * Each thread builds a partial histogram of its own slice, and the partials are merged once all of
+ * them are done. Fewer threads are used when the slices would be shorter than
+ * MIN_BYTES_PER_THREAD, so small inputs are counted on the calling thread only.
+ * \param max_threads The thread limit, the calling thread included. Zero selects the size of the
+ * shared pool.
+ */
+inline Histogram count_parallel(const std::byte *first, const std::byte *last,
+    std::size_t max_threads = 0)
+{
+  auto &pool = thread_pool::ThreadPool::shared();
+  if (max_threads == 0)
+  {
+    max_threads = pool.size();
+  }
+
+  std::size_t size = last - first;
+  std::size_t slices_count = std::clamp<std::size_t>(size / MIN_BYTES_PER_THREAD, 1, max_threads);
+  if (slices_count == 1)
+  {
+    return count(first, last);
+  }
+
+  std::vector<Histogram> partials(slices_count, Histogram{});
+  std::size_t slice_size = size / slices_count;
+
+  thread_pool::parallel_for(
+      pool, slices_count,
+      [&](std::size_t i) {
+        auto slice_first = first + i * slice_size;
+        auto slice_last = i + 1 == slices_count ? last : slice_first + slice_size;
+
+        accumulate(slice_first, slice_last, partials[i]);
+      },
+      slices_count - 1);
+
+  for (std::size_t i = 1; i < slices_count; i++)
+  {
+    for (std::size_t symbol = 0; symbol < partials[0].size(); symbol++)
+    {
+      partials[0][symbol] += partials[i][symbol];
+    }
+  }
+
+  return partials[0];
+}
+
+}  // namespace utils::histogram
@@ -0,0 +1,266 @@
+#pragma once
+
+#include "utils/bytes.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils::mapped_file
+{
+
+namespace detail
+{
+
+[[noreturn]] inline void throw_errno(const std::string &what)
+{
+  throw std::system_error{errno, std::generic_category(), what};
+}
+
+inline std::size_t page_size() noexcept
+{
+  static const auto size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+/**
+ * \brief Drop the whole pages of [data, data + size) from the mapping. The file keeps their
+ * content, and they are read back if accessed again.
+ */
+inline void release_pages(void *data, std::size_t size) noexcept
+{
+  if (auto length = size / page_size() * page_size())
+  {
+    ::madvise(data, length, MADV_DONTNEED);
+  }
+}
+
+}  // namespace detail
+
+/**
+ * \brief Read-only memory mapping of a whole file.
+ *
+ * The pages are read in on demand, straight from the page cache, with no intermediate buffer.
+ * Throws std::system_error if the file cannot be opened or mapped.
+ */
+class ReadOnlyFile
+{
+public:
+  explicit ReadOnlyFile(const std::string &path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      detail::throw_errno("cannot open " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0)
+    {
+      ::close(fd);
+      detail::throw_errno("cannot stat " + path);
+    }
+
+    size_ = static_cast<std::size_t>(st.st_size);
+
+    // An empty file cannot be mapped, and needs no mapping either.
+    if (size_)
+    {
+      data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data_ == MAP_FAILED)
+      {
+        ::close(fd);
+        detail::throw_errno("cannot map " + path);
+      }
+
+      ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+
+    ::close(fd);
+  }
+
+  ReadOnlyFile(const ReadOnlyFile &) = delete;
+  ReadOnlyFile &operator=(const ReadOnlyFile &) = delete;
+
+  ~ReadOnlyFile()
+  {
+    if (size_)
+    {
+      ::munmap(data_, size_);
+    }
+  }
+
+  utils::bytes::ByteView view() const noexcept
+  {
+    return {static_cast<const std::byte *>(data_), size_};
+  }
+
+  /**
+   * \brief Have the kernel start reading the \p size bytes at \p offset in the background, so that
+   * they are in the page cache by the time they are accessed.
+   */
+  void prefetch(std::size_t offset, std::size_t size) const noexcept
+  {
+    if (offset < size_)
+    {
+      auto begin = offset / detail::page_size() * detail::page_size();
+      auto end = offset + std::min(size, size_ - offset);
+      ::madvise(static_cast<std::byte *>(data_) + begin, end - begin, MADV_WILLNEED);
+    }
+  }
+
+  /**
+   * \brief Release the pages holding the first \p size bytes, once they have been consumed, so that
+   * reading the file sequentially keeps a bounded resident memory.
+   */
+  void release(std::size_t size) noexcept
+  {
+    if (size_)
+    {
+      detail::release_pages(data_, std::min(size, size_));
+    }
+  }
+
+private:
+  void *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+/**
+ * \brief File written through a shared memory mapping.
+ *
+ * The file is sized up front to the expected output size; appending past it grows the file and the
+ * mapping geometrically. Closing the file truncates it to the bytes actually written. The pages
+ * behind the write position are released every RELEASE_WINDOW bytes, so that the resident memory
+ * does not grow with the file.
+ * Throws std::system_error if the file cannot be created, resized or mapped, running out of disk
+ * space included.
+ */
+class WritableFile
+{
+public:
+  WritableFile(const std::string &path, std::size_t expected_size) : path_{path}
+  {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+    {
+      detail::throw_errno("cannot create " + path);
+    }
+
+    try
+    {
+      remap(std::max(expected_size, MIN_CAPACITY));
+    }
+    catch (...)
+    {
+      ::close(fd_);
+      throw;
+    }
+  }
+
+  WritableFile(const WritableFile &) = delete;
+  WritableFile &operator=(const WritableFile &) = delete;
+
+  ~WritableFile()
+  {
+    if (fd_ >= 0)
+    {
+      unmap();
+      ::ftruncate(fd_, static_cast<off_t>(size_));
+      ::close(fd_);
+    }
+  }
+
+  void write(utils::bytes::ByteView bytes)
+  {
+    if (size_ + bytes.size() > capacity_)
+    {
+      remap(std::max(capacity_ * 2, size_ + bytes.size()));
+    }
+
+    std::memcpy(static_cast<std::byte *>(data_) + size_, bytes.data(), bytes.size());
+    size_ += bytes.size();
+
+    if (size_ - released_ >= RELEASE_WINDOW)
+    {
+      detail::release_pages(data_, size_);
+      released_ = size_;
+    }
+  }
+
+  /**
+   * \brief The number of bytes written so far.
+   */
+  std::size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  /**
+   * \brief Unmap the file and truncate it to the bytes written.
+   */
+  void close()
+  {
+    unmap();
+
+    if (::ftruncate(fd_, static_cast<off_t>(size_)) < 0)
+    {
+      detail::throw_errno("cannot truncate " + path_);
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+private:
+  static constexpr std::size_t MIN_CAPACITY = 4096;
+  static constexpr std::size_t RELEASE_WINDOW = std::size_t{4} << 20;
+
+  void unmap() noexcept
+  {
+    if (data_)
+    {
+      ::munmap(data_, capacity_);
+      data_ = nullptr;
+    }
+  }
+
+  void remap(std::size_t capacity)
+  {
+    unmap();
+
+    // A file grown by ftruncate() is sparse, and a full disk would only show as a SIGBUS when
+    // writing through the mapping: the blocks are reserved instead.
+    auto reserved = static_cast<off_t>(capacity_);
+    if (auto error = ::posix_fallocate(fd_, reserved, static_cast<off_t>(capacity) - reserved))
+    {
+      throw std::system_error{error, std::generic_category(), "cannot resize " + path_};
+    }
+
+    auto data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED)
+    {
+      detail::throw_errno("cannot map " + path_);
+    }
+
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  std::string path_;
+  int fd_ = -1;
+  void *data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = 0;
+  std::size_t released_ = 0;
+};
+
+}  // namespace utils::mapped_file
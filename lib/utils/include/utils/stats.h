@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Hot-path statistics of the codecs: per-phase timers, counters and histograms.
+ *
+ * The recording functions only do something in the builds defining COMPRESSION_STATS, which
+ * `bazel build --define stats=on` does. Otherwise they are empty inline functions, and the code
+ * computing their arguments is either trivial or guarded by `if constexpr (stats::ENABLED)`, so the
+ * instrumentation compiles out entirely.
+ */
+namespace utils::stats
+{
+
+#ifdef COMPRESSION_STATS
+inline constexpr bool ENABLED = true;
+#else
+inline constexpr bool ENABLED = false;
+#endif
+
+/**
+ * \brief The heap allocations made so far. They are counted by the operator new of
+ * src/counting_new.cpp, in the builds defining COMPRESSION_STATS and the binaries linking it in.
+ */
+inline std::atomic<std::uint64_t> allocations_count{0};
+inline std::atomic<std::uint64_t> allocated_bytes{0};
+
+/**
+ * \brief Named timers, counters and histograms, shared by every thread.
+ *
+ * The codecs record into it once per call or per phase, never per symbol, so a single lock is
+ * enough.
+ */
+class Registry
+{
+public:
+  struct Timer
+  {
+    std::uint64_t calls = 0;
+    std::chrono::nanoseconds total{0};
+  };
+
+  using Histogram = std::vector<std::uint64_t>;
+
+  void add_time(std::string_view timer, std::chrono::nanoseconds elapsed)
+  {
+    std::lock_guard lock{mutex_};
+
+    auto &entry = get(timers_, timer);
+    entry.calls++;
+    entry.total += elapsed;
+  }
+
+  void add(std::string_view counter, std::uint64_t value)
+  {
+    std::lock_guard lock{mutex_};
+    get(counters_, counter) += value;
+  }
+
+  /**
+   * \brief Raise \p counter to \p value, if lower. For the peaks, such as the largest dictionary.
+   */
+  void maximum(std::string_view counter, std::uint64_t value)
+  {
+    std::lock_guard lock{mutex_};
+
+    auto &entry = get(counters_, counter);
+    entry = std::max(entry, value);
+  }
+
+  void add_to_histogram(std::string_view histogram, std::size_t bucket, std::uint64_t value)
+  {
+    std::lock_guard lock{mutex_};
+
+    auto &entry = get(histograms_, histogram);
+    if (entry.size() <= bucket)
+    {
+      entry.resize(bucket + 1);
+    }
+
+    entry[bucket] += value;
+  }
+
+  /**
+   * \brief Report \p name as the quotient of two counters, such as the bits per symbol: averages
+   * over several calls cannot be recorded as such, but are derived from the totals.
+   */
+  void ratio(std::string_view name, std::string_view numerator, std::string_view denominator)
+  {
+    std::lock_guard lock{mutex_};
+
+    auto &terms = get(ratios_, name);
+    if (terms.first != numerator || terms.second != denominator)
+    {
+      terms = {std::string{numerator}, std::string{denominator}};
+    }
+  }
+
+  Timer timer(std::string_view name) const
+  {
+    std::lock_guard lock{mutex_};
+
+    auto it = timers_.find(name);
+    return it == timers_.end() ? Timer{} : it->second;
+  }
+
+  std::uint64_t counter(std::string_view name) const
+  {
+    std::lock_guard lock{mutex_};
+
+    auto it = counters_.find(name);
+    return it == counters_.end() ? 0 : it->second;
+  }
+
+  Histogram histogram(std::string_view name) const
+  {
+    std::lock_guard lock{mutex_};
+
+    auto it = histograms_.find(name);
+    return it == histograms_.end() ? Histogram{} : it->second;
+  }
+
+  void reset()
+  {
+    std::lock_guard lock{mutex_};
+
+    timers_.clear();
+    counters_.clear();
+    histograms_.clear();
+    ratios_.clear();
+  }
+
+  void write_json(std::ostream &out) const
+  {
+    std::lock_guard lock{mutex_};
+
+    out << "{\n  \"timers\": {";
+    write_entries(out, timers_, [&out](const Timer &timer) {
+      out << "{\"calls\": " << timer.calls
+          << ", \"seconds\": " << std::chrono::duration<double>(timer.total).count() << "}";
+    });
+
+    out << "},\n  \"counters\": {";
+    write_entries(out, counters_, [&out](std::uint64_t value) { out << value; });
+
+    out << "},\n  \"ratios\": {";
+    write_entries(out, ratios_, [this, &out](const std::pair<std::string, std::string> &terms) {
+      auto numerator = counters_.find(terms.first);
+      auto denominator = counters_.find(terms.second);
+
+      if (numerator == counters_.end() || denominator == counters_.end() || !denominator->second)
+      {
+        out << "null";
+        return;
+      }
+
+      out << double(numerator->second) / double(denominator->second);
+    });
+
+    out << "},\n  \"histograms\": {";
+    write_entries(out, histograms_, [&out](const Histogram &histogram) {
+      out << "[";
+      for (std::size_t i = 0; i < histogram.size(); i++)
+      {
+        out << (i ? ", " : "") << histogram[i];
+      }
+      out << "]";
+    });
+
+    out << "},\n  \"allocations\": {\"count\": " << allocations_count.load()
+        << ", \"bytes\": " << allocated_bytes.load() << "}\n}\n";
+  }
+
+private:
+  template <class T>
+  using Entries = std::map<std::string, T, std::less<>>;
+
+  template <class T>
+  static T &get(Entries<T> &entries, std::string_view name)
+  {
+    auto it = entries.find(name);
+    if (it == entries.end())
+    {
+      it = entries.emplace(std::string{name}, T{}).first;
+    }
+
+    return it->second;
+  }
+
+  template <class T, class WriteValue>
+  static void write_entries(std::ostream &out, const Entries<T> &entries, WriteValue &&write_value)
+  {
+    bool first = true;
+    for (const auto &[name, value] : entries)
+    {
+      out << (first ? "\n    \"" : ",\n    \"") << name << "\": ";
+      write_value(value);
+      first = false;
+    }
+
+    if (!entries.empty())
+    {
+      out << "\n  ";
+    }
+  }
+
+  mutable std::mutex mutex_;
+  Entries<Timer> timers_;
+  Entries<std::uint64_t> counters_;
+  Entries<Histogram> histograms_;
+  Entries<std::pair<std::string, std::string>> ratios_;
+};
+
+/**
+ * \brief The registry the codecs record into.
+ */
+inline Registry &registry()
+{
+  static Registry instance;
+  return instance;
+}
+
+inline void add(std::string_view counter, std::uint64_t value)
+{
+  if constexpr (ENABLED)
+  {
+    registry().add(counter, value);
+  }
+}
+
+inline void maximum(std::string_view counter, std::uint64_t value)
+{
+  if constexpr (ENABLED)
+  {
+    registry().maximum(counter, value);
+  }
+}
+
+inline void add_to_histogram(std::string_view histogram, std::size_t bucket, std::uint64_t value)
+{
+  if constexpr (ENABLED)
+  {
+    registry().add_to_histogram(histogram, bucket, value);
+  }
+}
+
+inline void ratio(std::string_view name, std::string_view numerator, std::string_view denominator)
+{
+  if constexpr (ENABLED)
+  {
+    registry().ratio(name, numerator, denominator);
+  }
+}
+
+/**
+ * \brief Times consecutive phases: the current phase is recorded when next() starts the following
+ * one, and the last one when the timer goes out of scope.
+ */
+class PhaseTimer
+{
+public:
+  explicit PhaseTimer(std::string_view phase) noexcept : phase_{phase}
+  {
+    if constexpr (ENABLED)
+    {
+      start_ = Clock::now();
+    }
+  }
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  ~PhaseTimer()
+  {
+    stop();
+  }
+
+  void next(std::string_view phase)
+  {
+    stop();
+
+    phase_ = phase;
+    if constexpr (ENABLED)
+    {
+      start_ = Clock::now();
+    }
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  void stop()
+  {
+    if constexpr (ENABLED)
+    {
+      registry().add_time(phase_, Clock::now() - start_);
+    }
+  }
+
+  std::string_view phase_;
+  Clock::time_point start_;
+};
+
+}  // namespace utils::stats
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils::thread_pool
+{
+
+/**
+ * \brief Fixed set of worker threads running the submitted tasks in FIFO order.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * \param threads_count The number of workers. Zero selects the number of hardware threads.
+   */
+  explicit ThreadPool(std::size_t threads_count = 0)
+  {
+    if (threads_count == 0)
+    {
+      threads_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workers_.reserve(threads_count);
+    for (std::size_t i = 0; i < threads_count; i++)
+    {
+      workers_.emplace_back([this] { work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * \brief Run the tasks already submitted, then join the workers.
+   */
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard lock{mutex_};
+      stopping_ = true;
+    }
+
+    cv_.notify_all();
+    for (auto &worker : workers_)
+    {
+      worker.join();
+    }
+  }
+
+  /**
+   * \brief The pool shared by the whole process, with one worker per hardware thread.
+   */
+  static ThreadPool &shared()
+  {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  /**
+   * \brief The pool without workers: its tasks run right away on the submitting thread, and
+   * parallel_for runs every item on the calling thread.
+   */
+  static ThreadPool &calling_thread()
+  {
+    static ThreadPool pool{NoWorkers{}};
+    return pool;
+  }
+
+  void submit(std::function<void()> task)
+  {
+    if (workers_.empty())
+    {
+      task();
+      return;
+    }
+
+    {
+      std::lock_guard lock{mutex_};
+      tasks_.push_back(std::move(task));
+    }
+
+    cv_.notify_one();
+  }
+
+  std::size_t size() const noexcept
+  {
+    return workers_.size();
+  }
+
+private:
+  struct NoWorkers
+  {};
+
+  explicit ThreadPool(NoWorkers) noexcept
+  {}
+
+  void work()
+  {
+    for (;;)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+
+        if (tasks_.empty())
+        {
+          return;
+        }
+
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+/**
+ * \brief Call \p f(i) for every i in [0, count), on the calling thread and up to \p max_helpers
+ * workers of \p pool.
+ *
+ * The indices are claimed one at a time, so uneven items balance out. The calling thread takes part
+ * and only waits for the items already claimed by the helpers, never for a helper still queued
+ * behind other tasks. This makes nested calls from within pool tasks safe.
+ * If some calls throw, the first exception is rethrown once all items are done.
+ */
+template <class Function>
+void parallel_for(ThreadPool &pool, std::size_t count, Function &&f,
+    std::size_t max_helpers = static_cast<std::size_t>(-1))
+{
+  struct State
+  {
+    std::atomic<std::size_t> next{0};
+    std::size_t done = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+
+  auto state = std::make_shared<State>();
+
+  // Helpers dereference f only after claiming an index, which cannot happen once all are done.
+  auto run = [state, count, &f] {
+    for (std::size_t i; (i = state->next++) < count;)
+    {
+      std::exception_ptr error;
+      try
+      {
+        f(i);
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+
+      std::lock_guard lock{state->mutex};
+      if (error && !state->error)
+      {
+        state->error = error;
+      }
+
+      if (++state->done == count)
+      {
+        state->cv.notify_all();
+      }
+    }
+  };
+
+  auto helpers_count = std::min({pool.size(), max_helpers, count ? count - 1 : 0});
+  for (std::size_t i = 0; i < helpers_count; i++)
+  {
+    pool.submit(run);
+  }
+
+  run();
+
+  std::unique_lock lock{state->mutex};
+  state->cv.wait(lock, [&] { return state->done == count; });
+
+  if (state->error)
+  {
+    std::rethrow_exception(state->error);
+  }
+}
+
+}  // namespace utils::thread_pool
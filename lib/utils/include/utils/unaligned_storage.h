@@ -1,7 +1,12 @@
 #pragma once
 
+#include "utils/bytes.h"
+
+#include <algorithm>
 #include <bitset>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <memory>
 #include <type_traits>
@@ -78,7 +83,7 @@ public:
     T val = T(0);
     for (std::size_t i = 0; i < bits_count; i++)
     {
-      val |= (read() << i);
+      val |= (T(read()) << i);
     }
 
     return val;
@@ -94,4 +99,346 @@ private:
   std::uint8_t bit_idx_;
 };
 
+namespace detail
+{
+
+  inline std::uint64_t load_le64(const std::byte *src) noexcept
+  {
+    std::uint64_t val;
+    std::memcpy(&val, src, sizeof(val));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    val = __builtin_bswap64(val);
+#endif
+    return val;
+  }
+
+  inline void store_le64(std::byte *dst, std::uint64_t val) noexcept
+  {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    val = __builtin_bswap64(val);
+#endif
+    std::memcpy(dst, &val, sizeof(val));
+  }
+
+  constexpr std::uint64_t low_bits(std::size_t bits_count) noexcept
+  {
+    return bits_count >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits_count) - 1;
+  }
+
+}  // namespace detail
+
+/**
+ * \brief Bulk counterpart of Writer, producing the same LSB-first layout.
+ *
+ * Bits are gathered in a 64-bit accumulator and moved to the container a whole word at a time.
+ * The container is grown ahead in large steps, so it holds unwritten slack bytes until flush().
+ * The destructor flushes a writer left with pending bits, where a failure to grow the container
+ * terminates the program; call flush() explicitly to get the exception instead.
+ *
+ * A utils::bytes::FixedBuffer cannot grow: the last words are then stored a byte at a time, and the
+ * buffer overflows if they do not fit.
+ *
+ * write() only adds to the accumulator: the caller may write up to 64 - 7 = 57 bits before calling
+ * commit(). operator() does both.
+ */
+template <class Container>
+class BitWriter
+{
+  using ValueType = typename Container::value_type;
+
+public:
+  explicit BitWriter(Container &c) : container_{std::addressof(c)}, pos_{c.size()}
+  {
+    static_assert(sizeof(ValueType) == 1);
+  }
+
+  BitWriter(const BitWriter &) = delete;
+  BitWriter &operator=(const BitWriter &) = delete;
+
+  ~BitWriter()
+  {
+    if (!flushed_ || count_)
+    {
+      flush();
+    }
+  }
+
+  void write(std::uint64_t bits, std::size_t bits_count) noexcept
+  {
+    acc_ |= (bits & detail::low_bits(bits_count)) << count_;
+    count_ += bits_count;
+  }
+
+  /**
+   * \brief Move the whole bytes of the accumulator to the container.
+   */
+  void commit()
+  {
+    flushed_ = false;
+    if (pos_ + sizeof(acc_) > container_->size())
+    {
+      grow();
+    }
+
+    auto bytes_count = count_ >> 3;
+    if (pos_ + sizeof(acc_) <= container_->size())
+    {
+      detail::store_le64(reinterpret_cast<std::byte *>(container_->data()) + pos_, acc_);
+    }
+    else
+    {
+      store_tail(bytes_count);
+    }
+
+    pos_ += bytes_count;
+    acc_ = bytes_count == sizeof(acc_) ? 0 : acc_ >> (bytes_count << 3);
+    count_ &= 7;
+  }
+
+  void operator()(std::uint64_t bits, std::size_t bits_count)
+  {
+    write(bits, bits_count);
+    commit();
+  }
+
+  /**
+   * \brief Write the pending bits, padding the last byte with zeros, and trim the slack.
+   */
+  void flush()
+  {
+    commit();
+
+    if (count_)
+    {
+      store_tail(1);
+      pos_++;
+      acc_ = count_ = 0;
+    }
+
+    container_->resize(pos_);
+    flushed_ = true;
+  }
+
+private:
+  static constexpr std::size_t MIN_GROWTH = 4096;
+
+  /**
+   * \brief Make room for the next word, within the capacity reserved by the caller if possible.
+   */
+  void grow()
+  {
+    auto required = pos_ + sizeof(acc_);
+    if (required <= container_->capacity() || std::is_same_v<Container, bytes::FixedBuffer>)
+    {
+      container_->resize(container_->capacity());
+    }
+    else
+    {
+      container_->resize(std::max(container_->size() * 2, required + MIN_GROWTH));
+    }
+  }
+
+  /**
+   * \brief Store the \p bytes_count low bytes of the accumulator alone, as far as they fit.
+   */
+  void store_tail(std::size_t bytes_count)
+  {
+    auto room = pos_ < container_->size() ? container_->size() - pos_ : 0;
+    if (bytes_count > room)
+    {
+      container_->resize(pos_ + bytes_count);
+      bytes_count = room;
+    }
+
+    // A buffer over an empty view has no data to offset, even by zero.
+    if (bytes_count == 0)
+    {
+      return;
+    }
+
+    std::byte word[sizeof(acc_)];
+    detail::store_le64(word, acc_);
+    std::memcpy(reinterpret_cast<std::byte *>(container_->data()) + pos_, word, bytes_count);
+  }
+
+  Container *container_;
+  std::size_t pos_;
+  std::uint64_t acc_{0};
+  std::size_t count_{0};
+  bool flushed_{true};  ///< Only commit() leaves bytes or slack to flush.
+};
+
+/**
+ * \brief Bulk counterpart of Reader, over the same LSB-first layout.
+ *
+ * The next bits of the stream are kept in a 64-bit buffer. refill() tops it up to at least 56 bits
+ * with a single unaligned load while 8 bytes remain, so up to 56 bits may be peeked at and consumed
+ * between refills. Reading past the end yields zero bits.
+ */
+class BitReader
+{
+public:
+  BitReader(const std::byte *first, const std::byte *last) noexcept : it_{first}, last_{last}
+  {
+    refill();
+  }
+
+  void refill() noexcept
+  {
+    if (last_ - it_ >= 8)
+    {
+      buffer_ |= detail::load_le64(it_) << count_;
+      it_ += (63 - count_) >> 3;
+      count_ |= 56;
+
+      return;
+    }
+
+    for (; count_ <= 56; count_ += 8)
+    {
+      if (it_ != last_)
+      {
+        buffer_ |= std::to_integer<std::uint64_t>(*it_++) << count_;
+      }
+    }
+  }
+
+  std::uint64_t peek(std::size_t bits_count) const noexcept
+  {
+    return buffer_ & detail::low_bits(bits_count);
+  }
+
+  void consume(std::size_t bits_count) noexcept
+  {
+    buffer_ >>= bits_count;
+    count_ -= bits_count;
+  }
+
+  /**
+   * \brief Peek at and consume \p bits_count bits, refilling first if needed.
+   */
+  std::uint64_t read(std::size_t bits_count) noexcept
+  {
+    if (count_ < bits_count)
+    {
+      refill();
+    }
+
+    auto bits = peek(bits_count);
+    consume(bits_count);
+
+    return bits;
+  }
+
+private:
+  const std::byte *it_;
+  const std::byte *last_;
+  std::uint64_t buffer_{0};
+  std::size_t count_{0};
+};
+
+/**
+ * \brief Reads the bits written by a BitWriter backwards: every read returns the latest bits not
+ * read yet, as they were written.
+ *
+ * The writer ends the stream with a single 1 bit, so that the reader finds where it stops within
+ * the last byte. The bits are read from the top of a 64-bit window over the stream, which refill()
+ * moves back with a single unaligned load, so that up to 56 bits may be read between refills.
+ * Reading past the beginning of the stream leaves overrun() set.
+ */
+class ReverseBitReader
+{
+public:
+  ReverseBitReader(const std::byte *first, const std::byte *last) noexcept :
+      first_{first}, window_start_{first}
+  {
+    std::size_t size = last - first;
+    auto end = size ? std::to_integer<std::uint8_t>(first[size - 1]) : 0;
+
+    // A missing end marker leaves nothing to read.
+    if (!end)
+    {
+      bits_left_ = -1;
+      return;
+    }
+
+    auto marker = bits_below(end);
+    bits_left_ = std::int64_t(size - 1) * 8 + marker;
+    consumed_ = 8 - marker;
+
+    if (size >= sizeof(window_))
+    {
+      window_start_ = last - sizeof(window_);
+      window_ = detail::load_le64(window_start_);
+      return;
+    }
+
+    // A stream shorter than the window sits at its top, above zero bits.
+    for (std::size_t i = 0; i < size; i++)
+    {
+      window_ |= std::to_integer<std::uint64_t>(first[i]) << ((sizeof(window_) - size + i) * 8);
+    }
+  }
+
+  /**
+   * \brief Move the window back over the bits read, as far as the beginning of the stream.
+   */
+  void refill() noexcept
+  {
+    auto back = std::min<std::size_t>(consumed_ >> 3, window_start_ - first_);
+    if (back)
+    {
+      window_start_ -= back;
+      consumed_ -= back * 8;
+      window_ = detail::load_le64(window_start_);
+    }
+  }
+
+  /**
+   * \brief Read the \p bits_count bits written right before the ones read last.
+   */
+  std::uint64_t read(std::size_t bits_count) noexcept
+  {
+    auto bits = ((window_ << (consumed_ & 63)) >> 1) >> (63 - bits_count);
+    consumed_ += bits_count;
+    bits_left_ -= std::int64_t(bits_count);
+
+    return bits;
+  }
+
+  /**
+   * \brief Whether every bit of the stream has been read, and no more.
+   */
+  bool finished() const noexcept
+  {
+    return bits_left_ == 0;
+  }
+
+  bool overrun() const noexcept
+  {
+    return bits_left_ < 0;
+  }
+
+private:
+  /**
+   * \brief The position of the highest 1 bit of \p byte.
+   */
+  static std::size_t bits_below(std::uint8_t byte) noexcept
+  {
+    std::size_t position = 0;
+    while (byte >>= 1)
+    {
+      position++;
+    }
+
+    return position;
+  }
+
+  const std::byte *first_;
+  const std::byte *window_start_;
+  std::uint64_t window_{0};
+  std::size_t consumed_{0};
+  std::int64_t bits_left_{0};
+};
+
 }  // namespace utils::unaligned_storage
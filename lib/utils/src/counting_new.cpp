@@ -0,0 +1,54 @@
+#include "utils/stats.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/*
+ * The replaceable global allocation functions, counting the allocations into
+ * stats::allocations_count and stats::allocated_bytes. The sized and array deallocation forms are
+ * replaced as well: the standard library may implement them with something else than free(), which
+ * would not match the malloc() below. The nothrow forms are left to the standard library, which
+ * implements them on top of these.
+ *
+ * This file is the //lib/utils:counting_new target, linked into the builds defining
+ * COMPRESSION_STATS and into the binaries measuring their own allocations.
+ */
+
+void *operator new(std::size_t size)
+{
+  utils::stats::allocations_count.fetch_add(1, std::memory_order_relaxed);
+  utils::stats::allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  if (auto *ptr = std::malloc(size ? size : 1))
+  {
+    return ptr;
+  }
+
+  throw std::bad_alloc{};
+}
+
+void *operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
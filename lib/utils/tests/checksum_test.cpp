@@ -0,0 +1,63 @@
+#include "utils/bytes.h"
+#include "utils/checksum.h"
+
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace utils::checksum
+{
+
+namespace
+{
+
+std::uint32_t bitwise_crc32(const bytes::ByteSequence &data)
+{
+  std::uint32_t crc = ~0u;
+  for (auto byte : data)
+  {
+    crc ^= std::to_integer<std::uint32_t>(byte);
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+  }
+
+  return ~crc;
+}
+
+}  // namespace
+
+TEST(Crc32, KnownValues)
+{
+  EXPECT_EQ(crc32(bytes::ByteSequence{}), 0u);
+  EXPECT_EQ(crc32(bytes::to_byte_array(std::string{"123456789"})), 0xCBF43926u);
+  EXPECT_EQ(crc32(bytes::to_byte_array(std::string{"The quick brown fox jumps over the lazy dog"})),
+      0x414FA339u);
+}
+
+TEST(Crc32, MatchesBitwise)
+{
+  bytes::ByteSequence data;
+  for (std::size_t size = 0; size < 100; size++)
+  {
+    SCOPED_TRACE(size);
+
+    EXPECT_EQ(crc32(data), bitwise_crc32(data));
+    data.push_back(std::byte(size * 37 + 11));
+  }
+}
+
+TEST(Crc32, Incremental)
+{
+  auto data = bytes::to_byte_array(std::string{"incremental checksums of a split input"});
+  bytes::ByteView view{data};
+
+  for (std::size_t split = 0; split <= view.size(); split++)
+  {
+    EXPECT_EQ(crc32(view.subspan(split), crc32(view.first(split))), crc32(view));
+  }
+}
+
+}  // namespace utils::checksum
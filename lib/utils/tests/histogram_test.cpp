@@ -0,0 +1,72 @@
+#include "utils/histogram.h"
+
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace utils::histogram
+{
+
+namespace
+{
+
+std::vector<std::byte> random_bytes(std::size_t size)
+{
+  std::mt19937 gen{3};
+  std::geometric_distribution<int> byte_dist(0.05);
+
+  std::vector<std::byte> bytes(size);
+  for (auto &b : bytes)
+  {
+    b = std::byte(byte_dist(gen));
+  }
+
+  return bytes;
+}
+
+Histogram naive_count(const std::vector<std::byte> &bytes)
+{
+  Histogram histogram{};
+  for (auto b : bytes)
+  {
+    histogram[std::to_integer<std::size_t>(b)]++;
+  }
+
+  return histogram;
+}
+
+}  // namespace
+
+TEST(Histogram, Count)
+{
+  for (std::size_t size : {0, 1, 3, 4, 5, 1000})
+  {
+    auto bytes = random_bytes(size);
+    EXPECT_EQ(count(bytes.data(), bytes.data() + bytes.size()), naive_count(bytes));
+  }
+}
+
+TEST(Histogram, AccumulateRanges)
+{
+  auto bytes = random_bytes(1000);
+
+  // Qualified, since std::accumulate is found by argument-dependent lookup on std::byte.
+  Histogram histogram{};
+  histogram::accumulate(bytes.data(), bytes.data() + 3, histogram);
+  histogram::accumulate(bytes.data() + 3, bytes.data() + bytes.size(), histogram);
+  EXPECT_EQ(histogram, naive_count(bytes));
+}
+
+TEST(Histogram, CountParallel)
+{
+  auto bytes = random_bytes(4 * MIN_BYTES_PER_THREAD + 7);
+  auto expected = naive_count(bytes);
+
+  for (std::size_t threads : {0, 1, 2, 3, 8})
+  {
+    EXPECT_EQ(count_parallel(bytes.data(), bytes.data() + bytes.size(), threads), expected);
+  }
+}
+
+}  // namespace utils::histogram
@@ -0,0 +1,60 @@
+#include "utils/mapped_file.h"
+
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace utils::mapped_file
+{
+
+TEST(MappedFile, WriteThenRead)
+{
+  auto path = testing::TempDir() + "mapped_file_test";
+
+  std::vector<std::byte> expected;
+  {
+    // Expect less than is written, so that the file has to grow.
+    WritableFile file{path, 100};
+    for (std::size_t i = 0; i < 10000; i++)
+    {
+      std::byte chunk[]{std::byte(i), std::byte(i >> 8), std::byte(7)};
+      file.write(chunk);
+      expected.insert(expected.end(), std::begin(chunk), std::end(chunk));
+    }
+
+    EXPECT_EQ(file.size(), expected.size());
+    file.close();
+  }
+
+  EXPECT_EQ(std::filesystem::file_size(path), expected.size());
+
+  ReadOnlyFile file{path};
+  auto view = file.view();
+  EXPECT_EQ(std::vector<std::byte>(view.begin(), view.end()), expected);
+
+  file.release(view.size());
+  EXPECT_EQ(std::vector<std::byte>(view.begin(), view.end()), expected);
+
+  std::filesystem::remove(path);
+}
+
+TEST(MappedFile, Empty)
+{
+  auto path = testing::TempDir() + "mapped_file_empty_test";
+  WritableFile{path, 4096};
+
+  EXPECT_EQ(std::filesystem::file_size(path), 0u);
+  EXPECT_TRUE(ReadOnlyFile{path}.view().empty());
+
+  std::filesystem::remove(path);
+}
+
+TEST(MappedFile, Missing)
+{
+  EXPECT_THROW(ReadOnlyFile{testing::TempDir() + "missing/file"}, std::system_error);
+}
+
+}  // namespace utils::mapped_file
@@ -0,0 +1,112 @@
+#include "utils/stats.h"
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils::stats
+{
+
+TEST(Registry, Counters)
+{
+  Registry registry;
+
+  registry.add("codes", 3);
+  registry.add("codes", 4);
+  registry.maximum("entries", 10);
+  registry.maximum("entries", 7);
+
+  EXPECT_EQ(registry.counter("codes"), 7u);
+  EXPECT_EQ(registry.counter("entries"), 10u);
+  EXPECT_EQ(registry.counter("missing"), 0u);
+
+  registry.reset();
+  EXPECT_EQ(registry.counter("codes"), 0u);
+}
+
+TEST(Registry, TimersAndHistograms)
+{
+  Registry registry;
+
+  registry.add_time("phase", std::chrono::nanoseconds{100});
+  registry.add_time("phase", std::chrono::nanoseconds{50});
+  registry.add_to_histogram("lengths", 3, 2);
+  registry.add_to_histogram("lengths", 1, 1);
+  registry.add_to_histogram("lengths", 3, 1);
+
+  EXPECT_EQ(registry.timer("phase").calls, 2u);
+  EXPECT_EQ(registry.timer("phase").total, std::chrono::nanoseconds{150});
+  EXPECT_EQ(registry.histogram("lengths"), (Registry::Histogram{0, 1, 0, 3}));
+}
+
+TEST(Registry, ConcurrentRecording)
+{
+  Registry registry;
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < 4; i++)
+  {
+    threads.emplace_back([&registry] {
+      for (std::size_t n = 0; n < 1000; n++)
+      {
+        registry.add("calls", 1);
+      }
+    });
+  }
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  EXPECT_EQ(registry.counter("calls"), 4000u);
+}
+
+TEST(Registry, Json)
+{
+  Registry registry;
+
+  registry.add_time("huffman.encode.tree", std::chrono::seconds{2});
+  registry.add("huffman.payload_bits", 30);
+  registry.add("huffman.symbols", 10);
+  registry.ratio("huffman.bits_per_symbol", "huffman.payload_bits", "huffman.symbols");
+  registry.ratio("lzw.phrase_length", "lzw.raw_bytes", "lzw.codes");
+  registry.add_to_histogram("huffman.code_lengths", 2, 5);
+
+  std::ostringstream out;
+  registry.write_json(out);
+  auto json = out.str();
+
+  EXPECT_NE(
+      json.find("\"huffman.encode.tree\": {\"calls\": 1, \"seconds\": 2}"), std::string::npos);
+  EXPECT_NE(json.find("\"huffman.symbols\": 10"), std::string::npos);
+  EXPECT_NE(json.find("\"huffman.bits_per_symbol\": 3"), std::string::npos);
+  EXPECT_NE(json.find("\"lzw.phrase_length\": null"), std::string::npos);
+  EXPECT_NE(json.find("\"huffman.code_lengths\": [0, 0, 5]"), std::string::npos);
+  EXPECT_NE(json.find("\"allocations\": {\"count\": "), std::string::npos);
+}
+
+TEST(PhaseTimer, RecordsOnlyWhenEnabled)
+{
+  registry().reset();
+
+  {
+    PhaseTimer timer{"test.first"};
+    timer.next("test.second");
+  }
+
+  add("test.counter", 1);
+
+  std::uint64_t expected_calls = ENABLED ? 1 : 0;
+  EXPECT_EQ(registry().timer("test.first").calls, expected_calls);
+  EXPECT_EQ(registry().timer("test.second").calls, expected_calls);
+  EXPECT_EQ(registry().counter("test.counter"), expected_calls);
+
+  registry().reset();
+}
+
+}  // namespace utils::stats
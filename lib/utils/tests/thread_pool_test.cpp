@@ -0,0 +1,72 @@
+#include "utils/thread_pool.h"
+
+#include "gtest/gtest.h"
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace utils::thread_pool
+{
+
+TEST(ThreadPool, ParallelFor)
+{
+  ThreadPool pool{4};
+  std::vector<std::size_t> squares(1000, 0);
+
+  parallel_for(pool, squares.size(), [&](std::size_t i) { squares[i] = i * i; });
+
+  for (std::size_t i = 0; i < squares.size(); i++)
+  {
+    EXPECT_EQ(squares[i], i * i);
+  }
+}
+
+TEST(ThreadPool, NestedParallelFor)
+{
+  // Every worker blocks in an inner loop, which must not wait for helpers that never get to run.
+  ThreadPool pool{2};
+  std::atomic<std::size_t> calls{0};
+
+  parallel_for(pool, 8, [&](std::size_t) {
+    parallel_for(pool, 8, [&](std::size_t) { calls++; });
+  });
+
+  EXPECT_EQ(calls, 64u);
+}
+
+TEST(ThreadPool, CallingThreadOnly)
+{
+  auto &pool = ThreadPool::calling_thread();
+  EXPECT_EQ(pool.size(), 0u);
+
+  auto caller = std::this_thread::get_id();
+  std::atomic<std::size_t> foreign_calls{0};
+
+  auto record = [&] { foreign_calls += std::this_thread::get_id() != caller; };
+
+  parallel_for(pool, 16, [&](std::size_t) { record(); });
+  pool.submit(record);
+
+  EXPECT_EQ(foreign_calls, 0u);
+}
+
+TEST(ThreadPool, RethrowsException)
+{
+  ThreadPool pool{2};
+  std::atomic<std::size_t> calls{0};
+
+  auto throwing = [&](std::size_t i) {
+    calls++;
+    if (i == 3)
+    {
+      throw std::runtime_error{"item 3"};
+    }
+  };
+
+  EXPECT_THROW(parallel_for(pool, 10, throwing), std::runtime_error);
+  EXPECT_EQ(calls, 10u);
+}
+
+}  // namespace utils::thread_pool
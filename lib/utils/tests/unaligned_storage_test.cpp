@@ -1,10 +1,14 @@
+#include "utils/bytes.h"
 #include "utils/unaligned_storage.h"
 
 #include "gtest/gtest.h"
+#include <algorithm>
 #include <bitset>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
+#include <random>
+#include <utility>
 #include <vector>
 
 namespace utils::unaligned_storage
@@ -70,4 +74,161 @@ TEST(Reader, MoreBytes)
   EXPECT_EQ(reader2.read<std::size_t>(4), 0b00001011);
 }
 
+TEST(BitWriter, MatchesWriter)
+{
+  std::mt19937 gen{1};
+  std::uniform_int_distribution<std::size_t> count_dist(0, 19);
+
+  std::vector<std::pair<std::uint64_t, std::size_t>> codes;
+  for (std::size_t i = 0; i < 10000; i++)
+  {
+    auto bits_count = count_dist(gen);
+    codes.emplace_back(gen(), bits_count);
+  }
+
+  std::vector<std::byte> expected;
+  Writer unaligned_write{expected};
+
+  std::vector<std::byte> stream{std::byte{0xAB}};
+  {
+    BitWriter write_bits{stream};
+
+    for (std::size_t i = 0; i < codes.size(); i++)
+    {
+      auto [bits, bits_count] = codes[i];
+      unaligned_write(std::bitset<64>(bits), bits_count);
+
+      // Batch up to 2 codes of at most 19 bits before committing.
+      write_bits.write(bits, bits_count);
+      if (i % 2)
+      {
+        write_bits.commit();
+      }
+    }
+  }
+
+  ASSERT_EQ(stream.size(), expected.size() + 1);
+  EXPECT_EQ(stream[0], std::byte{0xAB});
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), std::next(stream.begin())));
+}
+
+TEST(BitWriter, EmptyFixedBuffer)
+{
+  bytes::FixedBuffer buffer{bytes::MutableByteView{}};
+  {
+    BitWriter write_bits{buffer};
+    write_bits(0x5, 3);
+    write_bits(0x3ff, 10);
+  }
+
+  EXPECT_TRUE(buffer.overflowed());
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(BitWriter, FlushedWriterLeavesContainer)
+{
+  std::vector<std::byte> stream;
+  {
+    BitWriter write_bits{stream};
+    write_bits(0x5, 3);
+    write_bits.flush();
+
+    // The container belongs to the caller again once flushed.
+    stream.push_back(std::byte{0xCD});
+  }
+
+  EXPECT_EQ(stream, (std::vector<std::byte>{std::byte{0x5}, std::byte{0xCD}}));
+
+  // A writer that wrote nothing has nothing to flush either.
+  {
+    BitWriter write_bits{stream};
+    stream.push_back(std::byte{0xEF});
+  }
+
+  EXPECT_EQ(stream, (std::vector<std::byte>{std::byte{0x5}, std::byte{0xCD}, std::byte{0xEF}}));
+}
+
+TEST(BitReader, PeekConsume)
+{
+  std::vector<std::byte> stream{std::byte{0b00100101}, std::byte{0b10001101}};
+  BitReader reader{stream.data(), stream.data() + stream.size()};
+
+  EXPECT_EQ(reader.peek(3), 0b101);
+  reader.consume(3);
+  EXPECT_EQ(reader.peek(9), 0b1101'00100);
+  reader.consume(9);
+  EXPECT_EQ(reader.read(4), 0b1000);
+
+  // Past the end, the stream reads as zeros.
+  EXPECT_EQ(reader.read(16), 0);
+}
+
+TEST(BitReader, MatchesReader)
+{
+  std::mt19937 gen{2};
+  std::uniform_int_distribution<int> byte_dist(0, 255);
+  std::uniform_int_distribution<std::size_t> count_dist(1, 31);
+
+  std::vector<std::byte> stream(4096);
+  for (auto &b : stream)
+  {
+    b = std::byte(byte_dist(gen));
+  }
+
+  Reader reader{stream.begin()};
+  BitReader bit_reader{stream.data(), stream.data() + stream.size()};
+
+  for (std::size_t bits_left = stream.size() * 8; bits_left;)
+  {
+    auto bits_count = std::min(count_dist(gen), bits_left);
+    bits_left -= bits_count;
+
+    EXPECT_EQ(bit_reader.read(bits_count), reader.read<std::uint64_t>(bits_count));
+  }
+}
+
+TEST(ReverseBitReader, ReadsBitWriterBackwards)
+{
+  std::mt19937 gen{3};
+  std::uniform_int_distribution<std::size_t> count_dist(0, 12);
+
+  // Short streams sit within a single window, longer ones need refills.
+  for (std::size_t codes_count : {0, 1, 3, 1000})
+  {
+    SCOPED_TRACE(codes_count);
+
+    std::vector<std::pair<std::uint64_t, std::size_t>> codes;
+    std::vector<std::byte> stream;
+    {
+      BitWriter write_bits{stream};
+
+      for (std::size_t i = 0; i < codes_count; i++)
+      {
+        auto bits_count = count_dist(gen);
+        codes.emplace_back(gen() & ((std::uint64_t{1} << bits_count) - 1), bits_count);
+
+        write_bits.write(codes.back().first, bits_count);
+        write_bits.commit();
+      }
+
+      write_bits.write(1, 1);
+    }
+
+    ReverseBitReader reader{stream.data(), stream.data() + stream.size()};
+    for (auto it = codes.rbegin(); it != codes.rend(); it++)
+    {
+      reader.refill();
+      EXPECT_EQ(reader.read(it->second), it->first);
+    }
+
+    EXPECT_TRUE(reader.finished());
+    reader.read(1);
+    EXPECT_TRUE(reader.overrun());
+  }
+
+  // Without an end marker, there is nothing to read.
+  std::vector<std::byte> unmarked{std::byte{0xFF}, std::byte{0}};
+  EXPECT_TRUE(ReverseBitReader(unmarked.data(), unmarked.data() + unmarked.size()).overrun());
+}
+
 }  // namespace utils::unaligned_storage